@@ -3,32 +3,62 @@
 Automated ESP32 Webhook Sender Flasher
 
 This script automates the process of building and flashing ESP32 webhook sender firmware.
+Every beacon gets the same build; major/minor/UUID are provisioned afterwards over
+serial (CONFIG command), which the firmware saves to NVS and applies without a reboot.
 
 Usage:
     python3 flash_beacon.py --port /dev/cu.usbserial-0001
     python3 flash_beacon.py --port /dev/cu.usbserial-0001 --baud 115200
+    python3 flash_beacon.py --major 100 --minor 1 --port /dev/cu.usbserial-0001 --configure-only
+    python3 flash_beacon.py --fleet beacons.json
+
+Fleet mode writes the identity straight into a per-device NVS partition image instead,
+and works on all serial ports at once.
 """
 
 import argparse
 import json
 import os
 import re
+import shlex
+import struct
 import subprocess
 import sys
+import time
+import zlib
+from concurrent.futures import ThreadPoolExecutor
 from pathlib import Path
 
+# Must match main/beacon_config.c and the beacon_config_t layout in
+# main/beacon_config.h (little endian, no padding)
+NVS_NAMESPACE = "beacon_cfg"
+NVS_CONFIG_KEY = "config"
+CONFIG_VERSION = 1
+CONFIG_FORMAT = "<HHIHH16s33s6sB"  # version, size, crc, major, minor, uuid, wifi ssid/bssid/channel
+
+# Build profiles (main/Kconfig.projbuild); each but "full" layers
+# sdkconfig.<profile> over sdkconfig.defaults in its own build directory
+PROFILES = ("full", "beacon_only", "gateway")
+
 class WebhookFlasher:
-    def __init__(self, project_dir="/Users/bharat/esp32/BluetoothBeacon"):
+    def __init__(self, project_dir="/Users/bharat/esp32/BluetoothBeacon", profile="full"):
         self.project_dir = Path(project_dir)
-        self.main_c_path = self.project_dir / "main" / "main.c"
         self.idf_activate = ". /Users/bharat/.espressif/tools/activate_idf_v5.5.2.sh >/dev/null 2>&1"
         self.idf_py = "/Users/bharat/.espressif/v5.5.2/esp-idf/tools/idf.py"
+        if profile == "full":
+            self.build_dir = self.project_dir / "build"
+            self.idf_args = ""
+        else:
+            self.build_dir = self.project_dir / f"build_{profile}"
+            self.idf_args = (f"-B {self.build_dir} -D SDKCONFIG={self.build_dir}/sdkconfig "
+                             f"-D \"SDKCONFIG_DEFAULTS=sdkconfig.defaults;sdkconfig.{profile}\" ")
+        self.fleet_dir = self.build_dir / "fleet"
 
     def build_firmware(self):
         """Build the firmware"""
         print("🔨 Building firmware...")
 
-        cmd = f"bash -c 'cd {self.project_dir} && {self.idf_activate} && {self.idf_py} build'"
+        cmd = f"bash -c 'cd {self.project_dir} && {self.idf_activate} && {self.idf_py} {self.idf_args}build'"
         result = subprocess.run(cmd, shell=True, capture_output=False, text=True)
 
         if result.returncode != 0:
@@ -42,7 +72,7 @@ class WebhookFlasher:
         """Flash the firmware to the device"""
         print(f"⚡ Flashing device on {port} at {baud} baud...")
 
-        cmd = f"bash -c 'cd {self.project_dir} && {self.idf_activate} && {self.idf_py} -p {port} -b {baud} flash'"
+        cmd = f"bash -c 'cd {self.project_dir} && {self.idf_activate} && {self.idf_py} {self.idf_args}-p {port} -b {baud} flash'"
         result = subprocess.run(cmd, shell=True, capture_output=False, text=True)
 
         if result.returncode != 0:
@@ -52,48 +82,61 @@ class WebhookFlasher:
         print(f"✓ Device flashed successfully on {port}")
         return True
 
-    def update_default_config(self, major, minor):
-        """Update DEFAULT_BEACON_MAJOR and DEFAULT_BEACON_MINOR in main.c"""
-        print(f"📝 Updating beacon config: Major={major}, Minor={minor}")
-
-        with open(self.main_c_path, 'r') as f:
-            content = f.read()
-
-        # Update MAJOR
-        content = re.sub(
-            r'#define DEFAULT_BEACON_MAJOR \d+',
-            f'#define DEFAULT_BEACON_MAJOR {major}',
-            content
-        )
-
-        # Update MINOR
-        content = re.sub(
-            r'#define DEFAULT_BEACON_MINOR \d+',
-            f'#define DEFAULT_BEACON_MINOR {minor}',
-            content
-        )
-
-        with open(self.main_c_path, 'w') as f:
-            f.write(content)
-
-        print(f"✓ Updated config in {self.main_c_path}")
-
-    def flash_single(self, major, minor, port, baud=115200):
-        """Flash a single beacon with specific major/minor values"""
+    def configure_device(self, major, minor, port, uuid=None, baud=115200, timeout=20):
+        """Send the beacon identity over serial (CONFIG command) and wait for CONFIG_OK"""
+        import serial  # pyserial; only needed for provisioning
+
+        command = f"CONFIG:{major}:{minor}" + (f":{uuid}" if uuid else "")
+        print(f"📝 Configuring beacon: Major={major}, Minor={minor}" + (f", UUID={uuid}" if uuid else ""))
+
+        ser = serial.Serial()
+        ser.port = port
+        ser.baudrate = baud
+        ser.timeout = 1
+        # Keep DTR/RTS low so opening the port does not reset the board
+        ser.dtr = False
+        ser.rts = False
+        ser.open()
+
+        last_sent = 0
+        start_time = time.time()
+        try:
+            while time.time() - start_time < timeout:
+                # Resend until answered - the beacon may still be booting after a flash
+                if time.time() - last_sent > 2:
+                    ser.write(command.encode() + b"\n")
+                    last_sent = time.time()
+
+                line = ser.readline().decode('utf-8', errors='ignore').strip()
+                if line.startswith("CONFIG_OK"):
+                    print(f"✓ {line[len('CONFIG_OK '):]}")
+                    return True
+                if line.startswith("CONFIG_ERROR"):
+                    print(f"❌ Beacon rejected config: {line[len('CONFIG_ERROR '):]}")
+                    return False
+        finally:
+            ser.close()
+
+        print(f"❌ No reply from beacon on {port}")
+        return False
+
+    def flash_single(self, major, minor, port, baud=115200, uuid=None, build=True, flash=True):
+        """Flash a single beacon and give it its major/minor (and UUID)"""
         print("\n" + "="*70)
         print(f"  Flashing Beacon - Major: {major}, Minor: {minor}")
         print(f"  Port: {port}, Baud: {baud}")
         print("="*70)
 
-        # Update config
-        self.update_default_config(major, minor)
-
-        # Build firmware
-        if not self.build_firmware():
+        # Build firmware (once per batch - the image is the same for every beacon)
+        if build and not self.build_firmware():
             return False
 
         # Flash device
-        if not self.flash_device(port, baud):
+        if flash and not self.flash_device(port, baud):
+            return False
+
+        # Provision identity
+        if not self.configure_device(major, minor, port, uuid):
             return False
 
         print("\n✅ Beacon ready!")
@@ -107,7 +150,7 @@ class WebhookFlasher:
         print(f"📡 Starting serial monitor on {port}...")
         print("   Press Ctrl+] to exit monitor")
 
-        cmd = f"bash -c 'cd {self.project_dir} && {self.idf_activate} && {self.idf_py} -p {port} monitor'"
+        cmd = f"bash -c 'cd {self.project_dir} && {self.idf_activate} && {self.idf_py} {self.idf_args}-p {port} monitor'"
         subprocess.run(cmd, shell=True)
 
     def flash_and_monitor(self, port, baud=115200):
@@ -132,7 +175,7 @@ class WebhookFlasher:
 
         return True
 
-    def flash_batch(self, config_file):
+    def flash_batch(self, config_file, flash=True):
         """Flash multiple beacons from a JSON config file"""
         print("\n" + "="*70)
         print("  Batch Beacon Flashing")
@@ -144,6 +187,9 @@ class WebhookFlasher:
         total = len(beacons)
         success_count = 0
 
+        if flash and not self.build_firmware():
+            return
+
         for i, beacon in enumerate(beacons, 1):
             major = beacon['major']
             minor = beacon['minor']
@@ -152,8 +198,8 @@ class WebhookFlasher:
 
             print(f"\n[{i}/{total}] {name}")
 
-            # Each beacon builds with its own config
-            if self.flash_single(major, minor, port):
+            # Same image for all; only the provisioned identity differs
+            if self.flash_single(major, minor, port, uuid=beacon.get('uuid'), build=False, flash=flash):
                 success_count += 1
             else:
                 print(f"❌ Failed to flash {name}")
@@ -168,6 +214,134 @@ class WebhookFlasher:
         print(f"  Batch Complete: {success_count}/{total} beacons flashed")
         print("="*70)
 
+    def nvs_partition(self):
+        """Offset and size of the nvs partition from partitions_ota.csv"""
+        with open(self.project_dir / "partitions_ota.csv") as f:
+            for line in f:
+                fields = [field.strip() for field in line.split(',')]
+                if fields[0] == "nvs":
+                    return fields[3], fields[4]
+        raise ValueError("No nvs partition in partitions_ota.csv")
+
+    def config_blob(self, beacon):
+        """The beacon_config_t blob for one beacon, CRC-32 taken with crc = 0"""
+        # Without a UUID the beacon keeps the one the firmware was built with
+        uuid = beacon.get('uuid')
+        if not uuid:
+            with open(self.build_dir / "config" / "sdkconfig.json") as f:
+                uuid = json.load(f)['BEACON_UUID']
+        uuid_hex = uuid.replace('-', '')
+        if not re.fullmatch(r'[0-9A-Fa-f]{32}', uuid_hex):
+            raise ValueError(f"Invalid UUID: {uuid}")
+
+        # No Wi-Fi AP cached yet: the first connect scans
+        fields = [CONFIG_VERSION, struct.calcsize(CONFIG_FORMAT), 0,
+                  int(beacon['major']), int(beacon['minor']), bytes.fromhex(uuid_hex), b'', b'', 0]
+        fields[2] = zlib.crc32(struct.pack(CONFIG_FORMAT, *fields))
+        return struct.pack(CONFIG_FORMAT, *fields)
+
+    def generate_nvs_image(self, beacon, size):
+        """Write an NVS partition image holding one beacon's identity"""
+        name = re.sub(r'[^A-Za-z0-9_-]+', '_', f"{beacon['major']}_{beacon['minor']}")
+        csv_path = self.fleet_dir / f"nvs_{name}.csv"
+        bin_path = self.fleet_dir / f"nvs_{name}.bin"
+
+        rows = ["key,type,encoding,value",
+                f"{NVS_NAMESPACE},namespace,,",
+                f"{NVS_CONFIG_KEY},data,hex2bin,{self.config_blob(beacon).hex()}"]
+        csv_path.write_text("\n".join(rows) + "\n")
+
+        cmd = (f"{self.idf_activate} && python $IDF_PATH/components/nvs_flash/nvs_partition_generator/nvs_partition_gen.py "
+               f"generate {shlex.quote(str(csv_path))} {shlex.quote(str(bin_path))} {size}")
+        result = subprocess.run(["bash", "-c", cmd], capture_output=True, text=True)
+        if result.returncode != 0:
+            raise RuntimeError(f"NVS image generation failed: {result.stderr.strip()}")
+        return bin_path
+
+    def esptool(self, port, baud, chip, args):
+        """Run esptool.py from the build directory; output is captured so parallel runs do not interleave"""
+        cmd = (f"{self.idf_activate} && cd {shlex.quote(str(self.build_dir))} && "
+               f"esptool.py --chip {chip} -p {shlex.quote(port)} -b {baud} {args}")
+        return subprocess.run(["bash", "-c", cmd], capture_output=True, text=True)
+
+    def provision_device(self, beacon, nvs_image, nvs_offset, flasher_args, baud):
+        """Flash one beacon: the NVS image always, the app only if it is not already current"""
+        port = beacon['port']
+        name = beacon.get('name', port)
+        start_time = time.time()
+
+        # MD5 comparison on the chip - no image is transferred
+        chip = flasher_args['extra_esptool_args']['chip']
+        app = flasher_args['app']
+        verify = self.esptool(port, baud, chip, f"--after no_reset verify_flash {app['offset']} {shlex.quote(app['file'])}")
+        app_current = verify.returncode == 0
+
+        files = [] if app_current else [f"{offset} {shlex.quote(path)}" for offset, path in flasher_args['flash_files'].items()]
+        files.append(f"{nvs_offset} {shlex.quote(str(nvs_image))}")
+        write_args = " ".join(flasher_args['write_flash_args'])
+        result = self.esptool(port, baud, chip, f"write_flash {write_args} {' '.join(files)}")
+
+        elapsed = time.time() - start_time
+        if result.returncode != 0:
+            last_line = (result.stdout + result.stderr).strip().splitlines()[-1:] or ["esptool failed"]
+            return False, f"❌ {name} ({port}): {last_line[0]}"
+        what = "NVS only" if app_current else "app + NVS"
+        return True, f"✓ {name} ({port}): Major={beacon['major']}, Minor={beacon['minor']} - {what} in {elapsed:.1f}s"
+
+    def flash_fleet(self, config_file, baud=460800, jobs=None, skip_build=False):
+        """Build once, then provision every beacon's NVS partition, all serial ports in parallel"""
+        print("\n" + "="*70)
+        print("  Fleet Provisioning")
+        print("="*70)
+
+        with open(config_file, 'r') as f:
+            beacons = json.load(f)
+
+        if not skip_build and not self.build_firmware():
+            return False
+
+        with open(self.build_dir / "flasher_args.json") as f:
+            flasher_args = json.load(f)
+        nvs_offset, nvs_size = self.nvs_partition()
+
+        self.fleet_dir.mkdir(parents=True, exist_ok=True)
+        try:
+            images = [self.generate_nvs_image(beacon, nvs_size) for beacon in beacons]
+        except (ValueError, RuntimeError) as e:
+            print(f"❌ {e}")
+            return False
+        print(f"✓ Generated {len(images)} NVS images")
+
+        # Beacons sharing a port go in successive rounds; each round flashes all ports at once
+        rounds = []
+        for beacon, image in zip(beacons, images):
+            for batch in rounds:
+                if beacon['port'] not in batch:
+                    batch[beacon['port']] = (beacon, image)
+                    break
+            else:
+                rounds.append({beacon['port']: (beacon, image)})
+
+        success_count = 0
+        start_time = time.time()
+        for i, batch in enumerate(rounds, 1):
+            if i > 1:
+                input(f"\n⏸️  Connect the next set of beacons ({len(batch)} ports) and press Enter to continue...")
+            print(f"\n⚡ Round {i}/{len(rounds)}: {len(batch)} ports")
+
+            with ThreadPoolExecutor(max_workers=jobs or len(batch)) as pool:
+                futures = [pool.submit(self.provision_device, beacon, image, nvs_offset, flasher_args, baud)
+                           for beacon, image in batch.values()]
+                for future in futures:
+                    ok, message = future.result()
+                    print(f"   {message}")
+                    success_count += ok
+
+        print("\n" + "="*70)
+        print(f"  Fleet Complete: {success_count}/{len(beacons)} beacons in {time.time() - start_time:.0f}s")
+        print("="*70)
+        return success_count == len(beacons)
+
 def create_example_config():
     """Create an example beacons.json file"""
     example = [
@@ -219,9 +393,18 @@ Examples:
   # Flash a single beacon
   python3 flash_beacon.py --major 100 --minor 1 --port /dev/cu.usbserial-0001
 
+  # Change the identity of a running beacon (no build, no flash, no reboot)
+  python3 flash_beacon.py --major 100 --minor 2 --port /dev/cu.usbserial-0001 --configure-only
+
   # Flash multiple beacons from config file
   python3 flash_beacon.py --batch beacons.json
 
+  # Provision a whole fleet: one build, per-device NVS images, all ports in parallel
+  python3 flash_beacon.py --fleet beacons.json --baud 460800
+
+  # Advertising-only image (no Wi-Fi/OTA/webhook), built in build_beacon_only/
+  python3 flash_beacon.py --profile beacon_only --fleet beacons.json
+
   # Create example config file
   python3 flash_beacon.py --create-example
         """
@@ -229,9 +412,15 @@ Examples:
 
     parser.add_argument('--major', type=int, help='Major number (0-65535)')
     parser.add_argument('--minor', type=int, help='Minor number (0-65535)')
+    parser.add_argument('--uuid', help='Proximity UUID (default: keep the current one)')
     parser.add_argument('--port', help='Serial port (e.g., /dev/cu.usbserial-0001)')
     parser.add_argument('--baud', type=int, default=115200, help='Baud rate (default: 115200)')
     parser.add_argument('--batch', help='JSON file with multiple beacon configs')
+    parser.add_argument('--configure-only', action='store_true', help='Only provision the identity, do not build or flash')
+    parser.add_argument('--fleet', help='JSON file of beacons to provision in parallel via NVS images')
+    parser.add_argument('--jobs', type=int, help='Max ports flashed at once in fleet mode (default: all)')
+    parser.add_argument('--skip-build', action='store_true', help='Fleet mode: reuse the existing build')
+    parser.add_argument('--profile', choices=PROFILES, default='full', help='Build profile (default: full)')
     parser.add_argument('--create-example', action='store_true', help='Create example beacons.json')
 
     args = parser.parse_args()
@@ -240,19 +429,28 @@ Examples:
         create_example_config()
         return 0
 
-    flasher = WebhookFlasher()
+    flasher = WebhookFlasher(profile=args.profile)
+
+    if args.fleet:
+        if not os.path.exists(args.fleet):
+            print(f"❌ Config file not found: {args.fleet}")
+            return 1
+
+        if not flasher.flash_fleet(args.fleet, args.baud, args.jobs, args.skip_build):
+            return 1
 
-    if args.batch:
+    elif args.batch:
         # Batch mode
         if not os.path.exists(args.batch):
             print(f"❌ Config file not found: {args.batch}")
             return 1
 
-        flasher.flash_batch(args.batch)
+        flasher.flash_batch(args.batch, flash=not args.configure_only)
 
     elif args.major is not None and args.minor is not None and args.port:
         # Single beacon mode
-        if not flasher.flash_single(args.major, args.minor, args.port, args.baud):
+        flash = not args.configure_only
+        if not flasher.flash_single(args.major, args.minor, args.port, args.baud, args.uuid, build=flash, flash=flash):
             return 1
 
     else:
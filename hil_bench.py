@@ -0,0 +1,431 @@
+#!/usr/bin/env python3
+"""
+Hardware-in-the-Loop Benchmark
+
+Flashes a build onto a test beacon on USB, runs a scenario suite on it and
+compares the results with a stored baseline. The numbers come from the
+device's METRICS serial command (see main/metrics.h), i.e. what the firmware
+measures itself, not from reading log timestamps:
+
+    cold_boot   reset the board --runs times: boot stages, heap, advertising
+    wifi_loss   drop Wi-Fi (WIFI:drop) --runs times and time the reconnect;
+                advertising must not stop meanwhile
+    ota         trigger a build on the OTA server (POST /build) and time the
+                update: download KB/s, and the first advertisement after it
+
+Usage:
+    python3 hil_bench.py --port /dev/cu.usbserial-0001 --save-baseline bench/baseline.json
+    python3 hil_bench.py --port /dev/cu.usbserial-0001 --baseline bench/baseline.json
+    python3 hil_bench.py --port /dev/cu.usbserial-0001 --skip-flash cold_boot --runs 10
+    python3 hil_bench.py --port /dev/cu.usbserial-0001 --server http://localhost:8080 --baseline bench/baseline.json
+
+The ota scenario needs --server, and a build there the beacon takes: a newer
+version, or a test server started with FORCE_OTA_UPDATE=true. With --server
+the cold boot results also go to the server's benchmark history
+(/benchmarks), and the advertising gaps a gateway heard from this beacon are
+added when one reports it.
+
+Exits with 1 when a metric is worse than the baseline by more than
+--tolerance percent.
+"""
+
+import argparse
+import json
+import re
+import statistics
+import subprocess
+import sys
+import time
+import urllib.error
+import urllib.request
+from datetime import datetime
+from pathlib import Path
+
+from flash_beacon import PROFILES, WebhookFlasher
+from identify_beacon import open_console, query_metrics
+
+SCENARIOS = ("cold_boot", "wifi_loss", "ota")
+
+# Must match boot_timeline.c
+BOOT_STAGES = ("app_start", "config_loaded", "bt_ready", "first_adv", "wifi_connected", "time_synced")
+
+# Lower is better, except these; REPORT_ONLY are shown but never compared
+HIGHER_IS_BETTER = ("heap_free", "heap_min", "heap_largest_block", "kbps")
+REPORT_ONLY = ("adv_interval_ms", "bytes")
+
+# Smaller differences are noise whatever the tolerance
+NOISE_FLOOR = {"_ms": 20, "heap": 1024}
+
+# "Transfer: <bytes> bytes in <ms> ms (<kbps> KB/s, ..." from perform_ota_update()
+TRANSFER_RE = r"Transfer: (\d+) bytes in (\d+) ms \((\d+) KB/s"
+
+
+class Console:
+    """Serial console of the test beacon; keeps every line it printed"""
+
+    def __init__(self, port, baud):
+        self.ser = open_console(port, baud)
+        self.log = []  # (host time, line)
+
+    def close(self):
+        self.ser.close()
+
+    def _keep(self, line):
+        self.log.append((time.time(), line))
+
+    def readline(self):
+        line = self.ser.readline().decode('utf-8', errors='ignore').strip()
+        if line:
+            self._keep(line)
+        return line
+
+    def reset(self):
+        """Pulse EN through RTS, as esptool does, with IO0 (DTR) left high"""
+        self.ser.dtr = False
+        self.ser.rts = True
+        time.sleep(0.1)
+        self.ser.rts = False
+        self.ser.reset_input_buffer()
+
+    def metrics(self, timeout=15):
+        return query_metrics(self.ser, timeout, on_line=self._keep)
+
+    def command(self, command, reply, timeout=5):
+        """Send a serial command and return what follows <reply>_OK, or None
+        when it failed or this build does not have the command"""
+        self.ser.write(command.encode() + b"\n")
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            line = self.readline()
+            if line.startswith(reply + "_OK"):
+                return line[len(reply) + 3:].strip()
+            if line.startswith(reply + "_ERROR") or line.startswith("ERR unknown command"):
+                return None
+        return None
+
+    def wait_for(self, pattern, timeout):
+        """Read until a line matches pattern; returns the match or None"""
+        regex = re.compile(pattern)
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            match = regex.search(self.readline())
+            if match:
+                return match
+        return None
+
+    def wait_booted(self, advertising, wifi, timeout=60):
+        """Poll METRICS until the beacon advertises (and has an IP)"""
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            m = self.metrics(timeout=max(1, deadline - time.time()))
+            if m is None:
+                return None
+            if ((not advertising or m.get('boot.first_adv_ms', -1) >= 0) and
+                    (not wifi or m.get('boot.wifi_connected_ms', -1) >= 0)):
+                return m
+            time.sleep(0.5)
+        return None
+
+
+def parse_fields(text):
+    """'a=1 b=x' -> {'a': 1, 'b': 'x'}"""
+    fields = {}
+    for item in text.split():
+        if '=' in item:
+            key, value = item.split('=', 1)
+            fields[key] = int(value) if re.fullmatch(r'-?\d+', value) else value
+    return fields
+
+
+def boot_sample(m):
+    """The cold boot numbers of one METRICS reply"""
+    sample = {f"{stage}_ms": m.get(f"boot.{stage}_ms", -1) for stage in BOOT_STAGES}
+    sample.update({
+        'adv_start_latency_ms': m.get('ble.adv_start_latency_ms', -1),
+        'adv_interval_ms': m.get('ble.adv_interval_ms', -1),
+        'heap_free': m.get('heap.free', -1),
+        'heap_min': m.get('heap.min', -1),
+        'heap_largest_block': m.get('heap.largest_block', -1),
+    })
+    # Stages this profile never reaches are left out
+    return {key: value for key, value in sample.items() if value >= 0}
+
+
+def summarize(runs):
+    """Median of every key over the runs"""
+    keys = sorted({key for run in runs for key in run})
+    return {key: round(statistics.median(run[key] for run in runs if key in run)) for key in keys}
+
+
+class Bench:
+    def __init__(self, console, profile, runs, server=None):
+        self.console = console
+        self.advertising = profile != "gateway"
+        self.runs = runs
+        self.server = server.rstrip('/') if server else None
+        self.wifi = console.command("WIFI", "WIFI") is not None
+        self.identity = parse_fields(console.command("CONFIG", "CONFIG") or "")
+
+    def cold_boot(self):
+        runs = []
+        for i in range(self.runs):
+            print(f"   🔌 Cold boot {i + 1}/{self.runs}")
+            self.console.reset()
+            m = self.console.wait_booted(self.advertising, self.wifi)
+            if m is None:
+                print("   ❌ Beacon did not come up within 60 s")
+                return None
+            runs.append(boot_sample(m))
+        return runs
+
+    def wifi_loss(self):
+        if not self.wifi:
+            print("   ⏭  No Wi-Fi in this build")
+            return []
+        runs = []
+        for i in range(self.runs):
+            before = self.console.wait_booted(self.advertising, wifi=True)
+            if before is None:
+                print("   ❌ Beacon is not connected")
+                return None
+            print(f"   📶 Wi-Fi drop {i + 1}/{self.runs}")
+            if self.console.command("WIFI:drop", "WIFI") is None:
+                print("   ❌ WIFI:drop failed")
+                return None
+
+            deadline = time.time() + 60
+            after = None
+            while time.time() < deadline:
+                m = self.console.metrics()
+                if m and m.get('time.wifi_reconnect.count', 0) > before.get('time.wifi_reconnect.count', 0):
+                    after = m
+                    break
+                time.sleep(1)
+            if after is None:
+                print("   ❌ No reconnect within 60 s")
+                return None
+
+            runs.append({
+                'reconnect_ms': after['time.wifi_reconnect.last_ms'],
+                'retries': after['counter.wifi_retries'] - before['counter.wifi_retries'],
+                'adv_restarts': after['time.adv_off.count'] - before['time.adv_off.count'],
+                'heap_min': after['heap.min'],
+            })
+        return runs
+
+    def ota(self):
+        if not self.server:
+            print("   ⏭  Needs --server")
+            return []
+        if self.console.wait_booted(self.advertising, wifi=True) is None:
+            print("   ❌ Beacon is not connected")
+            return None
+
+        print(f"   🔨 Triggering a build on {self.server}")
+        try:
+            urllib.request.urlopen(urllib.request.Request(f"{self.server}/build", method="POST"), timeout=10)
+        except urllib.error.URLError as e:
+            print(f"   ❌ {e}")
+            return None
+
+        # Waves, download slots and the notify jitter all delay the start
+        transfer = self.console.wait_for(TRANSFER_RE, timeout=900)
+        if transfer is None:
+            print("   ❌ No OTA download within 15 min")
+            return None
+        size, transfer_ms, kbps = (int(g) for g in transfer.groups())
+        print(f"   📦 {size} bytes at {kbps} KB/s")
+
+        if self.console.wait_for(r"rst:0x", timeout=60) is None:
+            print("   ❌ Beacon did not restart after the download")
+            return None
+        restart = time.time()
+        m = self.console.wait_booted(self.advertising, self.wifi)
+        if m is None:
+            print("   ❌ New image did not come up")
+            return None
+
+        return [{
+            'bytes': size,
+            'transfer_ms': transfer_ms,
+            'kbps': kbps,
+            'first_adv_ms': m.get('boot.first_adv_ms', -1),
+            'restart_to_ready_ms': round((time.time() - restart) * 1000),
+        }]
+
+    def adv_gaps(self):
+        """What a gateway heard from this beacon (ota-server /gateway/report)"""
+        try:
+            with urllib.request.urlopen(f"{self.server}/gateway/report", timeout=10) as resp:
+                gateways = json.load(resp)
+        except urllib.error.URLError:
+            return None
+        sightings = [b for gw in gateways for b in gw['beacons'].values()
+                     if b['major'] == self.identity.get('major') and b['minor'] == self.identity.get('minor')]
+        if not sightings:
+            return None
+        best = max(sightings, key=lambda b: b['count'])
+        return {'gap_ms': best['gap_ms'], 'gap_max_ms': best['gap_max_ms'], 'missed': best['missed']}
+
+    def post_benchmark(self, commit, mac, boot):
+        """Add the cold boot medians to the server's benchmark history"""
+        body = json.dumps({
+            'commit': commit,
+            'mac': mac,
+            'bootToAdvMs': boot.get('first_adv_ms', 0),
+            'freeHeap': boot.get('heap_free', 0),
+            'minFreeHeap': boot.get('heap_min', 0),
+        }).encode()
+        request = urllib.request.Request(f"{self.server}/benchmarks", data=body, method="POST",
+                                         headers={'Content-Type': 'application/json'})
+        try:
+            with urllib.request.urlopen(request, timeout=10) as resp:
+                flags = json.load(resp).get('flags') or []
+            print(f"✓ Posted to {self.server}/benchmarks" + (f" (flags: {', '.join(flags)})" if flags else ""))
+        except urllib.error.HTTPError as e:
+            print(f"⚠️  Server did not take the result: {e.code} (was {commit[:8]} built there?)")
+        except urllib.error.URLError as e:
+            print(f"⚠️  Could not post the result: {e.reason}")
+
+
+def git_commit(project_dir):
+    result = subprocess.run(["git", "-C", str(project_dir), "rev-parse", "HEAD"], capture_output=True, text=True)
+    return result.stdout.strip() if result.returncode == 0 else "unknown"
+
+
+def metric_direction(key):
+    """1 if higher is better, -1 if lower is better, 0 if not compared"""
+    name = key.split('.')[-1]
+    if name in REPORT_ONLY:
+        return 0
+    return 1 if any(name.endswith(h) for h in HIGHER_IS_BETTER) else -1
+
+
+def noise_floor(key):
+    for marker, floor in NOISE_FLOOR.items():
+        if marker in key:
+            return floor
+    return 0
+
+
+def compare(results, baseline, tolerance):
+    """Print results next to the baseline; returns the regressed keys"""
+    now = results['metrics']
+    base = baseline['metrics']
+    regressed = []
+
+    print("\n" + "=" * 78)
+    print(f"  Benchmark vs baseline {baseline['meta'].get('firmware', '?')} "
+          f"({baseline['meta'].get('commit', '?')[:8]}, {baseline['meta'].get('date', '?')})")
+    print("=" * 78)
+    print(f"{'':36}{'baseline':>12}{'now':>12}{'change':>10}")
+    for key in sorted(set(now) | set(base)):
+        if key not in now or key not in base:
+            print(f"{key:36}{base.get(key, '-'):>12}{now.get(key, '-'):>12}")
+            continue
+        diff = now[key] - base[key]
+        pct = f"{diff * 100 / base[key]:+.1f}%" if base[key] else f"{diff:+}"
+        # Positive when better, in the metric's own direction
+        gain = diff * metric_direction(key)
+        significant = abs(gain) > noise_floor(key) and abs(gain) * 100 > abs(base[key]) * tolerance
+        status = ""
+        if significant and gain < 0:
+            status = "  ⚠️"
+            regressed.append(key)
+        elif significant and gain > 0:
+            status = "  ✓"
+        print(f"{key:36}{base[key]:>12}{now[key]:>12}{pct:>10}{status}")
+    print("=" * 78)
+    return regressed
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark a build on a test beacon and compare with a baseline')
+    parser.add_argument('scenarios', nargs='*', default=list(SCENARIOS),
+                        help=f"Scenarios to run ({', '.join(SCENARIOS)}; default: all)")
+    parser.add_argument('--port', required=True, help='Serial port of the test beacon')
+    parser.add_argument('--baud', type=int, default=115200, help='Baud rate (default: 115200)')
+    parser.add_argument('--profile', choices=PROFILES, default='full', help='Build profile (default: full)')
+    parser.add_argument('--skip-build', action='store_true', help='Flash the existing build')
+    parser.add_argument('--skip-flash', action='store_true', help='Benchmark what the beacon runs now')
+    parser.add_argument('--runs', type=int, default=5, help='Repetitions of cold_boot and wifi_loss (default: 5)')
+    parser.add_argument('--server', help='OTA server URL, for the ota scenario, gateway gaps and /benchmarks')
+    parser.add_argument('--baseline', help='Compare with this results file')
+    parser.add_argument('--tolerance', type=float, default=10, help='Allowed regression in percent (default: 10)')
+    parser.add_argument('--save-baseline', help='Write the results here as the new baseline')
+    parser.add_argument('--json', help='Also write the results to this file')
+    args = parser.parse_args()
+    unknown = [s for s in args.scenarios if s not in SCENARIOS]
+    if unknown:
+        parser.error(f"unknown scenario(s): {', '.join(unknown)}")
+    baseline = json.loads(Path(args.baseline).read_text()) if args.baseline else None
+
+    flasher = WebhookFlasher(profile=args.profile)
+    if not args.skip_flash:
+        if not args.skip_build and not flasher.build_firmware():
+            return 1
+        if not flasher.flash_device(args.port, args.baud):
+            return 1
+
+    console = Console(args.port, args.baud)
+    try:
+        if console.wait_booted(advertising=args.profile != "gateway", wifi=False) is None:
+            print(f"❌ No METRICS reply on {args.port}")
+            return 1
+        bench = Bench(console, args.profile, args.runs, args.server)
+
+        results = {'meta': {}, 'metrics': {}, 'runs': {}}
+        for scenario in args.scenarios:
+            print(f"🧪 {scenario}")
+            runs = getattr(bench, scenario)()
+            if runs is None:
+                return 1
+            if runs:
+                results['runs'][scenario] = runs
+                for key, value in summarize(runs).items():
+                    results['metrics'][f"{scenario}.{key}"] = value
+
+        if bench.server:
+            gaps = bench.adv_gaps()
+            if gaps:
+                for key, value in gaps.items():
+                    results['metrics'][f"adv.{key}"] = value
+        final = console.metrics() or {}
+    finally:
+        console.close()
+
+    commit = git_commit(flasher.project_dir) if not args.skip_flash else "unknown"
+    results['meta'] = {
+        'firmware': final.get('firmware', '?'),
+        'commit': commit,
+        'profile': args.profile,
+        'mac': final.get('mac', '?'),
+        'runs': args.runs,
+        'date': datetime.now().isoformat(timespec='seconds'),
+    }
+
+    if bench.server and 'cold_boot' in results['runs'] and commit != "unknown":
+        boot = {key.split('.', 1)[1]: value for key, value in results['metrics'].items() if key.startswith('cold_boot.')}
+        bench.post_benchmark(commit, results['meta']['mac'], boot)
+
+    for path in (args.json, args.save_baseline):
+        if path:
+            Path(path).parent.mkdir(parents=True, exist_ok=True)
+            Path(path).write_text(json.dumps(results, indent=2) + "\n")
+            print(f"✓ Results written to {path}")
+
+    if baseline is None:
+        for key, value in sorted(results['metrics'].items()):
+            print(f"  {key:36} {value}")
+        return 0
+
+    regressed = compare(results, baseline, args.tolerance)
+    if regressed:
+        print(f"⚠️  {len(regressed)} metric(s) regressed more than {args.tolerance:g}%: {', '.join(regressed)}")
+        return 1
+    print(f"✅ Within {args.tolerance:g}% of the baseline")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
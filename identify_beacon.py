@@ -7,9 +7,11 @@ and displays its Major/Minor configuration.
 
 Usage:
     python3 identify_beacon.py /dev/cu.usbserial-0001
+    python3 identify_beacon.py /dev/cu.usbserial-0001 --metrics [--json]
 """
 
 import sys
+import json
 import serial
 import time
 import re
@@ -111,16 +113,75 @@ def identify_beacon(port, baud=115200, timeout=10):
         print("\n\n⚠️  Interrupted by user")
         return False
 
+def open_console(port, baud=115200):
+    """Open the beacon's serial console without resetting the board"""
+    ser = serial.Serial()
+    ser.port = port
+    ser.baudrate = baud
+    ser.timeout = 1
+    # Keep DTR/RTS low so opening the port does not reset the board
+    ser.dtr = False
+    ser.rts = False
+    ser.open()
+    return ser
+
+def query_metrics(ser, timeout=15, on_line=None):
+    """Send METRICS on an open console and parse the reply into a dict.
+    on_line is called with every other line read meanwhile (log output)."""
+    metrics = {}
+    in_block = False
+    last_sent = 0
+    start_time = time.time()
+    while time.time() - start_time < timeout:
+        # Resend until the reply starts - the beacon may still be booting
+        if not in_block and time.time() - last_sent > 2:
+            ser.write(b"METRICS\n")
+            last_sent = time.time()
+
+        line = ser.readline().decode('utf-8', errors='ignore').strip()
+        if line == "METRICS_BEGIN":
+            in_block = True
+            metrics = {}
+        elif line == "METRICS_END" and in_block:
+            return metrics
+        elif in_block and '=' in line:
+            key, value = line.split('=', 1)
+            metrics[key] = int(value) if re.fullmatch(r'-?\d+', value) else value
+        elif line and on_line:
+            on_line(line)
+    return None
+
+def read_metrics(port, baud=115200, timeout=15):
+    """Ask a running beacon for its metrics (METRICS serial command)"""
+    ser = open_console(port, baud)
+    try:
+        return query_metrics(ser, timeout)
+    finally:
+        ser.close()
+
 def main():
     if len(sys.argv) < 2:
-        print("Usage: python3 identify_beacon.py <serial_port>")
+        print("Usage: python3 identify_beacon.py <serial_port> [--metrics [--json]]")
         print("\nExample:")
         print("  python3 identify_beacon.py /dev/cu.usbserial-0001")
+        print("  python3 identify_beacon.py /dev/cu.usbserial-0001 --metrics --json > v3.1.0.json")
         print("\nTo find available ports:")
         print("  ls /dev/cu.* | grep usb")
         sys.exit(1)
 
     port = sys.argv[1]
+    if '--metrics' in sys.argv:
+        metrics = read_metrics(port)
+        if metrics is None:
+            print("❌ No metrics received (is the beacon running this firmware?)")
+            sys.exit(1)
+        if '--json' in sys.argv:
+            print(json.dumps(metrics, indent=2, sort_keys=True))
+        else:
+            for key, value in metrics.items():
+                print(f"  {key:40} {value}")
+        return
+
     identify_beacon(port)
 
 if __name__ == '__main__':
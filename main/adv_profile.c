@@ -0,0 +1,241 @@
+/**
+ * Adaptive Advertising Profiles Implementation
+ *
+ * A small task re-evaluates the wanted profile every few seconds, or at
+ * once when motion is reported, and applies it through beacon_adv.
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "beacon_adv.h"
+#include "adv_profile.h"
+
+static const char* TAG = "Adv-Profile";
+
+#define ADV_PROFILE_EVAL_MS  5000
+
+// Advertising events are spaced interval + a random 0-10 ms advDelay
+#define ADV_DELAY_AVG_MS     5
+
+// Clock counts as set by SNTP once it is past 2020-09-13
+#define SNTP_VALID_EPOCH     1600000000
+
+static const char *s_profile_names[ADV_PROFILE_COUNT] = {
+    [ADV_PROFILE_BOOT]   = "boot",
+    [ADV_PROFILE_MOTION] = "motion",
+    [ADV_PROFILE_IDLE]   = "idle",
+    [ADV_PROFILE_NIGHT]  = "night",
+};
+
+static adv_profile_config_t s_config;
+static TaskHandle_t s_task;
+static volatile int64_t s_last_motion_us = -1;
+
+// Statistics, shared with readers in other tasks
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static adv_profile_stats_t s_stats;
+static int64_t s_profile_since_us;
+
+/**
+ * Charge the time since the last call to the current profile.
+ * Caller holds s_stats_lock.
+ */
+static void account_locked(int64_t now_us)
+{
+    int64_t elapsed_us = now_us - s_profile_since_us;
+    if (elapsed_us <= 0) {
+        return;
+    }
+
+    const adv_profile_params_t *params = &s_config.profiles[s_stats.current];
+    uint64_t event_us = ((uint64_t)params->interval_ms + ADV_DELAY_AVG_MS) * 1000;
+
+    s_stats.time_ms[s_stats.current] += elapsed_us / 1000;
+    s_stats.adv_events[s_stats.current] += (uint64_t)elapsed_us * beacon_adv_advertiser_count() / event_us;
+    s_profile_since_us = now_us;
+}
+
+static bool in_night_window(void)
+{
+    if (s_config.night_start_hour == s_config.night_end_hour) {
+        return false;
+    }
+
+    time_t now = time(NULL);
+    if (now < SNTP_VALID_EPOCH) {
+        return false;  // No SNTP time yet
+    }
+
+    struct tm tm_utc;
+    gmtime_r(&now, &tm_utc);
+    int hour = tm_utc.tm_hour;
+
+    if (s_config.night_start_hour < s_config.night_end_hour) {
+        return hour >= s_config.night_start_hour && hour < s_config.night_end_hour;
+    }
+    // Window wraps past midnight
+    return hour >= s_config.night_start_hour || hour < s_config.night_end_hour;
+}
+
+static adv_profile_id_t choose_profile(int64_t now_us)
+{
+    if (now_us < (int64_t)s_config.boot_fast_sec * 1000000) {
+        return ADV_PROFILE_BOOT;
+    }
+
+    int64_t last_motion = s_last_motion_us;
+    if (last_motion >= 0 && now_us - last_motion < (int64_t)s_config.motion_hold_sec * 1000000) {
+        return ADV_PROFILE_MOTION;
+    }
+
+    return in_night_window() ? ADV_PROFILE_NIGHT : ADV_PROFILE_IDLE;
+}
+
+static void apply_profile(adv_profile_id_t profile)
+{
+    const adv_profile_params_t *params = &s_config.profiles[profile];
+    esp_err_t err = beacon_adv_set_params(params->interval_ms, params->tx_power);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to apply %s profile: %s", s_profile_names[profile], esp_err_to_name(err));
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_stats_lock);
+    account_locked(now);
+    adv_profile_id_t previous = s_stats.current;
+    s_stats.current = profile;
+    s_stats.switches++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+
+    ESP_LOGI(TAG, "Profile %s -> %s (%dms, power level %d)", s_profile_names[previous],
+             s_profile_names[profile], params->interval_ms, params->tx_power);
+    adv_profile_log_stats();
+}
+
+static void adv_profile_task(void *pvParameter)
+{
+    while (1) {
+        // Woken early by motion
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ADV_PROFILE_EVAL_MS));
+
+        adv_profile_id_t wanted = choose_profile(esp_timer_get_time());
+        if (wanted != s_stats.current) {
+            apply_profile(wanted);
+        }
+    }
+}
+
+static void IRAM_ATTR motion_isr_handler(void *arg)
+{
+    s_last_motion_us = esp_timer_get_time();
+
+    BaseType_t higher_priority_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(s_task, &higher_priority_woken);
+    if (higher_priority_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static esp_err_t setup_motion_gpio(int gpio)
+{
+    gpio_config_t io_config = {
+        .pin_bit_mask = (1ULL << gpio),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_ENABLE,
+        .intr_type = GPIO_INTR_ANYEDGE,
+    };
+    esp_err_t err = gpio_config(&io_config);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Already installed by another driver is fine
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return err;
+    }
+    return gpio_isr_handler_add(gpio, motion_isr_handler, NULL);
+}
+
+esp_err_t adv_profile_start(const adv_profile_config_t *config)
+{
+    if (config == NULL || s_task != NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < ADV_PROFILE_COUNT; i++) {
+        if (config->profiles[i].interval_ms < 20 || config->profiles[i].interval_ms > 10240) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    s_config = *config;
+    s_stats.current = choose_profile(esp_timer_get_time());
+    s_profile_since_us = esp_timer_get_time();
+
+    // Advertising was started with the compile-time defaults
+    const adv_profile_params_t *params = &s_config.profiles[s_stats.current];
+    esp_err_t err = beacon_adv_set_params(params->interval_ms, params->tx_power);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (xTaskCreate(adv_profile_task, "adv_profile", 3072, NULL, 4, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (config->motion_gpio >= 0) {
+        err = setup_motion_gpio(config->motion_gpio);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "⚠️  Motion input on GPIO %d unavailable: %s", config->motion_gpio, esp_err_to_name(err));
+        }
+    }
+
+    ESP_LOGI(TAG, "✓ Adaptive advertising started in %s profile", s_profile_names[s_stats.current]);
+    return ESP_OK;
+}
+
+void adv_profile_notify_motion(void)
+{
+    s_last_motion_us = esp_timer_get_time();
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+void adv_profile_get_stats(adv_profile_stats_t *stats)
+{
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_stats_lock);
+    account_locked(now);
+    *stats = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+const char *adv_profile_name(adv_profile_id_t profile)
+{
+    return (profile < ADV_PROFILE_COUNT) ? s_profile_names[profile] : "unknown";
+}
+
+void adv_profile_log_stats(void)
+{
+    adv_profile_stats_t stats;
+    adv_profile_get_stats(&stats);
+
+    for (int i = 0; i < ADV_PROFILE_COUNT; i++) {
+        ESP_LOGI(TAG, "  %-6s %10llu adv events, %8llu s", s_profile_names[i],
+                 (unsigned long long)stats.adv_events[i], (unsigned long long)(stats.time_ms[i] / 1000));
+    }
+}
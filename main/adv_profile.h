@@ -0,0 +1,67 @@
+/**
+ * Adaptive Advertising Profiles
+ *
+ * Picks the advertising interval and TX power at runtime for battery
+ * deployments: fast right after boot and after motion, slow when idle,
+ * and a night profile following a time-of-day schedule once SNTP has set
+ * the clock. Profile changes go through beacon_adv_set_params(), so
+ * Bluedroid is never reinitialized.
+ *
+ * The number of advertising events sent under each profile is estimated
+ * from time on air and the interval (interval + 5 ms average advDelay,
+ * per advertising set).
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_bt.h"
+
+typedef enum {
+    ADV_PROFILE_BOOT,           // Just booted - be discovered quickly
+    ADV_PROFILE_MOTION,         // Recent motion
+    ADV_PROFILE_IDLE,           // Nothing happening
+    ADV_PROFILE_NIGHT,          // Inside the night window
+    ADV_PROFILE_COUNT
+} adv_profile_id_t;
+
+typedef struct {
+    uint16_t interval_ms;
+    esp_power_level_t tx_power;
+} adv_profile_params_t;
+
+typedef struct {
+    adv_profile_params_t profiles[ADV_PROFILE_COUNT];
+    uint32_t boot_fast_sec;     // BOOT profile after power-up
+    uint32_t motion_hold_sec;   // MOTION profile after the last motion event
+    int motion_gpio;            // Motion sensor input (any edge), -1 for none
+    int night_start_hour;       // Night window in UTC hours, [start, end)
+    int night_end_hour;         // Set start == end to disable
+} adv_profile_config_t;
+
+typedef struct {
+    uint64_t adv_events[ADV_PROFILE_COUNT];   // Estimated advertising events
+    uint64_t time_ms[ADV_PROFILE_COUNT];      // Time spent in each profile
+    uint32_t switches;
+    adv_profile_id_t current;
+} adv_profile_stats_t;
+
+/**
+ * Start the profile scheduler task; advertising must already be running
+ */
+esp_err_t adv_profile_start(const adv_profile_config_t *config);
+
+/**
+ * Report motion (from a sensor driver or the configured GPIO)
+ */
+void adv_profile_notify_motion(void);
+
+void adv_profile_get_stats(adv_profile_stats_t *stats);
+
+const char *adv_profile_name(adv_profile_id_t profile);
+
+void adv_profile_log_stats(void);
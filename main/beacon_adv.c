@@ -0,0 +1,436 @@
+/**
+ * Beacon Advertising Engine Implementation
+ *
+ * Holds the precomputed payload table and drives either BLE 5 advertising
+ * sets or a rotating legacy advertiser.
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_ibeacon_api.h"
+#include "beacon_adv.h"
+
+static const char* TAG = "Beacon-Adv";
+
+// Precomputed advertising payloads, one per identity
+static esp_ble_ibeacon_t s_payloads[BEACON_ADV_MAX_IDENTITIES];
+static size_t s_payload_count = 0;
+static beacon_adv_config_t s_config;
+
+// Payloads can be replaced while the rotation timer reads them
+static portMUX_TYPE s_payload_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+
+// GAP calls complete asynchronously; setup waits for each completion event
+#define EXT_ADV_SETUP_TIMEOUT_MS 1000
+
+static SemaphoreHandle_t s_gap_done;
+static esp_bt_status_t s_gap_status;
+static bool s_adv_started = false;
+
+// One sequence of GAP calls at a time: the adv_profile and serial tasks
+// would otherwise take each other's completion events
+static SemaphoreHandle_t s_gap_lock;
+
+static void gap_lock(void)
+{
+    xSemaphoreTake(s_gap_lock, portMAX_DELAY);
+    xSemaphoreTake(s_gap_done, 0);     // Late event of a call that timed out
+}
+
+static void gap_unlock(void)
+{
+    xSemaphoreGive(s_gap_lock);
+}
+
+static esp_err_t wait_gap_done(const char *what, uint8_t instance)
+{
+    if (xSemaphoreTake(s_gap_done, pdMS_TO_TICKS(EXT_ADV_SETUP_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGE(TAG, "Timed out waiting for %s (set %d)", what, instance);
+        return ESP_ERR_TIMEOUT;
+    }
+    if (s_gap_status != ESP_BT_STATUS_SUCCESS) {
+        ESP_LOGE(TAG, "%s failed for set %d: status %d", what, instance, s_gap_status);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * One advertising set per identity, all started together.
+ * Payloads only need to be loaded the first time; a restart with new
+ * parameters keeps the data already in the controller. Callers hold
+ * s_gap_lock.
+ */
+static esp_err_t start_ext_adv_sets(bool load_data)
+{
+    uint32_t interval = (uint32_t)s_config.interval_ms * 1000 / 625;
+    esp_ble_gap_ext_adv_params_t params = {
+        // Legacy PDUs: iOS only reports iBeacons from legacy advertising
+        .type = ESP_BLE_GAP_SET_EXT_ADV_PROP_LEGACY_NONCONN,
+        .interval_min = interval,
+        .interval_max = interval,
+        .channel_map = ADV_CHNL_ALL,
+        .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+        .filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+        .tx_power = EXT_ADV_TX_PWR_NO_PREFERENCE,
+        .primary_phy = ESP_BLE_GAP_PRI_PHY_1M,
+        .max_skip = 0,
+        .secondary_phy = ESP_BLE_GAP_PHY_1M,
+        .scan_req_notif = false,
+    };
+    esp_ble_gap_ext_adv_t sets[BEACON_ADV_MAX_IDENTITIES] = {0};
+
+    for (size_t i = 0; i < s_payload_count; i++) {
+        uint8_t instance = (uint8_t)i;
+        params.sid = instance;
+
+        esp_err_t err = esp_ble_gap_ext_adv_set_params(instance, &params);
+        if (err == ESP_OK) {
+            err = wait_gap_done("set params", instance);
+        }
+        if (err == ESP_OK && load_data) {
+            err = esp_ble_gap_config_ext_adv_data_raw(instance, sizeof(esp_ble_ibeacon_t),
+                                                      (const uint8_t *)&s_payloads[i]);
+            if (err == ESP_OK) {
+                err = wait_gap_done("set data", instance);
+            }
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        sets[i].instance = instance;
+        sets[i].duration = 0;      // Advertise until stopped
+        sets[i].max_events = 0;
+    }
+
+    esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_DEFAULT, s_config.tx_power);
+    esp_err_t err = esp_ble_gap_ext_adv_start((uint8_t)s_payload_count, sets);
+    if (err == ESP_OK) {
+        err = wait_gap_done("start", 0);
+    }
+    s_adv_started = err == ESP_OK;
+    return err;
+}
+
+/**
+ * Stop all sets. Callers hold s_gap_lock.
+ */
+static esp_err_t stop_ext_adv_sets(void)
+{
+    uint8_t instances[BEACON_ADV_MAX_IDENTITIES];
+    for (size_t i = 0; i < s_payload_count; i++) {
+        instances[i] = (uint8_t)i;
+    }
+
+    esp_err_t err = esp_ble_gap_ext_adv_stop((uint8_t)s_payload_count, instances);
+    if (err == ESP_OK) {
+        err = wait_gap_done("stop", 0);
+    }
+    if (err == ESP_OK) {
+        s_adv_started = false;
+    }
+    return err;
+}
+
+#else  // Legacy advertising
+
+static esp_ble_adv_params_t s_adv_params = {
+    .adv_type           = ADV_TYPE_NONCONN_IND,
+    .own_addr_type      = BLE_ADDR_TYPE_PUBLIC,
+    .channel_map        = ADV_CHNL_ALL,
+    .adv_filter_policy  = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+};
+
+static esp_timer_handle_t s_rotation_timer;
+static size_t s_current = 0;
+static bool s_adv_started = false;
+static bool s_restart_pending = false;  // Stopped to apply new parameters
+
+/**
+ * Put the next identity on air; the advertiser keeps running, only its
+ * data changes
+ */
+static void rotation_timer_cb(void *arg)
+{
+    esp_ble_ibeacon_t payload;
+
+    taskENTER_CRITICAL(&s_payload_lock);
+    s_current = (s_current + 1) % s_payload_count;
+    payload = s_payloads[s_current];
+    taskEXIT_CRITICAL(&s_payload_lock);
+
+    esp_ble_gap_config_adv_data_raw((uint8_t *)&payload, sizeof(payload));
+}
+
+static esp_err_t start_legacy_adv(void)
+{
+    s_adv_params.adv_int_min = s_config.interval_ms * 1000 / 625;
+    s_adv_params.adv_int_max = s_adv_params.adv_int_min;
+
+    // Advertising starts once the first payload is set (see GAP handler)
+    s_current = 0;
+    esp_err_t err = esp_ble_gap_config_adv_data_raw((uint8_t *)&s_payloads[0], sizeof(esp_ble_ibeacon_t));
+    if (err != ESP_OK) {
+        return err;
+    }
+    esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_ADV, s_config.tx_power);
+
+    if (s_payload_count > 1) {
+        if (s_rotation_timer == NULL) {
+            const esp_timer_create_args_t timer_args = {
+                .callback = rotation_timer_cb,
+                .name = "adv_rotate",
+            };
+            err = esp_timer_create(&timer_args, &s_rotation_timer);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        err = esp_timer_start_periodic(s_rotation_timer, (uint64_t)s_config.rotation_ms * 1000);
+    }
+    return err;
+}
+
+#endif  // CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+
+static esp_err_t encode_payload(const beacon_adv_identity_t *identity, esp_ble_ibeacon_t *payload)
+{
+    return esp_ble_ibeacon_encode(identity->uuid, identity->major, identity->minor, identity->measured_power, payload);
+}
+
+esp_err_t beacon_adv_init(const beacon_adv_identity_t *identities, size_t count, const beacon_adv_config_t *config)
+{
+    if (identities == NULL || config == NULL || count == 0 || count > BEACON_ADV_MAX_IDENTITIES ||
+        config->interval_ms < 20 || config->interval_ms > 10240) {
+        return ESP_ERR_INVALID_ARG;
+    }
+#if !CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    if (count > 1 && config->rotation_ms < config->interval_ms) {
+        return ESP_ERR_INVALID_ARG;
+    }
+#endif
+
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    if (s_gap_done == NULL) {
+        s_gap_done = xSemaphoreCreateBinary();
+        s_gap_lock = xSemaphoreCreateMutex();
+        if (s_gap_done == NULL || s_gap_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+#endif
+
+    for (size_t i = 0; i < count; i++) {
+        esp_err_t err = encode_payload(&identities[i], &s_payloads[i]);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Identity %d: invalid iBeacon data", (int)i);
+            return err;
+        }
+        ESP_LOGI(TAG, "Identity %d: major=%d minor=%d", (int)i, identities[i].major, identities[i].minor);
+    }
+
+    s_payload_count = count;
+    s_config = *config;
+    return ESP_OK;
+}
+
+esp_err_t beacon_adv_start(void)
+{
+    if (s_payload_count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    ESP_LOGI(TAG, "Starting %d BLE 5 advertising set(s)", (int)s_payload_count);
+    gap_lock();
+    esp_err_t err = start_ext_adv_sets(true);
+    gap_unlock();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ %d identities broadcasting at %dms intervals", (int)s_payload_count, s_config.interval_ms);
+    }
+    return err;
+#else
+    if (s_payload_count > 1) {
+        ESP_LOGI(TAG, "Rotating %d identities every %lums", (int)s_payload_count, (unsigned long)s_config.rotation_ms);
+    }
+    return start_legacy_adv();
+#endif
+}
+
+esp_err_t beacon_adv_set_params(uint16_t interval_ms, esp_power_level_t tx_power)
+{
+    if (interval_ms < 20 || interval_ms > 10240) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_payload_count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (interval_ms == s_config.interval_ms && tx_power == s_config.tx_power) {
+        return ESP_OK;
+    }
+
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    // Set parameters can only change while a set is stopped
+    gap_lock();
+    s_config.interval_ms = interval_ms;
+    s_config.tx_power = tx_power;
+    esp_err_t err = stop_ext_adv_sets();
+    if (err == ESP_OK) {
+        err = start_ext_adv_sets(false);
+    }
+    gap_unlock();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ Advertising now every %dms", interval_ms);
+    }
+    return err;
+#else
+    s_config.interval_ms = interval_ms;
+    s_config.tx_power = tx_power;
+    esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_ADV, tx_power);
+    s_adv_params.adv_int_min = interval_ms * 1000 / 625;
+    s_adv_params.adv_int_max = s_adv_params.adv_int_min;
+    if (!s_adv_started) {
+        return ESP_OK;  // Picked up by the first start
+    }
+
+    // Restarted with the new interval from the stop-complete event
+    s_restart_pending = true;
+    return esp_ble_gap_stop_advertising();
+#endif
+}
+
+esp_err_t beacon_adv_set_identity(size_t index, const beacon_adv_identity_t *identity)
+{
+    if (identity == NULL || index >= s_payload_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_ble_ibeacon_t payload;
+    esp_err_t err = encode_payload(identity, &payload);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    taskENTER_CRITICAL(&s_payload_lock);
+    s_payloads[index] = payload;
+#if !CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    bool on_air = s_current == index;
+#endif
+    taskEXIT_CRITICAL(&s_payload_lock);
+
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    // Legacy-PDU sets accept new data while enabled
+    uint8_t instance = (uint8_t)index;
+    gap_lock();
+    err = esp_ble_gap_config_ext_adv_data_raw(instance, sizeof(payload), (const uint8_t *)&payload);
+    if (err == ESP_OK) {
+        err = wait_gap_done("set data", instance);
+    }
+    gap_unlock();
+#else
+    // Other slots go on air with their next rotation
+    if (on_air) {
+        err = esp_ble_gap_config_adv_data_raw((uint8_t *)&payload, sizeof(payload));
+    }
+#endif
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ Identity %d now major=%d minor=%d", (int)index, identity->major, identity->minor);
+    }
+    return err;
+}
+
+uint16_t beacon_adv_get_interval_ms(void)
+{
+    return s_config.interval_ms;
+}
+
+void beacon_adv_handle_gap_event(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    switch (event) {
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    case ESP_GAP_BLE_EXT_ADV_SET_PARAMS_COMPLETE_EVT:
+        s_gap_status = param->ext_adv_set_params.status;
+        xSemaphoreGive(s_gap_done);
+        break;
+
+    case ESP_GAP_BLE_EXT_ADV_DATA_SET_COMPLETE_EVT:
+        s_gap_status = param->ext_adv_data_set.status;
+        xSemaphoreGive(s_gap_done);
+        break;
+
+    case ESP_GAP_BLE_EXT_ADV_START_COMPLETE_EVT:
+        s_gap_status = param->ext_adv_start.status;
+        xSemaphoreGive(s_gap_done);
+        break;
+
+    case ESP_GAP_BLE_EXT_ADV_STOP_COMPLETE_EVT:
+        s_gap_status = param->ext_adv_stop.status;
+        xSemaphoreGive(s_gap_done);
+        break;
+#else
+    case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT:
+        // Rotation only swaps data; the advertiser is started once
+        if (!s_adv_started) {
+            esp_ble_gap_start_advertising(&s_adv_params);
+        }
+        break;
+
+    case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+        if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+            ESP_LOGE(TAG, "Advertising start failed: status %d", param->adv_start_cmpl.status);
+        } else {
+            s_adv_started = true;
+            ESP_LOGI(TAG, "✓ iBeacon is broadcasting at %dms intervals!", s_config.interval_ms);
+        }
+        break;
+
+    case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
+        if (s_restart_pending) {
+            s_restart_pending = false;
+            esp_ble_gap_start_advertising(&s_adv_params);
+        }
+        break;
+#endif
+
+    default:
+        break;
+    }
+}
+
+size_t beacon_adv_identity_count(void)
+{
+    return s_payload_count;
+}
+
+size_t beacon_adv_advertiser_count(void)
+{
+    // Parallel sets each send their own events; rotation shares one
+    return beacon_adv_uses_ext_adv() ? s_payload_count : (s_payload_count > 0 ? 1 : 0);
+}
+
+bool beacon_adv_is_active(void)
+{
+    return s_adv_started;
+}
+
+bool beacon_adv_uses_ext_adv(void)
+{
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    return true;
+#else
+    return false;
+#endif
+}
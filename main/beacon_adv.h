@@ -0,0 +1,98 @@
+/**
+ * Beacon Advertising Engine
+ *
+ * Advertises one or more iBeacon identities from a single device. All
+ * advertising payloads are encoded once by beacon_adv_init() into a table;
+ * nothing is rebuilt while advertising, except an identity replaced with
+ * beacon_adv_set_identity().
+ *
+ * With BLE 5 (CONFIG_BT_BLE_50_FEATURES_SUPPORTED) every identity gets its
+ * own extended advertising set using legacy non-connectable PDUs, so phones
+ * see all of them at the configured interval. On BLE 4.2 controllers a
+ * single advertiser rotates through the table, swapping the raw adv data
+ * every rotation_ms.
+ *
+ * beacon_adv.c drives Bluedroid. With the NimBLE host beacon_adv_nimble.c
+ * implements the same API (always one rotating legacy advertiser), and
+ * there are no GAP events to forward.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_bt.h"
+#if CONFIG_BT_BLUEDROID_ENABLED
+#include "esp_gap_ble_api.h"
+#endif
+
+#define BEACON_ADV_MAX_IDENTITIES  4
+
+/* One iBeacon identity, major/minor in host byte order */
+typedef struct {
+    uint8_t uuid[16];
+    uint16_t major;
+    uint16_t minor;
+    int8_t measured_power;      // RSSI at 1 m, dBm
+} beacon_adv_identity_t;
+
+typedef struct {
+    uint16_t interval_ms;       // 20-10240
+    esp_power_level_t tx_power;
+    uint32_t rotation_ms;       // BLE 4.2 only: time on air per identity
+} beacon_adv_config_t;
+
+/**
+ * Encode the advertising payload of every identity
+ */
+esp_err_t beacon_adv_init(const beacon_adv_identity_t *identities, size_t count, const beacon_adv_config_t *config);
+
+/**
+ * Start advertising all identities (after Bluedroid is enabled, or from
+ * the NimBLE sync callback)
+ */
+esp_err_t beacon_adv_start(void);
+
+/**
+ * Change interval and TX power while advertising. Restarts the
+ * advertiser(s) with the new parameters; Bluedroid stays up and the
+ * payloads are not re-encoded. Call from task context.
+ */
+esp_err_t beacon_adv_set_params(uint16_t interval_ms, esp_power_level_t tx_power);
+
+/**
+ * Re-encode one identity and swap its payload on air, without stopping
+ * the advertiser. Call from task context.
+ */
+esp_err_t beacon_adv_set_identity(size_t index, const beacon_adv_identity_t *identity);
+
+uint16_t beacon_adv_get_interval_ms(void);
+
+#if CONFIG_BT_BLUEDROID_ENABLED
+/**
+ * Forward GAP events here from the application's GAP callback
+ */
+void beacon_adv_handle_gap_event(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+#endif
+
+size_t beacon_adv_identity_count(void);
+
+/**
+ * Advertisers on air: one per identity with BLE 5 sets, else one
+ */
+size_t beacon_adv_advertiser_count(void);
+
+/**
+ * True while the advertiser(s) are on air
+ */
+bool beacon_adv_is_active(void);
+
+/**
+ * True when identities are advertised as parallel BLE 5 advertising sets
+ */
+bool beacon_adv_uses_ext_adv(void);
@@ -0,0 +1,240 @@
+/**
+ * Beacon Advertising Engine - NimBLE Host
+ *
+ * Same engine as beacon_adv.c for builds with the NimBLE host
+ * (CONFIG_BT_NIMBLE_ENABLED), which is much smaller than Bluedroid when
+ * all the device does is advertise. NimBLE's GAP calls complete before
+ * they return, so there is no event plumbing: one legacy non-connectable
+ * advertiser, rotating through the payload table every rotation_ms when
+ * there are several identities (on BLE 5 chips too).
+ *
+ * beacon_adv_start() may only be called once the host has synced with the
+ * controller (ble_hs_cfg.sync_cb).
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host/ble_hs.h"
+#include "esp_ibeacon_api.h"
+#include "beacon_adv.h"
+
+#if CONFIG_BT_NIMBLE_EXT_ADV
+#error "beacon_adv_nimble.c uses the legacy advertising API: disable CONFIG_BT_NIMBLE_EXT_ADV"
+#endif
+
+static const char* TAG = "Beacon-Adv";
+
+// Precomputed advertising payloads, one per identity
+static esp_ble_ibeacon_t s_payloads[BEACON_ADV_MAX_IDENTITIES];
+static size_t s_payload_count = 0;
+static beacon_adv_config_t s_config;
+
+// Payloads can be replaced while the rotation timer reads them
+static portMUX_TYPE s_payload_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_timer_handle_t s_rotation_timer;
+static size_t s_current = 0;
+
+static esp_err_t nimble_err(const char *what, int rc)
+{
+    if (rc == 0) {
+        return ESP_OK;
+    }
+    ESP_LOGE(TAG, "%s failed: NimBLE error %d", what, rc);
+    return ESP_FAIL;
+}
+
+/**
+ * Put the next identity on air; the advertiser keeps running, only its
+ * data changes
+ */
+static void rotation_timer_cb(void *arg)
+{
+    esp_ble_ibeacon_t payload;
+
+    taskENTER_CRITICAL(&s_payload_lock);
+    s_current = (s_current + 1) % s_payload_count;
+    payload = s_payloads[s_current];
+    taskEXIT_CRITICAL(&s_payload_lock);
+
+    ble_gap_adv_set_data((const uint8_t *)&payload, sizeof(payload));
+}
+
+/**
+ * (Re)start the advertiser with the current interval and TX power
+ */
+static esp_err_t start_advertiser(void)
+{
+    if (ble_gap_adv_active()) {
+        ble_gap_adv_stop();
+    }
+
+    const struct ble_gap_adv_params params = {
+        .conn_mode = BLE_GAP_CONN_MODE_NON,
+        .disc_mode = BLE_GAP_DISC_MODE_NON,
+        .itvl_min = BLE_GAP_ADV_ITVL_MS(s_config.interval_ms),
+        .itvl_max = BLE_GAP_ADV_ITVL_MS(s_config.interval_ms),
+    };
+
+    esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_ADV, s_config.tx_power);
+    int rc = ble_gap_adv_start(BLE_OWN_ADDR_PUBLIC, NULL, BLE_HS_FOREVER, &params, NULL, NULL);
+    return nimble_err("Advertising start", rc);
+}
+
+static esp_err_t encode_payload(const beacon_adv_identity_t *identity, esp_ble_ibeacon_t *payload)
+{
+    return esp_ble_ibeacon_encode(identity->uuid, identity->major, identity->minor, identity->measured_power, payload);
+}
+
+esp_err_t beacon_adv_init(const beacon_adv_identity_t *identities, size_t count, const beacon_adv_config_t *config)
+{
+    if (identities == NULL || config == NULL || count == 0 || count > BEACON_ADV_MAX_IDENTITIES ||
+        config->interval_ms < 20 || config->interval_ms > 10240) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (count > 1 && config->rotation_ms < config->interval_ms) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        esp_err_t err = encode_payload(&identities[i], &s_payloads[i]);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Identity %d: invalid iBeacon data", (int)i);
+            return err;
+        }
+        ESP_LOGI(TAG, "Identity %d: major=%d minor=%d", (int)i, identities[i].major, identities[i].minor);
+    }
+
+    s_payload_count = count;
+    s_config = *config;
+    return ESP_OK;
+}
+
+esp_err_t beacon_adv_start(void)
+{
+    if (s_payload_count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Also called again after a host reset, which loses the advertiser
+    if (s_rotation_timer != NULL) {
+        esp_timer_stop(s_rotation_timer);
+    }
+
+    taskENTER_CRITICAL(&s_payload_lock);
+    s_current = 0;
+    esp_ble_ibeacon_t payload = s_payloads[0];
+    taskEXIT_CRITICAL(&s_payload_lock);
+
+    esp_err_t err = nimble_err("Set adv data", ble_gap_adv_set_data((const uint8_t *)&payload, sizeof(payload)));
+    if (err == ESP_OK) {
+        err = start_advertiser();
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (s_payload_count > 1) {
+        if (s_rotation_timer == NULL) {
+            const esp_timer_create_args_t timer_args = {
+                .callback = rotation_timer_cb,
+                .name = "adv_rotate",
+            };
+            err = esp_timer_create(&timer_args, &s_rotation_timer);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        err = esp_timer_start_periodic(s_rotation_timer, (uint64_t)s_config.rotation_ms * 1000);
+        ESP_LOGI(TAG, "Rotating %d identities every %lums", (int)s_payload_count, (unsigned long)s_config.rotation_ms);
+    }
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ iBeacon is broadcasting at %dms intervals (NimBLE)", s_config.interval_ms);
+    }
+    return err;
+}
+
+esp_err_t beacon_adv_set_params(uint16_t interval_ms, esp_power_level_t tx_power)
+{
+    if (interval_ms < 20 || interval_ms > 10240) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_payload_count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (interval_ms == s_config.interval_ms && tx_power == s_config.tx_power) {
+        return ESP_OK;
+    }
+
+    s_config.interval_ms = interval_ms;
+    s_config.tx_power = tx_power;
+
+    // The interval is fixed while advertising: stop and start again
+    esp_err_t err = start_advertiser();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ Advertising now every %dms", interval_ms);
+    }
+    return err;
+}
+
+esp_err_t beacon_adv_set_identity(size_t index, const beacon_adv_identity_t *identity)
+{
+    if (identity == NULL || index >= s_payload_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_ble_ibeacon_t payload;
+    esp_err_t err = encode_payload(identity, &payload);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    taskENTER_CRITICAL(&s_payload_lock);
+    s_payloads[index] = payload;
+    bool on_air = s_current == index;
+    taskEXIT_CRITICAL(&s_payload_lock);
+
+    // Other slots go on air with their next rotation
+    if (on_air) {
+        err = nimble_err("Set adv data", ble_gap_adv_set_data((const uint8_t *)&payload, sizeof(payload)));
+    }
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ Identity %d now major=%d minor=%d", (int)index, identity->major, identity->minor);
+    }
+    return err;
+}
+
+uint16_t beacon_adv_get_interval_ms(void)
+{
+    return s_config.interval_ms;
+}
+
+size_t beacon_adv_identity_count(void)
+{
+    return s_payload_count;
+}
+
+size_t beacon_adv_advertiser_count(void)
+{
+    return s_payload_count > 0 ? 1 : 0;
+}
+
+bool beacon_adv_is_active(void)
+{
+    return ble_gap_adv_active();
+}
+
+bool beacon_adv_uses_ext_adv(void)
+{
+    return false;
+}
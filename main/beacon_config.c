@@ -0,0 +1,246 @@
+/**
+ * Beacon Configuration Store Implementation
+ *
+ * The current configuration lives in RAM; every update writes the whole
+ * blob under one mutex, so updates from different tasks (serial CONFIG
+ * command, Wi-Fi link task) never interleave.
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "beacon_config.h"
+
+static const char* TAG = "NVS";
+
+#define CONFIG_NVS_NAMESPACE "beacon_cfg"
+#define CONFIG_NVS_KEY "config"
+
+// Largest blob accepted, leaving room for fields of newer firmware
+#define CONFIG_MAX_SIZE 512
+
+// Keys of firmware before the blob
+#define LEGACY_KEY_MAJOR "major"
+#define LEGACY_KEY_MINOR "minor"
+#define LEGACY_KEY_UUID  "uuid"
+#define LEGACY_WIFI_NAMESPACE "wifi_link"
+#define LEGACY_WIFI_KEY "ap"
+
+_Static_assert(sizeof(beacon_config_t) == 68, "beacon_config_t layout changed: update flash_beacon.py");
+
+static beacon_config_t s_config;
+static SemaphoreHandle_t s_lock;
+
+static uint32_t config_crc(const uint8_t *data, size_t size)
+{
+    uint8_t zero[4] = {0};
+    uint32_t crc = esp_rom_crc32_le(0, data, offsetof(beacon_config_t, crc));
+    crc = esp_rom_crc32_le(crc, zero, sizeof(zero));
+    return esp_rom_crc32_le(crc, data + offsetof(beacon_config_t, major), size - offsetof(beacon_config_t, major));
+}
+
+/**
+ * Read the blob over the defaults in *config
+ */
+static esp_err_t read_blob(nvs_handle_t nvs_handle, beacon_config_t *config)
+{
+    size_t len = 0;
+    esp_err_t err = nvs_get_blob(nvs_handle, CONFIG_NVS_KEY, NULL, &len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (len < offsetof(beacon_config_t, major) || len > CONFIG_MAX_SIZE) {
+        ESP_LOGE(TAG, "✗ Stored config has an invalid size (%d bytes)", (int)len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t buffer[CONFIG_MAX_SIZE];
+    err = nvs_get_blob(nvs_handle, CONFIG_NVS_KEY, buffer, &len);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    beacon_config_t header;
+    memcpy(&header, buffer, offsetof(beacon_config_t, major));
+    if (header.size != len || config_crc(buffer, len) != header.crc) {
+        ESP_LOGE(TAG, "✗ Stored config is corrupt (CRC mismatch)");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    // Older layouts leave the fields they did not have at their defaults
+    memcpy(config, buffer, len < sizeof(*config) ? len : sizeof(*config));
+    if (header.version != BEACON_CONFIG_VERSION) {
+        ESP_LOGI(TAG, "Config layout %d, this firmware uses %d", header.version, BEACON_CONFIG_VERSION);
+    }
+    return ESP_OK;
+}
+
+/**
+ * Write *config as one blob. Callers hold s_lock.
+ */
+static esp_err_t write_blob(beacon_config_t *config)
+{
+    config->version = BEACON_CONFIG_VERSION;
+    config->size = sizeof(*config);
+    config->crc = config_crc((const uint8_t *)config, sizeof(*config));
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(CONFIG_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs_handle, CONFIG_NVS_KEY, config, sizeof(*config));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+/**
+ * Read the separate keys of earlier firmware over *config
+ * Returns true if there were any
+ */
+static bool read_legacy(nvs_handle_t nvs_handle, beacon_config_t *config)
+{
+    bool found = false;
+    if (nvs_get_u16(nvs_handle, LEGACY_KEY_MAJOR, &config->major) == ESP_OK) {
+        found = true;
+    }
+    if (nvs_get_u16(nvs_handle, LEGACY_KEY_MINOR, &config->minor) == ESP_OK) {
+        found = true;
+    }
+    uint8_t uuid[16];
+    size_t uuid_len = sizeof(uuid);
+    if (nvs_get_blob(nvs_handle, LEGACY_KEY_UUID, uuid, &uuid_len) == ESP_OK && uuid_len == sizeof(uuid)) {
+        memcpy(config->uuid, uuid, sizeof(uuid));
+        found = true;
+    }
+
+    nvs_handle_t wifi_handle;
+    if (nvs_open(LEGACY_WIFI_NAMESPACE, NVS_READONLY, &wifi_handle) == ESP_OK) {
+        beacon_config_wifi_t wifi;
+        size_t len = sizeof(wifi);
+        if (nvs_get_blob(wifi_handle, LEGACY_WIFI_KEY, &wifi, &len) == ESP_OK && len == sizeof(wifi)) {
+            config->wifi = wifi;
+        }
+        nvs_close(wifi_handle);
+    }
+    return found;
+}
+
+/**
+ * Erase the keys read_legacy migrated, once the blob holds them
+ */
+static void erase_legacy(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(CONFIG_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        nvs_erase_key(nvs_handle, LEGACY_KEY_MAJOR);
+        nvs_erase_key(nvs_handle, LEGACY_KEY_MINOR);
+        nvs_erase_key(nvs_handle, LEGACY_KEY_UUID);
+        nvs_commit(nvs_handle);
+        nvs_close(nvs_handle);
+    }
+    if (nvs_open(LEGACY_WIFI_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        nvs_erase_all(nvs_handle);
+        nvs_commit(nvs_handle);
+        nvs_close(nvs_handle);
+    }
+}
+
+esp_err_t beacon_config_init(const beacon_config_t *defaults)
+{
+    s_lock = xSemaphoreCreateMutex();
+    s_config = *defaults;
+
+    bool legacy = false;
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    nvs_handle_t nvs_handle;
+    if (nvs_open(CONFIG_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        err = read_blob(nvs_handle, &s_config);
+        if (err != ESP_OK) {
+            s_config = *defaults;
+        }
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            legacy = read_legacy(nvs_handle, &s_config);
+        }
+        nvs_close(nvs_handle);
+    }
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ Loaded config: major=%d minor=%d", s_config.major, s_config.minor);
+        return ESP_OK;
+    }
+
+    // First boot, firmware from before the blob, or a corrupt blob
+    err = write_blob(&s_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "✗ Failed to save config: %s", esp_err_to_name(err));
+    } else if (legacy) {
+        erase_legacy();
+        ESP_LOGI(TAG, "✓ Migrated config from separate keys: major=%d minor=%d", s_config.major, s_config.minor);
+        return ESP_OK;
+    } else {
+        ESP_LOGI(TAG, "No stored config, saved the defaults");
+    }
+    return legacy ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void beacon_config_get(beacon_config_t *config)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *config = s_config;
+    xSemaphoreGive(s_lock);
+}
+
+/**
+ * Store updated, a modified copy of the current configuration
+ */
+static esp_err_t update(beacon_config_t *updated)
+{
+    // Header fields are rewritten by write_blob; compare the rest
+    updated->version = s_config.version;
+    updated->size = s_config.size;
+    updated->crc = s_config.crc;
+    if (memcmp(updated, &s_config, sizeof(s_config)) == 0) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = write_blob(updated);
+    if (err == ESP_OK) {
+        s_config = *updated;
+    }
+    return err;
+}
+
+esp_err_t beacon_config_set_identity(uint16_t major, uint16_t minor, const uint8_t uuid[16])
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    beacon_config_t updated = s_config;
+    updated.major = major;
+    updated.minor = minor;
+    memcpy(updated.uuid, uuid, sizeof(updated.uuid));
+    esp_err_t err = update(&updated);
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t beacon_config_set_wifi(const beacon_config_wifi_t *wifi)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    beacon_config_t updated = s_config;
+    updated.wifi = *wifi;
+    esp_err_t err = update(&updated);
+    xSemaphoreGive(s_lock);
+    return err;
+}
@@ -0,0 +1,74 @@
+/**
+ * Beacon Configuration Store
+ *
+ * The settings a beacon keeps across reboots and updates, in one versioned,
+ * CRC-protected blob (NVS key "config" in namespace "beacon_cfg"): read with
+ * a single nvs_get_blob at boot and written with a single set and commit,
+ * so an update is either fully stored or not at all.
+ *
+ * Fields are only ever appended. A blob written by an older firmware is
+ * read up to its size (the rest keeps the defaults); one written by a newer
+ * firmware is read up to this one's. The separate keys of earlier firmware
+ * ("major", "minor", "uuid" and the Wi-Fi AP cache) are migrated into the
+ * blob on the first boot and then erased.
+ *
+ * The OTA resume state and self-test record stay in their own namespace:
+ * the resume state is checkpointed every 64 KB of a download, which would
+ * rewrite the identity each time.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Layout version of beacon_config_t; flash_beacon.py writes the same layout
+#define BEACON_CONFIG_VERSION 1
+
+/**
+ * Last access point joined, for a connect without a full scan
+ */
+typedef struct {
+    char ssid[33];              // Only used for this SSID
+    uint8_t bssid[6];
+    uint8_t channel;            // 0 = nothing cached
+} beacon_config_wifi_t;
+
+/**
+ * Stored configuration (little endian, no padding)
+ */
+typedef struct {
+    uint16_t version;           // BEACON_CONFIG_VERSION it was written with
+    uint16_t size;              // sizeof(beacon_config_t) it was written with
+    uint32_t crc;               // CRC-32 of the first size bytes, with crc = 0
+    uint16_t major;
+    uint16_t minor;
+    uint8_t uuid[16];
+    beacon_config_wifi_t wifi;
+} beacon_config_t;
+
+/**
+ * Load the configuration, migrating the keys of earlier firmware. Call
+ * once after nvs_flash_init, with the firmware defaults in *defaults.
+ * Returns ESP_OK if a stored configuration was found, ESP_ERR_NOT_FOUND
+ * if the defaults were stored instead (first boot, or a corrupt blob).
+ */
+esp_err_t beacon_config_init(const beacon_config_t *defaults);
+
+/**
+ * Copy of the current configuration
+ */
+void beacon_config_get(beacon_config_t *config);
+
+/**
+ * Store a new identity; nothing is written if it is unchanged
+ */
+esp_err_t beacon_config_set_identity(uint16_t major, uint16_t minor, const uint8_t uuid[16]);
+
+/**
+ * Store the AP cache; nothing is written if it is unchanged
+ */
+esp_err_t beacon_config_set_wifi(const beacon_config_wifi_t *wifi);
@@ -0,0 +1,530 @@
+/**
+ * Beacon Scanner Implementation
+ *
+ * The GAP callback (BT task) inserts under a spinlock held for one probe
+ * sequence; the reporter task swaps the table out under the same lock and
+ * formats the report from its private copy.
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_mac.h"
+#include "esp_http_client.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_ibeacon_api.h"
+#include "tls_profile.h"
+#include "beacon_scan.h"
+
+static const char* TAG = "BeaconScan";
+
+// UUID | major | minor, big endian as in the packet
+#define SIGHTING_KEY_LEN        20
+#define SIGHTING_KEY_OFFSET     offsetof(esp_ble_ibeacon_t, ibeacon_vendor.proximity_uuid)
+
+// Longest report line of one beacon (187 bytes with every number at its
+// widest), and the header plus the closing "]}" fit in the rest
+#define REPORT_LINE_MAX         192
+#define REPORT_PAYLOAD_SIZE     (BEACON_SCAN_REPORT_MAX * REPORT_LINE_MAX + 256)
+
+_Static_assert((BEACON_SCAN_TABLE_SIZE & (BEACON_SCAN_TABLE_SIZE - 1)) == 0, "table size must be a power of two");
+
+// Advertising events are spaced interval + 0..10 ms of random advDelay
+#define ADV_DELAY_MEAN_MS       5
+
+typedef struct {
+    uint8_t key[SIGHTING_KEY_LEN];
+    uint32_t last_seen_ms;      // 0 until first heard
+    uint32_t first_seen_ms;     // First packet of this period
+    int16_t rssi_q4;            // Smoothed RSSI x16
+    uint16_t count;
+    uint16_t gap_max_ms;
+    uint16_t missed;
+    int8_t rssi_max;
+    bool used;
+    uint16_t reserved;
+} sighting_slot_t;
+
+_Static_assert(sizeof(sighting_slot_t) == 40, "keep slots small");
+
+// Shared with the GAP callback
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static sighting_slot_t *s_table;
+static uint32_t s_entries;
+static beacon_scan_stats_t s_stats;
+static volatile bool s_connected;
+static uint16_t s_major;
+static uint16_t s_minor;
+static uint32_t s_adv_spacing_ms;       // Expected time between events, 0 = unknown
+
+// Reporter task only
+static beacon_scan_config_t s_config;
+static sighting_slot_t *s_previous;     // Table of the period being reported
+static char *s_payload;
+static esp_http_client_handle_t s_client;
+static tls_profile_stats_t s_tls_stats = TLS_PROFILE_STATS_INIT("gateway");
+static char s_mac_str[18];
+static uint32_t s_period_start_ms;
+
+static uint32_t uptime_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+/**
+ * FNV-1a over the key
+ */
+static uint32_t key_hash(const uint8_t *key)
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < SIGHTING_KEY_LEN; i++) {
+        hash = (hash ^ key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Find the slot of key, or claim a free one. Caller holds the lock.
+ */
+static sighting_slot_t *find_slot(sighting_slot_t *table, const uint8_t *key)
+{
+    uint32_t index = key_hash(key);
+    for (int probe = 0; probe < BEACON_SCAN_MAX_PROBE; probe++) {
+        sighting_slot_t *slot = &table[(index + probe) & (BEACON_SCAN_TABLE_SIZE - 1)];
+        if (!slot->used) {
+            memcpy(slot->key, key, SIGHTING_KEY_LEN);
+            slot->used = true;
+            slot->count = 0;
+            slot->gap_max_ms = 0;
+            slot->missed = 0;
+            slot->last_seen_ms = 0;
+            slot->rssi_max = INT8_MIN;
+            slot->rssi_q4 = INT16_MIN;
+            s_entries++;
+            return slot;
+        }
+        if (memcmp(slot->key, key, SIGHTING_KEY_LEN) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static void record_gap(sighting_slot_t *slot, uint32_t gap_ms)
+{
+    if (gap_ms > UINT16_MAX) {
+        gap_ms = UINT16_MAX;
+    }
+    if (gap_ms > slot->gap_max_ms) {
+        slot->gap_max_ms = gap_ms;
+    }
+
+    // A gap of n event spacings means n - 1 events went unheard
+    if (s_adv_spacing_ms > 0) {
+        uint32_t events = (gap_ms + s_adv_spacing_ms / 2) / s_adv_spacing_ms;
+        if (events > 1 && slot->missed < UINT16_MAX - events) {
+            slot->missed += events - 1;
+        }
+    }
+}
+
+bool beacon_scan_process(const uint8_t *adv_data, uint8_t adv_data_len, int8_t rssi)
+{
+    bool is_ibeacon = esp_ble_is_ibeacon_packet(adv_data, adv_data_len);
+    const uint8_t *key = adv_data + SIGHTING_KEY_OFFSET;
+    uint32_t now = uptime_ms();
+    bool recorded = false;
+
+    taskENTER_CRITICAL(&s_lock);
+    s_stats.adv_reports++;
+    if (is_ibeacon && s_table != NULL) {
+        s_stats.ibeacon_reports++;
+        sighting_slot_t *slot = find_slot(s_table, key);
+        if (slot != NULL) {
+            slot->rssi_q4 = slot->rssi_q4 == INT16_MIN ? rssi * 16 : slot->rssi_q4 + (rssi * 16 - slot->rssi_q4) / 8;
+            if (rssi > slot->rssi_max) {
+                slot->rssi_max = rssi;
+            }
+            if (slot->last_seen_ms != 0) {
+                record_gap(slot, now - slot->last_seen_ms);
+            }
+            if (slot->count == 0) {
+                slot->first_seen_ms = now;
+            }
+            if (slot->count < UINT16_MAX) {
+                slot->count++;
+            }
+            slot->last_seen_ms = now;
+            recorded = true;
+        } else {
+            s_stats.dropped++;
+        }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    return recorded;
+}
+
+/**
+ * Start a new period: swap in an empty table, put back what has not
+ * expired, and return the old one (valid until the next swap)
+ */
+static const sighting_slot_t *swap_period(uint32_t expire_ms)
+{
+    uint32_t now = uptime_ms();
+
+    // The GAP callback only writes s_table, so clear the spare one first:
+    // interrupts stay off for the swap and re-insert only
+    memset(s_previous, 0, BEACON_SCAN_TABLE_SIZE * sizeof(sighting_slot_t));
+
+    taskENTER_CRITICAL(&s_lock);
+    sighting_slot_t *previous = s_table;
+    s_table = s_previous;
+    s_previous = previous;
+    s_entries = 0;
+    for (int i = 0; i < BEACON_SCAN_TABLE_SIZE; i++) {
+        const sighting_slot_t *old = &previous[i];
+        if (old->used && now - old->last_seen_ms < expire_ms) {
+            sighting_slot_t *slot = find_slot(s_table, old->key);
+            if (slot != NULL) {
+                slot->rssi_q4 = old->rssi_q4;
+                slot->last_seen_ms = old->last_seen_ms;
+            }
+        }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    return previous;
+}
+
+static void slot_to_sighting(const sighting_slot_t *slot, beacon_sighting_t *sighting)
+{
+    memcpy(sighting->uuid, slot->key, sizeof(sighting->uuid));
+    sighting->major = ((uint16_t)slot->key[16] << 8) | slot->key[17];
+    sighting->minor = ((uint16_t)slot->key[18] << 8) | slot->key[19];
+    sighting->rssi = (int8_t)(slot->rssi_q4 / 16);
+    sighting->rssi_max = slot->rssi_max;
+    sighting->count = slot->count;
+    sighting->last_seen_ms = slot->last_seen_ms;
+    sighting->gap_mean_ms = slot->count > 1 ? (slot->last_seen_ms - slot->first_seen_ms) / (slot->count - 1) : 0;
+    sighting->gap_max_ms = slot->gap_max_ms;
+    sighting->missed = slot->missed;
+}
+
+size_t beacon_scan_collect(beacon_sighting_t *out, size_t max, uint32_t expire_ms)
+{
+    if (s_table == NULL) {
+        return 0;
+    }
+
+    const sighting_slot_t *previous = swap_period(expire_ms);
+    size_t n = 0;
+    for (int i = 0; i < BEACON_SCAN_TABLE_SIZE && n < max; i++) {
+        if (previous[i].used && previous[i].count > 0) {
+            slot_to_sighting(&previous[i], &out[n++]);
+        }
+    }
+    return n;
+}
+
+void beacon_scan_get_stats(beacon_scan_stats_t *stats)
+{
+    taskENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    stats->entries = s_entries;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static esp_err_t report_http_event_handler(esp_http_client_event_t *evt)
+{
+    tls_profile_http_event(&s_tls_stats, evt);
+    return ESP_OK;
+}
+
+static bool ensure_client(void)
+{
+    if (s_client != NULL) {
+        return true;
+    }
+
+    esp_http_client_config_t config = {
+        .url = s_config.report_url,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = 10000,
+        .keep_alive_enable = true,
+        .event_handler = report_http_event_handler,
+    };
+    tls_profile_apply(&config);
+    s_client = esp_http_client_init(&config);
+    if (s_client == NULL) {
+        ESP_LOGE(TAG, "Failed to initialize HTTP client");
+        return false;
+    }
+    esp_http_client_set_header(s_client, "Content-Type", "application/json");
+    return true;
+}
+
+/**
+ * Format up to BEACON_SCAN_REPORT_MAX sightings from slot *index on as
+ * JSON; advances *index. Returns the payload length.
+ */
+static size_t format_report(const sighting_slot_t *table, int *index, const beacon_scan_stats_t *stats,
+                            uint32_t now, int *count)
+{
+    taskENTER_CRITICAL(&s_lock);
+    uint16_t major = s_major;
+    uint16_t minor = s_minor;
+    taskEXIT_CRITICAL(&s_lock);
+
+    int n = snprintf(s_payload, REPORT_PAYLOAD_SIZE,
+                     "{\"gateway\":{\"mac\":\"%s\",\"major\":%u,\"minor\":%u},\"period_ms\":%lu,"
+                     "\"adv_reports\":%lu,\"ibeacon_reports\":%lu,\"dropped\":%lu,\"beacons\":[",
+                     s_mac_str, major, minor, (unsigned long)(now - s_period_start_ms),
+                     (unsigned long)stats->adv_reports, (unsigned long)stats->ibeacon_reports,
+                     (unsigned long)stats->dropped);
+    size_t len = (n > 0 && n < REPORT_PAYLOAD_SIZE) ? (size_t)n : 0;
+
+    // A line that does not fit is left for the next batch
+    *count = 0;
+    for (; *index < BEACON_SCAN_TABLE_SIZE && *count < BEACON_SCAN_REPORT_MAX; (*index)++) {
+        if (!table[*index].used || table[*index].count == 0) {
+            continue;
+        }
+        if (REPORT_PAYLOAD_SIZE - len < REPORT_LINE_MAX + sizeof("]}")) {
+            break;
+        }
+        beacon_sighting_t s;
+        slot_to_sighting(&table[*index], &s);
+        n = snprintf(s_payload + len, REPORT_PAYLOAD_SIZE - len,
+                     "%s{\"uuid\":\"%02X%02X%02X%02X-%02X%02X-%02X%02X-%02X%02X-%02X%02X%02X%02X%02X%02X\","
+                     "\"major\":%u,\"minor\":%u,\"rssi\":%d,\"rssi_max\":%d,\"count\":%u,\"age_ms\":%lu,"
+                     "\"gap_ms\":%u,\"gap_max_ms\":%u,\"missed\":%u}",
+                     *count == 0 ? "" : ",",
+                     s.uuid[0], s.uuid[1], s.uuid[2], s.uuid[3], s.uuid[4], s.uuid[5],
+                     s.uuid[6], s.uuid[7], s.uuid[8], s.uuid[9], s.uuid[10], s.uuid[11],
+                     s.uuid[12], s.uuid[13], s.uuid[14], s.uuid[15],
+                     s.major, s.minor, s.rssi, s.rssi_max, s.count,
+                     (unsigned long)(now - s.last_seen_ms), s.gap_mean_ms, s.gap_max_ms, s.missed);
+        if (n <= 0 || (size_t)n >= REPORT_PAYLOAD_SIZE - len - sizeof("]}")) {
+            break;
+        }
+        len += n;
+        (*count)++;
+    }
+    strcpy(s_payload + len, "]}");
+    return len + 2;
+}
+
+/**
+ * POST one batch. Returns false if the rest of the report should wait.
+ */
+static bool post_report(size_t len, int count)
+{
+    if (!ensure_client()) {
+        return false;
+    }
+    esp_http_client_set_post_field(s_client, s_payload, len);
+    tls_profile_request_begin(&s_tls_stats);
+    esp_err_t err = esp_http_client_perform(s_client);
+    tls_profile_request_end(&s_tls_stats);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️  Failed to send report of %d beacons: %s", count, esp_err_to_name(err));
+        esp_http_client_close(s_client);
+        return false;
+    }
+
+    int status_code = esp_http_client_get_status_code(s_client);
+    if (status_code != 200 && status_code != 204) {
+        ESP_LOGW(TAG, "⚠️  Report rejected with status %d", status_code);
+        return false;
+    }
+    return true;
+}
+
+static void send_report(void)
+{
+    uint32_t now = uptime_ms();
+    beacon_scan_stats_t stats;
+
+    // Period counters restart with the table
+    taskENTER_CRITICAL(&s_lock);
+    stats = s_stats;
+    memset(&s_stats, 0, sizeof(s_stats));
+    taskEXIT_CRITICAL(&s_lock);
+
+    const sighting_slot_t *table = swap_period(s_config.expire_ms);
+    int index = 0;
+    int total = 0;
+    int batches = 0;
+    do {
+        int count;
+        size_t len = format_report(table, &index, &stats, now, &count);
+        if (count == 0 && batches > 0) {
+            break;
+        }
+        if (!post_report(len, count)) {
+            break;
+        }
+        total += count;
+        batches++;
+    } while (index < BEACON_SCAN_TABLE_SIZE);
+    s_period_start_ms = now;
+
+    if (batches > 0) {
+        ESP_LOGI(TAG, "✓ Reported %d beacons from %lu iBeacon packets in %d request%s", total,
+                 (unsigned long)stats.ibeacon_reports, batches, batches == 1 ? "" : "s");
+    }
+}
+
+static void report_task(void *pvParameter)
+{
+    s_period_start_ms = uptime_ms();
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(s_config.report_interval_ms));
+        if (s_connected) {
+            send_report();
+        }
+    }
+}
+
+/**
+ * Continuous passive scan: window equals interval
+ */
+static esp_err_t start_scan(void)
+{
+    uint16_t interval = s_config.scan_interval_ms * 1000 / 625;
+
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    esp_ble_ext_scan_params_t scan_params = {
+        .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+        .filter_policy = BLE_SCAN_FILTER_ALLOW_ALL,
+        .scan_duplicate = BLE_SCAN_DUPLICATE_DISABLE,
+        .cfg_mask = ESP_BLE_GAP_EXT_SCAN_CFG_UNCODE_MASK,
+        .uncoded_cfg = { BLE_SCAN_TYPE_PASSIVE, interval, interval },
+    };
+    return esp_ble_gap_set_ext_scan_params(&scan_params);
+#else
+    // Every packet is reported (no duplicate filter): RSSI needs the samples
+    esp_ble_scan_params_t scan_params = {
+        .scan_type = BLE_SCAN_TYPE_PASSIVE,
+        .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+        .scan_filter_policy = BLE_SCAN_FILTER_ALLOW_ALL,
+        .scan_interval = interval,
+        .scan_window = interval,
+        .scan_duplicate = BLE_SCAN_DUPLICATE_DISABLE,
+    };
+    return esp_ble_gap_set_scan_params(&scan_params);
+#endif
+}
+
+esp_err_t beacon_scan_start(const beacon_scan_config_t *config)
+{
+    if (config == NULL || (config->report_url != NULL && config->report_interval_ms == 0) ||
+        config->scan_interval_ms < 3 || config->scan_interval_ms > 10240) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_config = *config;
+    beacon_scan_set_device(config->major, config->minor);
+    s_adv_spacing_ms = config->adv_interval_ms > 0 ? config->adv_interval_ms + ADV_DELAY_MEAN_MS : 0;
+
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(s_mac_str, sizeof(s_mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    // Gateway-only buffers, so beacons do not pay for them
+    sighting_slot_t *table = calloc(BEACON_SCAN_TABLE_SIZE, sizeof(sighting_slot_t));
+    s_previous = calloc(BEACON_SCAN_TABLE_SIZE, sizeof(sighting_slot_t));
+    s_payload = malloc(REPORT_PAYLOAD_SIZE);
+    if (table == NULL || s_previous == NULL || s_payload == NULL) {
+        free(table);
+        free(s_previous);
+        free(s_payload);
+        return ESP_ERR_NO_MEM;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    s_table = table;
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (config->report_url != NULL && xTaskCreate(report_task, "gateway", 4096, NULL, 3, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = start_scan();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ Scanning, %d-beacon table, report every %lu s",
+                 BEACON_SCAN_TABLE_SIZE, (unsigned long)(config->report_interval_ms / 1000));
+    }
+    return err;
+}
+
+void beacon_scan_handle_gap_event(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    switch (event) {
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    case ESP_GAP_BLE_SET_EXT_SCAN_PARAMS_COMPLETE_EVT:
+        if (param->set_ext_scan_params.status == ESP_BT_STATUS_SUCCESS) {
+            esp_ble_gap_start_ext_scan(0, 0);   // Until stopped
+        } else {
+            ESP_LOGE(TAG, "Scan parameters rejected: %d", param->set_ext_scan_params.status);
+        }
+        break;
+    case ESP_GAP_BLE_EXT_SCAN_START_COMPLETE_EVT:
+        if (param->ext_scan_start.status != ESP_BT_STATUS_SUCCESS) {
+            ESP_LOGE(TAG, "Scan start failed: %d", param->ext_scan_start.status);
+        }
+        break;
+    case ESP_GAP_BLE_EXT_ADV_REPORT_EVT:
+        beacon_scan_process(param->ext_adv_report.params.adv_data, param->ext_adv_report.params.adv_data_len,
+                            param->ext_adv_report.params.rssi);
+        break;
+#else
+    case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT:
+        if (param->scan_param_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+            esp_ble_gap_start_scanning(0);      // Until stopped
+        } else {
+            ESP_LOGE(TAG, "Scan parameters rejected: %d", param->scan_param_cmpl.status);
+        }
+        break;
+    case ESP_GAP_BLE_SCAN_START_COMPLETE_EVT:
+        if (param->scan_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+            ESP_LOGE(TAG, "Scan start failed: %d", param->scan_start_cmpl.status);
+        }
+        break;
+    case ESP_GAP_BLE_SCAN_RESULT_EVT:
+        if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_RES_EVT) {
+            beacon_scan_process(param->scan_rst.ble_adv, param->scan_rst.adv_data_len, param->scan_rst.rssi);
+        }
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+void beacon_scan_set_connected(bool connected)
+{
+    s_connected = connected;
+}
+
+void beacon_scan_set_device(uint16_t major, uint16_t minor)
+{
+    taskENTER_CRITICAL(&s_lock);
+    s_major = major;
+    s_minor = minor;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+const tls_profile_stats_t *beacon_scan_tls_stats(void)
+{
+    return &s_tls_stats;
+}
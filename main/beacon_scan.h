@@ -0,0 +1,114 @@
+/**
+ * Beacon Scanner (Gateway Mode)
+ *
+ * With IBEACON_MODE set to IBEACON_RECEIVER the unit scans continuously
+ * instead of advertising. Every advertisement that esp_ble_is_ibeacon_packet()
+ * accepts updates a fixed-size sighting table keyed by (UUID, major, minor):
+ * smoothed RSSI, strongest RSSI, packet count and last-seen time.
+ *
+ * The gap between packets of a beacon is tracked too (mean and maximum).
+ * Given the fleet's advertising interval, gaps spanning several intervals
+ * are counted as missed advertising events - the on-air jitter a phone
+ * sees, e.g. while a beacon downloads an OTA image. The gateway's own
+ * Wi-Fi traffic can cost it packets as well, so compare against a quiet
+ * baseline.
+ *
+ * The table is open addressing with linear probing over an array of
+ * 40-byte entries, so an insert or update is a hash and a few cache lines,
+ * with no allocation per advertisement. When the probe limit is reached
+ * the advertisement is counted as dropped rather than searched further.
+ *
+ * A reporter task POSTs a JSON summary of everything heard since the
+ * previous report every report interval, BEACON_SCAN_REPORT_MAX beacons
+ * per request over one keep-alive connection. Beacons not heard for
+ * expire_ms are removed from the table then. With random keys the first
+ * drop comes at about 80% of BEACON_SCAN_TABLE_SIZE.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_gap_ble_api.h"
+#include "tls_profile.h"
+
+#define BEACON_SCAN_TABLE_SIZE  512     // Power of two; 20 KB per table
+#define BEACON_SCAN_MAX_PROBE   32      // Slots searched before dropping
+#define BEACON_SCAN_REPORT_MAX  64      // Beacons per POST
+
+typedef struct {
+    uint8_t uuid[16];
+    uint16_t major;
+    uint16_t minor;
+    int8_t rssi;                // Smoothed (EWMA, 1/8 weight per packet)
+    int8_t rssi_max;            // Strongest since the last report
+    uint16_t count;             // Packets since the last report
+    uint32_t last_seen_ms;      // Since boot
+    uint16_t gap_mean_ms;       // Between packets, 0 if fewer than two
+    uint16_t gap_max_ms;
+    uint16_t missed;            // Advertising events not heard (estimate)
+} beacon_sighting_t;
+
+// Counted since the last report
+typedef struct {
+    uint32_t adv_reports;       // Advertisements received
+    uint32_t ibeacon_reports;   // Of those, iBeacon packets
+    uint32_t dropped;           // iBeacon packets lost to a full table
+    uint32_t entries;           // Beacons in the table now
+} beacon_scan_stats_t;
+
+typedef struct {
+    const char *report_url;     // Receives the JSON summaries; NULL: no reporter, use collect
+    uint32_t report_interval_ms;
+    uint32_t expire_ms;         // Forget beacons not heard for this long
+    uint16_t scan_interval_ms;  // Window equals interval: continuous scan
+    uint16_t adv_interval_ms;   // Beacons' advertising interval; 0: no missed count
+    uint16_t major;             // Gateway identity in each report
+    uint16_t minor;
+} beacon_scan_config_t;
+
+/**
+ * Start scanning and the reporter task. Bluetooth must be up.
+ */
+esp_err_t beacon_scan_start(const beacon_scan_config_t *config);
+
+/**
+ * Call from the application's GAP event handler
+ */
+void beacon_scan_handle_gap_event(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+
+/**
+ * Feed one advertisement into the table; returns true if it was an
+ * iBeacon packet that was recorded. Safe from any task.
+ */
+bool beacon_scan_process(const uint8_t *adv_data, uint8_t adv_data_len, int8_t rssi);
+
+/**
+ * Copy out the beacons heard since the last collect (at most max) and
+ * start a new report period; entries older than expire_ms are removed.
+ * Returns the number copied. Only for a scanner started without a
+ * report_url, the reporter task uses it otherwise.
+ */
+size_t beacon_scan_collect(beacon_sighting_t *out, size_t max, uint32_t expire_ms);
+
+void beacon_scan_get_stats(beacon_scan_stats_t *stats);
+
+/**
+ * Tell the reporter whether the network is up. While it is down the table
+ * keeps counting and the next report covers the whole gap.
+ */
+void beacon_scan_set_connected(bool connected);
+
+/**
+ * Update the gateway identity reported with each summary
+ */
+void beacon_scan_set_device(uint16_t major, uint16_t minor);
+
+/**
+ * Connection stats of the report client
+ */
+const tls_profile_stats_t *beacon_scan_tls_stats(void);
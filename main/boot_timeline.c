@@ -0,0 +1,75 @@
+/**
+ * Boot Timeline Implementation
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "boot_timeline.h"
+
+static const char* TAG = "Boot";
+
+static const char *s_stage_names[BOOT_STAGE_COUNT] = {
+    [BOOT_STAGE_APP_START]      = "app_start",
+    [BOOT_STAGE_CONFIG_LOADED]  = "config_loaded",
+    [BOOT_STAGE_BT_READY]       = "bt_ready",
+    [BOOT_STAGE_FIRST_ADV]      = "first_adv",
+    [BOOT_STAGE_WIFI_CONNECTED] = "wifi_connected",
+    [BOOT_STAGE_TIME_SYNCED]    = "time_synced",
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_stage_us[BOOT_STAGE_COUNT];
+
+void boot_timeline_mark(boot_stage_t stage)
+{
+    if (stage >= BOOT_STAGE_COUNT) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    bool first = false;
+
+    taskENTER_CRITICAL(&s_lock);
+    if (s_stage_us[stage] == 0) {
+        s_stage_us[stage] = now;
+        first = true;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (first) {
+        ESP_LOGI(TAG, "⏱️  %s at %lld ms", s_stage_names[stage], now / 1000);
+    }
+}
+
+int32_t boot_timeline_get_ms(boot_stage_t stage)
+{
+    if (stage >= BOOT_STAGE_COUNT || s_stage_us[stage] == 0) {
+        return -1;
+    }
+    return (int32_t)(s_stage_us[stage] / 1000);
+}
+
+const char *boot_timeline_stage_name(boot_stage_t stage)
+{
+    return (stage < BOOT_STAGE_COUNT) ? s_stage_names[stage] : "unknown";
+}
+
+void boot_timeline_log(void)
+{
+    ESP_LOGI(TAG, "========== Boot Timeline ==========");
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        int32_t ms = boot_timeline_get_ms(i);
+        if (ms < 0) {
+            ESP_LOGI(TAG, "%-15s         -", s_stage_names[i]);
+        } else {
+            ESP_LOGI(TAG, "%-15s %6ld ms", s_stage_names[i], (long)ms);
+        }
+    }
+    ESP_LOGI(TAG, "===================================");
+}
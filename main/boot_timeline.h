@@ -0,0 +1,37 @@
+/**
+ * Boot Timeline
+ *
+ * Timestamps of the boot stages, in ms since the esp_timer started (shortly
+ * after the bootloader hands over), so time-to-first-advertisement can be
+ * tracked across firmware versions. Each stage keeps its first mark.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef enum {
+    BOOT_STAGE_APP_START,       // app_main entered
+    BOOT_STAGE_CONFIG_LOADED,   // NVS up, beacon config read
+    BOOT_STAGE_BT_READY,        // Controller and Bluedroid enabled
+    BOOT_STAGE_FIRST_ADV,       // Controller confirmed advertising started
+    BOOT_STAGE_WIFI_CONNECTED,  // Got an IP address
+    BOOT_STAGE_TIME_SYNCED,     // SNTP set the clock
+    BOOT_STAGE_COUNT
+} boot_stage_t;
+
+/**
+ * Record that a stage was reached; safe from any task
+ */
+void boot_timeline_mark(boot_stage_t stage);
+
+/**
+ * Time a stage was reached in ms, -1 if not reached yet
+ */
+int32_t boot_timeline_get_ms(boot_stage_t stage);
+
+const char *boot_timeline_stage_name(boot_stage_t stage);
+
+void boot_timeline_log(void);
@@ -0,0 +1,105 @@
+#!/bin/bash
+# Pin the root CA certificates of the webhook and OTA endpoints
+#
+# Fetches the certificate chain each host presents, verifies it against the
+# system CA store and pins the self-signed root it ends in, writing them all
+# to pinned_ca.pem next to this script. The firmware then trusts only these
+# instead of the certificate bundle. Servers do not send their root, and the
+# intermediates they do send rotate far more often, so pinning one of those
+# would break HTTPS on every beacon at the next rotation.
+# Re-run when an endpoint changes its certificate authority.
+#
+# Usage: ./update_pinned_ca.sh [host ...]   (default: discord.com)
+#        CA_FILE=/path/to/ca-bundle.pem ./update_pinned_ca.sh ...
+
+set -e
+
+cd "$(dirname "$0")"
+HOSTS=("$@")
+[ ${#HOSTS[@]} -eq 0 ] && HOSTS=("discord.com")
+
+if [ -z "$CA_FILE" ]; then
+    for f in /etc/ssl/certs/ca-certificates.crt /etc/pki/tls/certs/ca-bundle.crt /etc/ssl/cert.pem; do
+        [ -f "$f" ] && CA_FILE=$f && break
+    done
+fi
+if [ ! -f "$CA_FILE" ]; then
+    echo "✗ No system CA file found, set CA_FILE"
+    exit 1
+fi
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# Split a PEM bundle into $2/0.pem, $2/1.pem, ...
+split_pem() {
+    mkdir -p "$2"
+    awk -v dir="$2" '/BEGIN CERTIFICATE/{n++; out=dir "/" n-1 ".pem"} out{print > out} /END CERTIFICATE/{close(out); out=""}' "$1"
+}
+
+is_self_signed() {
+    [ "$(openssl x509 -in "$1" -noout -subject -nameopt RFC2253 | sed 's/^subject=//')" = \
+      "$(openssl x509 -in "$1" -noout -issuer -nameopt RFC2253 | sed 's/^issuer=//')" ]
+}
+
+split_pem "$CA_FILE" "$TMP/store"
+
+OUT=pinned_ca.pem.tmp
+: > "$OUT"
+for host in "${HOSTS[@]}"; do
+    echo "Fetching chain of $host..."
+    rm -rf "$TMP/chain"
+    openssl s_client -connect "$host:443" -servername "$host" -showcerts </dev/null 2>/dev/null > "$TMP/chain.txt" || true
+    split_pem "$TMP/chain.txt" "$TMP/chain"
+    if [ ! -f "$TMP/chain/0.pem" ]; then
+        echo "✗ No certificate from $host"
+        rm -f "$OUT"
+        exit 1
+    fi
+    cat "$TMP"/chain/*.pem > "$TMP/untrusted.pem"
+    if ! openssl verify -CAfile "$CA_FILE" -untrusted "$TMP/untrusted.pem" "$TMP/chain/0.pem" >/dev/null 2>&1; then
+        echo "✗ Chain of $host does not verify against $CA_FILE"
+        rm -f "$OUT"
+        exit 1
+    fi
+
+    # The root is the store certificate that issued one of the chain's
+    # certificates and completes the chain on its own
+    root=""
+    for cert in "$TMP"/chain/*.pem; do
+        if is_self_signed "$cert"; then
+            candidates=("$cert")    # The server did send its root
+        else
+            issuer_hash=$(openssl x509 -in "$cert" -noout -issuer_hash)
+            candidates=()
+            for ca in "$TMP"/store/*.pem; do
+                if [ "$(openssl x509 -in "$ca" -noout -subject_hash 2>/dev/null)" = "$issuer_hash" ]; then
+                    candidates+=("$ca")
+                fi
+            done
+        fi
+        for ca in "${candidates[@]}"; do
+            if openssl verify -CAfile "$ca" -untrusted "$TMP/untrusted.pem" "$TMP/chain/0.pem" >/dev/null 2>&1; then
+                root=$ca
+                break 2
+            fi
+        done
+    done
+
+    if [ -z "$root" ]; then
+        echo "✗ No trusted root for $host in $CA_FILE"
+        rm -f "$OUT"
+        exit 1
+    fi
+    subject=$(openssl x509 -in "$root" -noout -subject | sed 's/^subject=//')
+    if ! is_self_signed "$root"; then
+        echo "✗ Top certificate for $host is not self-signed ($subject)"
+        rm -f "$OUT"
+        exit 1
+    fi
+    echo "# $host: subject=$subject" >> "$OUT"
+    openssl x509 -in "$root" >> "$OUT"
+done
+
+mv "$OUT" pinned_ca.pem
+echo "✓ Wrote $(grep -c 'BEGIN CERTIFICATE' pinned_ca.pem) root certificates to $(pwd)/pinned_ca.pem"
@@ -15,38 +15,24 @@
 #include <stdbool.h>
 #include <stdio.h>
 
-#include "esp_gap_ble_api.h"
 #include "esp_ibeacon_api.h"
-#include "esp_log.h"
 
-static const char* TAG = "iBeacon-API";
+#ifndef ESP_UUID_LEN_128
+#define ESP_UUID_LEN_128 16     // From esp_bt_defs.h, which only Bluedroid builds have
+#endif
 
 
 const uint8_t uuid_zeros[ESP_UUID_LEN_128] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
 /* For iBeacon packet format, please refer to Apple "Proximity Beacon Specification" doc */
 /* Constant part of iBeacon data */
-esp_ble_ibeacon_head_t ibeacon_common_head = {
-    .flags = {0x02, 0x01, 0x06},
-    .length = 0x1A,
-    .type = 0xFF,
-    .company_id = 0x004C,
-    .beacon_type = 0x1502
-};
+const esp_ble_ibeacon_head_t ibeacon_common_head = ESP_BLE_IBEACON_HEAD_INITIALIZER;
 
-/* Vendor part of iBeacon data - initialized by application */
-esp_ble_ibeacon_vendor_t vendor_config = {
-    .proximity_uuid = {0},
-    .major = 0,
-    .minor = 0,
-    .measured_power = 0xC5  // -59 dBm (calibrated at 1 meter)
-};
-
-bool esp_ble_is_ibeacon_packet (uint8_t *adv_data, uint8_t adv_data_len){
+bool esp_ble_is_ibeacon_packet (const uint8_t *adv_data, uint8_t adv_data_len){
     bool result = false;
 
     if ((adv_data != NULL) && (adv_data_len == 0x1E)){
-        if (!memcmp(adv_data, (uint8_t*)&ibeacon_common_head, sizeof(ibeacon_common_head))){
+        if (!memcmp(adv_data, (const uint8_t*)&ibeacon_common_head, sizeof(ibeacon_common_head))){
             result = true;
         }
     }
@@ -65,30 +51,22 @@ esp_err_t esp_ble_config_ibeacon_data (esp_ble_ibeacon_vendor_t *vendor_config,
     return ESP_OK;
 }
 
-void esp_ble_set_ibeacon_params(const uint8_t *uuid, uint16_t major, uint16_t minor){
-    if (uuid != NULL) {
-        memcpy(vendor_config.proximity_uuid, uuid, ESP_UUID_LEN_128);
+esp_err_t esp_ble_ibeacon_encode(const uint8_t *uuid, uint16_t major, uint16_t minor, int8_t measured_power,
+                                 esp_ble_ibeacon_t *frame){
+    if ((uuid == NULL) || (frame == NULL) || (!memcmp(uuid, uuid_zeros, sizeof(uuid_zeros)))){
+        return ESP_ERR_INVALID_ARG;
     }
-    vendor_config.major = ENDIAN_CHANGE_U16(major);
-    vendor_config.minor = ENDIAN_CHANGE_U16(minor);
 
-    ESP_LOGI(TAG, "iBeacon parameters updated");
-}
+    const esp_ble_ibeacon_t encoded = {
+        .ibeacon_head = ESP_BLE_IBEACON_HEAD_INITIALIZER,
+        .ibeacon_vendor = {
+            .major = ENDIAN_CHANGE_U16(major),
+            .minor = ENDIAN_CHANGE_U16(minor),
+            .measured_power = measured_power,
+        },
+    };
+    *frame = encoded;
+    memcpy(frame->ibeacon_vendor.proximity_uuid, uuid, ESP_UUID_LEN_128);
 
-void esp_ble_print_ibeacon_config(void){
-    uint8_t *uuid = vendor_config.proximity_uuid;
-    uint16_t major = ENDIAN_CHANGE_U16(vendor_config.major);
-    uint16_t minor = ENDIAN_CHANGE_U16(vendor_config.minor);
-
-    ESP_LOGI(TAG, "========== iBeacon Configuration ==========");
-    ESP_LOGI(TAG, "UUID: %02X%02X%02X%02X-%02X%02X-%02X%02X-%02X%02X-%02X%02X%02X%02X%02X%02X",
-             uuid[0], uuid[1], uuid[2], uuid[3],
-             uuid[4], uuid[5],
-             uuid[6], uuid[7],
-             uuid[8], uuid[9],
-             uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]);
-    ESP_LOGI(TAG, "Major: %d (0x%04X)", major, major);
-    ESP_LOGI(TAG, "Minor: %d (0x%04X)", minor, minor);
-    ESP_LOGI(TAG, "Measured Power: %d dBm", vendor_config.measured_power);
-    ESP_LOGI(TAG, "==========================================");
+    return ESP_OK;
 }
@@ -18,10 +18,22 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include "sdkconfig.h"
+#include "esp_err.h"
+#if CONFIG_BT_BLUEDROID_ENABLED
 #include "esp_gap_ble_api.h"
 #include "esp_gattc_api.h"
+#endif
 
-#define IBEACON_MODE 0  // Transmitter mode only
+#define IBEACON_SENDER      0
+#define IBEACON_RECEIVER    1   // Gateway: scan and report sightings (beacon_scan.h)
+
+// Chosen by the build profile (menuconfig)
+#if CONFIG_BEACON_PROFILE_GATEWAY
+#define IBEACON_MODE IBEACON_RECEIVER
+#else
+#define IBEACON_MODE IBEACON_SENDER
+#endif
 
 /* Major and Minor part are stored in big endian mode in iBeacon packet,
  * need to use this macro to transfer while creating or processing
@@ -50,15 +62,45 @@ typedef struct {
     esp_ble_ibeacon_vendor_t ibeacon_vendor;
 }__attribute__((packed)) esp_ble_ibeacon_t;
 
+/* Complete advertising data: flags AD (3) + manufacturer AD header (6) + vendor part (21) */
+#define ESP_BLE_IBEACON_FRAME_LEN 30
+_Static_assert(sizeof(esp_ble_ibeacon_t) == ESP_BLE_IBEACON_FRAME_LEN, "iBeacon frame must be 30 bytes");
 
 /* For iBeacon packet format, please refer to Apple "Proximity Beacon Specification" doc */
 /* Constant part of iBeacon data */
-extern esp_ble_ibeacon_head_t ibeacon_common_head;
+#define ESP_BLE_IBEACON_HEAD_INITIALIZER {  \
+    .flags = {0x02, 0x01, 0x06},            \
+    .length = 0x1A,                         \
+    .type = 0xFF,                           \
+    .company_id = 0x004C,                   \
+    .beacon_type = 0x1502                   \
+}
+
+/* Static initializer for a complete frame with a fixed identity, so it can
+ * live in flash with nothing encoded at runtime. The 16 UUID bytes follow
+ * the other arguments:
+ *
+ *   static const esp_ble_ibeacon_t frame =
+ *       ESP_BLE_IBEACON_INITIALIZER(100, 1, -59, 0xFD, 0xA5, 0x06, 0x93, ...);
+ */
+#define ESP_BLE_IBEACON_INITIALIZER(major_, minor_, measured_power_, ...) {  \
+    .ibeacon_head = ESP_BLE_IBEACON_HEAD_INITIALIZER,                        \
+    .ibeacon_vendor = {                                                      \
+        .proximity_uuid = { __VA_ARGS__ },                                   \
+        .major = ENDIAN_CHANGE_U16(major_),                                  \
+        .minor = ENDIAN_CHANGE_U16(minor_),                                  \
+        .measured_power = (measured_power_),                                 \
+    },                                                                       \
+}
+
+extern const esp_ble_ibeacon_head_t ibeacon_common_head;
 
-bool esp_ble_is_ibeacon_packet (uint8_t *adv_data, uint8_t adv_data_len);
+bool esp_ble_is_ibeacon_packet (const uint8_t *adv_data, uint8_t adv_data_len);
 
 esp_err_t esp_ble_config_ibeacon_data (esp_ble_ibeacon_vendor_t *vendor_config, esp_ble_ibeacon_t *ibeacon_adv_data);
 
-void esp_ble_set_ibeacon_params(const uint8_t *uuid, uint16_t major, uint16_t minor);
+/* Build the complete frame into a caller-owned buffer. Uses no global
+ * state, so it is safe from any task; major and minor in host order. */
+esp_err_t esp_ble_ibeacon_encode(const uint8_t *uuid, uint16_t major, uint16_t minor, int8_t measured_power,
+                                 esp_ble_ibeacon_t *frame);
 
-void esp_ble_print_ibeacon_config(void);
@@ -18,25 +18,53 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
 #include "nvs_flash.h"
 #include "esp_bt.h"
+#if CONFIG_BT_NIMBLE_ENABLED
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#else
 #include "esp_gap_ble_api.h"
 #include "esp_bt_main.h"
+#endif
 #include "esp_ibeacon_api.h"
+#include "beacon_adv.h"
+#if IBEACON_MODE == IBEACON_RECEIVER
+#include "beacon_scan.h"
+#endif
+#include "adv_profile.h"
+#include "power_mgr.h"
+#include "telemetry.h"
+#include "tls_profile.h"
+#include "boot_timeline.h"
+#include "metrics.h"
+#include "serial_cmd.h"
+#include "beacon_config.h"
 #include "esp_log.h"
-#include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_ota_ops.h"
+#if CONFIG_BEACON_WIFI
+#include "esp_wifi.h"
 #include "esp_http_client.h"
-#include "esp_https_ota.h"
 #include "esp_netif.h"
+#endif
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "driver/gpio.h"
 #include "esp_mac.h"
-#include "esp_crt_bundle.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#if CONFIG_BEACON_SNTP
 #include "esp_sntp.h"
+#endif
+#include "ota_image.h"
+#include "ota_writer.h"
+#include "ota_manifest.h"
+#include "ota_selftest.h"
 #include <time.h>
 #include <sys/time.h>
 
@@ -44,159 +72,292 @@
 // CONFIGURATION - Edit these values
 // ============================================================================
 
+// Build profile, identity, advertising, Wi-Fi and server settings are in
+// menuconfig ("ESP32 iBeacon Configuration", main/Kconfig.projbuild).
+// CONFIG_BEACON_WIFI / _OTA / _TELEMETRY / _SNTP compile those subsystems in.
+
 // WiFi Configuration
 #define WIFI_SSID      CONFIG_EXAMPLE_WIFI_SSID
 #define WIFI_PASSWORD  CONFIG_EXAMPLE_WIFI_PASSWORD
 
 // OTA Version Check URL - Lightweight endpoint to check firmware version
 // Scenario 2: Separate status endpoint for bandwidth optimization
-#define OTA_VERSION_CHECK_URL "http://beacon.bramsoft.com:8080/version"
+#define OTA_VERSION_CHECK_URL CONFIG_BEACON_SERVER_URL "/version"
+
+// OTA long-poll URL - Server holds the request until a new build is published
+#define OTA_VERSION_WAIT_URL CONFIG_BEACON_SERVER_URL "/version/wait"
 
 // OTA Download URL - Where to download the actual firmware binary
-#define OTA_DOWNLOAD_URL "http://beacon.bramsoft.com:8080/beacon_firmware.bin"
+#define OTA_DOWNLOAD_URL CONFIG_BEACON_SERVER_URL "/beacon_firmware.bin"
+
+// Compressed OTA image (chunked zlib) - tried first, falls back to
+// OTA_DOWNLOAD_URL when the server has no compressed image
+#define OTA_COMPRESSED_DOWNLOAD_URL CONFIG_BEACON_SERVER_URL "/beacon_firmware.bin.z"
+
+// Signed manifest of the offered build - per-chunk hashes checked while flashing
+#define OTA_MANIFEST_URL CONFIG_BEACON_SERVER_URL "/beacon_firmware.manifest"
 
 // Webhook URL - Send HTTPS POST requests to this URL
-// Change this to your webhook endpoint
-#define WEBHOOK_URL "https://discord.com/api/webhooks/1470114757087334411/ZjD8kJmnlqKKyn4oOOm2zjOc233qqK87GsvckmmCmmCxXyis8s0mzxXndH2rQPOCwruB"
+#define WEBHOOK_URL CONFIG_BEACON_WEBHOOK_URL
 
 // Firmware Version - retrieved from app descriptor at runtime
 
 // LED Pin (GPIO 2 on most ESP32 dev boards)
 #define LED_GPIO 2
 
-// Webhook sending interval (in seconds)
+// Webhook "online" heartbeat interval (in seconds)
 // Set to 0 to send only once on startup
-#define WEBHOOK_INTERVAL_SEC 0
+#define WEBHOOK_INTERVAL_SEC CONFIG_BEACON_WEBHOOK_INTERVAL_SEC
+
+// Telemetry events (online, OTA status) are queued and sent as one
+// batched webhook message per flush interval
+#define TELEMETRY_FLUSH_SEC 30
+
+// Minimum time between metrics summaries sent after OTA checks
+#define METRICS_POST_INTERVAL_SEC 3600
 
-// Your Beacon UUID - Just paste the UUID string here!
-// Must match the UUID configured in your iOS app
+// Your Beacon UUID - Must match the UUID configured in your iOS app
 // Format: XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX
-#define BEACON_UUID_STRING "ED17A803-D1AC-4F04-A2F0-7802B4C9C70C"
+#define BEACON_UUID_STRING CONFIG_BEACON_UUID
 
 // Default Major/Minor values (used only on first boot if NVS is empty)
-#define DEFAULT_BEACON_MAJOR 100
-#define DEFAULT_BEACON_MINOR 14
+#define DEFAULT_BEACON_MAJOR CONFIG_BEACON_DEFAULT_MAJOR
+#define DEFAULT_BEACON_MINOR CONFIG_BEACON_DEFAULT_MINOR
+
+// Extra identities advertised alongside the one above (e.g. a site UUID
+// next to the zone UUID). Each entry: { "UUID", major, minor },
+// up to BEACON_ADV_MAX_IDENTITIES - 1 entries. Leave empty for one iBeacon.
+#define BEACON_EXTRA_IDENTITIES \
+    /* { "E2C56DB5-DFFB-48D2-B060-D0F5A71096E0", 1, 1 }, */
+
+// Time each identity stays on air before the next one (BLE 4.2 chips only;
+// BLE 5 chips advertise all identities in parallel)
+#define BEACON_ROTATION_MS 1000
 
 // Advertising interval in milliseconds (50-10000)
-// 100ms = 10 broadcasts per second (responsive room detection)
-#define ADVERTISING_INTERVAL_MS 100
+#define ADVERTISING_INTERVAL_MS CONFIG_BEACON_ADV_INTERVAL_MS
+
+// RSSI at 1 meter in dBm, sent in every frame for distance estimates
+#define BEACON_MEASURED_POWER -59
 
 // Transmit Power (ESP32 Power Levels)
-// ESP_PWR_LVL_N0 = 0 dBm (~5-8m range) - Medium power for room detection
+#if CONFIG_BEACON_TX_POWER_N12
+#define TRANSMIT_POWER ESP_PWR_LVL_N12
+#elif CONFIG_BEACON_TX_POWER_N9
+#define TRANSMIT_POWER ESP_PWR_LVL_N9
+#elif CONFIG_BEACON_TX_POWER_N6
+#define TRANSMIT_POWER ESP_PWR_LVL_N6
+#elif CONFIG_BEACON_TX_POWER_N3
+#define TRANSMIT_POWER ESP_PWR_LVL_N3
+#elif CONFIG_BEACON_TX_POWER_P3
+#define TRANSMIT_POWER ESP_PWR_LVL_P3
+#elif CONFIG_BEACON_TX_POWER_P6
+#define TRANSMIT_POWER ESP_PWR_LVL_P6
+#elif CONFIG_BEACON_TX_POWER_P9
+#define TRANSMIT_POWER ESP_PWR_LVL_P9
+#else
 #define TRANSMIT_POWER ESP_PWR_LVL_N0
+#endif
+
+// Adaptive advertising for battery deployments (see adv_profile.h)
+// 1 = switch interval/power at runtime: fast after boot and motion,
+// slow when idle and at night. 0 = always use the two values above.
+#define ADV_PROFILES_ENABLED 0
+#define ADV_BOOT_FAST_SEC      120   // Fast advertising after power-up
+#define ADV_MOTION_HOLD_SEC    60    // Fast advertising after motion
+#define ADV_MOTION_GPIO        -1    // Motion sensor input pin, -1 = none
+#define ADV_IDLE_INTERVAL_MS   1000
+#define ADV_NIGHT_INTERVAL_MS  2000
+#define ADV_NIGHT_TX_POWER     ESP_PWR_LVL_N6
+#define ADV_NIGHT_START_HOUR   6     // UTC hours (SNTP time), 22:00-06:00 PST
+#define ADV_NIGHT_END_HOUR     14
+
+// Gateway mode (the gateway build profile): scan instead of advertising
+// and POST a summary of the beacons heard
+#define GATEWAY_REPORT_URL CONFIG_BEACON_SERVER_URL "/gateway/report"
+#define GATEWAY_REPORT_SEC        10
+#define GATEWAY_EXPIRE_SEC        60    // Forget beacons not heard for this long
+#define GATEWAY_SCAN_INTERVAL_MS  100
+#define GATEWAY_BEACON_INTERVAL_MS ADVERTISING_INTERVAL_MS  // Fleet's interval, to count missed events
+
+// Low-power mode for battery deployments (see power_mgr.h)
+// 1 = BLE advertising with DFS / light sleep, Wi-Fi switched on only for a
+// maintenance window (OTA check + telemetry) every MAINTENANCE_INTERVAL_SEC
+// 0 = Wi-Fi stays associated (mains powered)
+// Builds without OTA have no windows: no Wi-Fi, or Wi-Fi in modem sleep
+#define LOW_POWER_MODE 0
+#define MAINTENANCE_INTERVAL_SEC 3600
+
+// Nominal supply current per power state, used when no current sampler
+// is installed - rough ESP32 figures, replace with bench measurements
+#define POWER_NOMINAL_ADV_MA   15.0f
+#define POWER_NOMINAL_WIFI_MA  50.0f
+#define POWER_REPORT_BATTERY_MAH 2000
 
 // ============================================================================
 // END OF CONFIGURATION
 // ============================================================================
 
 static const char* TAG = "iBeacon";
+#if CONFIG_BEACON_OTA
 static const char* OTA_TAG = "OTA";
+#endif
+#if CONFIG_BEACON_WIFI
 static const char* WIFI_TAG = "WiFi";
+#endif
 static const char* NVS_TAG = "NVS";
-extern esp_ble_ibeacon_vendor_t vendor_config;
-
-// NVS namespace and keys for persistent storage
-#define NVS_NAMESPACE "beacon_cfg"
-#define NVS_KEY_MAJOR "major"
-#define NVS_KEY_MINOR "minor"
 
-// Actual beacon values (loaded from NVS on boot)
+// Actual beacon values (loaded from NVS on boot, see beacon_config.h)
 static uint16_t g_beacon_major = DEFAULT_BEACON_MAJOR;
 static uint16_t g_beacon_minor = DEFAULT_BEACON_MINOR;
+static uint8_t g_beacon_uuid[16];       // BEACON_UUID_STRING until provisioned
 
 // OTA update check interval (in seconds)
-#define OTA_CHECK_INTERVAL_SEC 300  // Check every 5 minutes
+// Used only when the long-poll endpoint is unreachable
+#define OTA_CHECK_INTERVAL_SEC CONFIG_BEACON_OTA_CHECK_INTERVAL_SEC
+
+// How long the server may hold a long-poll open (server caps it at 30 min)
+#define OTA_LONG_POLL_SEC 900
+
+// A new OTA image must advertise and join Wi-Fi within this time after its
+// first boot, or the bootloader returns to the previous firmware
+#define OTA_SELFTEST_TIMEOUT_SEC 180
+
+// Random delay after a build notification, so the fleet does not
+// hit the server in the same second
+#define OTA_NOTIFY_JITTER_SEC 30
+
+// Upper bound on a server-requested Retry-After (rollout waves, busy server)
+#define OTA_RETRY_AFTER_MAX_SEC 3600
 
-// WiFi connection event bits
+// WiFi connection event bits. WIFI_FAIL_BIT only tells waiters that the
+// first WIFI_MAXIMUM_RETRY attempts failed: wifi_link_task keeps trying.
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
+#define WIFI_RECONNECT_BIT BIT2     // wifi_link_task: connect again after the backoff
+#define WIFI_SAVE_LINK_BIT BIT3     // wifi_link_task: store the AP in the link cache
+
+#if CONFIG_BEACON_WIFI
+// Set while Wi-Fi is deliberately switched off (no reconnect attempts)
+static bool s_wifi_powered_down = false;
 
 static EventGroupHandle_t s_wifi_event_group;
 static int s_retry_num = 0;
 #define WIFI_MAXIMUM_RETRY 5
 
+// Reconnect backoff: the first retry is immediate, then the delay starts at
+// WIFI_BACKOFF_BASE_MS and doubles up to WIFI_BACKOFF_MAX_MS. Half of it is
+// random, so an AP coming back after a power cut is not hit by every
+// beacon at once.
+#define WIFI_BACKOFF_BASE_MS 500
+#define WIFI_BACKOFF_MAX_MS  60000
+
+// Channel and BSSID of the last AP (kept in the beacon config), so a boot
+// can join it without a full scan. Attempts on the cached AP before
+// falling back to a scan:
+#define WIFI_FAST_CONNECT_ATTEMPTS 2
+
+static beacon_config_wifi_t s_wifi_link;    // Loaded at boot, updated on connect
+static bool s_wifi_fast_connect = false;
+
+// When the connection was lost, 0 while connected (METRIC_TIME_WIFI_RECONNECT)
+static int64_t s_wifi_lost_us = 0;
+#endif
+
 // Forward declarations
-static void webhook_task(void *pvParameter);
+#if CONFIG_BEACON_TELEMETRY
+static void post_online_event(void);
+#endif
+#if CONFIG_BEACON_SNTP
 static void initialize_sntp(void);
-static void get_timestamp(char* buffer, size_t buffer_size);
+#endif
 
 /**
- * Load beacon configuration from NVS
+ * Convert UUID string to byte array. Dashes are optional; returns false
+ * unless the string holds exactly 32 hex digits.
  */
-static bool load_beacon_config_from_nvs(void)
+static bool parse_uuid_string(const char* uuid_str, uint8_t* uuid_bytes)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
+    uint8_t bytes[16];
+    int digits = 0;
 
-    ESP_LOGI(NVS_TAG, "Loading beacon configuration from NVS...");
-
-    err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(NVS_TAG, "NVS namespace not found, using defaults");
-        return false;
-    }
-
-    // Try to read major
-    err = nvs_get_u16(nvs_handle, NVS_KEY_MAJOR, &g_beacon_major);
-    if (err != ESP_OK) {
-        ESP_LOGW(NVS_TAG, "Major not found in NVS, using default: %d", DEFAULT_BEACON_MAJOR);
-        g_beacon_major = DEFAULT_BEACON_MAJOR;
-    } else {
-        ESP_LOGI(NVS_TAG, "✓ Loaded Major from NVS: %d", g_beacon_major);
+    for (const char *p = uuid_str; *p != '\0'; p++) {
+        if (*p == '-') {
+            continue;
+        }
+        if (!isxdigit((unsigned char)*p) || digits == 32) {
+            return false;
+        }
+        uint8_t nibble = isdigit((unsigned char)*p) ? *p - '0' : toupper((unsigned char)*p) - 'A' + 10;
+        if (digits % 2 == 0) {
+            bytes[digits / 2] = nibble << 4;
+        } else {
+            bytes[digits / 2] |= nibble;
+        }
+        digits++;
     }
-
-    // Try to read minor
-    err = nvs_get_u16(nvs_handle, NVS_KEY_MINOR, &g_beacon_minor);
-    if (err != ESP_OK) {
-        ESP_LOGW(NVS_TAG, "Minor not found in NVS, using default: %d", DEFAULT_BEACON_MINOR);
-        g_beacon_minor = DEFAULT_BEACON_MINOR;
-    } else {
-        ESP_LOGI(NVS_TAG, "✓ Loaded Minor from NVS: %d", g_beacon_minor);
+    if (digits != 32) {
+        return false;
     }
 
-    nvs_close(nvs_handle);
+    memcpy(uuid_bytes, bytes, sizeof(bytes));
     return true;
 }
 
 /**
- * Save beacon configuration to NVS
+ * Format a UUID as XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX (out: 37 bytes)
  */
-static esp_err_t save_beacon_config_to_nvs(uint16_t major, uint16_t minor)
+static void format_uuid_string(const uint8_t *uuid, char *out)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
+    snprintf(out, 37, "%02X%02X%02X%02X-%02X%02X-%02X%02X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+             uuid[0], uuid[1], uuid[2], uuid[3], uuid[4], uuid[5], uuid[6], uuid[7],
+             uuid[8], uuid[9], uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]);
+}
 
-    ESP_LOGI(NVS_TAG, "Saving beacon configuration to NVS...");
+/**
+ * Load the beacon configuration (migrating the NVS keys of earlier
+ * firmware), or store this firmware's defaults on first boot
+ * Returns true if a stored configuration was loaded
+ */
+static bool load_beacon_config_from_nvs(void)
+{
+    ESP_LOGI(NVS_TAG, "Loading beacon configuration from NVS...");
 
-    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(NVS_TAG, "Failed to open NVS: %s", esp_err_to_name(err));
-        return err;
-    }
+    beacon_config_t config = {
+        .major = DEFAULT_BEACON_MAJOR,
+        .minor = DEFAULT_BEACON_MINOR,
+    };
+    parse_uuid_string(BEACON_UUID_STRING, config.uuid);
+    bool loaded = beacon_config_init(&config) == ESP_OK;
+
+    beacon_config_get(&config);
+    g_beacon_major = config.major;
+    g_beacon_minor = config.minor;
+    memcpy(g_beacon_uuid, config.uuid, sizeof(g_beacon_uuid));
+    return loaded;
+}
 
-    err = nvs_set_u16(nvs_handle, NVS_KEY_MAJOR, major);
-    if (err != ESP_OK) {
-        nvs_close(nvs_handle);
-        return err;
-    }
+/**
+ * Save beacon configuration to NVS
+ */
+static esp_err_t save_beacon_config_to_nvs(uint16_t major, uint16_t minor, const uint8_t *uuid)
+{
+    ESP_LOGI(NVS_TAG, "Saving beacon configuration to NVS...");
 
-    err = nvs_set_u16(nvs_handle, NVS_KEY_MINOR, minor);
+    esp_err_t err = beacon_config_set_identity(major, minor, uuid);
     if (err != ESP_OK) {
-        nvs_close(nvs_handle);
+        ESP_LOGE(NVS_TAG, "Failed to save config: %s", esp_err_to_name(err));
         return err;
     }
 
-    err = nvs_commit(nvs_handle);
-    if (err == ESP_OK) {
-        ESP_LOGI(NVS_TAG, "✓ Beacon configuration saved to NVS");
-        g_beacon_major = major;
-        g_beacon_minor = minor;
-    }
-
-    nvs_close(nvs_handle);
-    return err;
+    ESP_LOGI(NVS_TAG, "✓ Beacon configuration saved to NVS");
+    g_beacon_major = major;
+    g_beacon_minor = minor;
+    memmove(g_beacon_uuid, uuid, sizeof(g_beacon_uuid));
+    return ESP_OK;
 }
 
+#if CONFIG_BEACON_WIFI
 /**
  * WiFi event handler
  */
@@ -206,32 +367,223 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < WIFI_MAXIMUM_RETRY) {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(WIFI_TAG, "Retry connecting to WiFi (%d/%d)", s_retry_num, WIFI_MAXIMUM_RETRY);
-        } else {
+        telemetry_set_connected(false);
+#if IBEACON_MODE == IBEACON_RECEIVER
+        beacon_scan_set_connected(false);
+#endif
+        if (s_wifi_powered_down) {
+            return;
+        }
+        metrics_count(METRIC_WIFI_DISCONNECTS);
+        if (s_wifi_lost_us == 0 && (xEventGroupGetBits(s_wifi_event_group) & WIFI_CONNECTED_BIT)) {
+            s_wifi_lost_us = esp_timer_get_time();
+        }
+        xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+
+        wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
+        ESP_LOGI(WIFI_TAG, "Failed to connect to WiFi (reason %d)", event->reason);
+        if (++s_retry_num == WIFI_MAXIMUM_RETRY) {
             xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
         }
-        ESP_LOGI(WIFI_TAG, "Failed to connect to WiFi");
+        // Never from the event loop: wifi_link_task waits out the backoff
+        xEventGroupSetBits(s_wifi_event_group, WIFI_RECONNECT_BIT);
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(WIFI_TAG, "✓ Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
+        ESP_LOGI(WIFI_TAG, "✓ Got IP: " IPSTR "%s", IP2STR(&event->ip_info.ip),
+                 s_wifi_fast_connect ? " (cached AP)" : "");
         s_retry_num = 0;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        if (s_wifi_lost_us > 0) {
+            metrics_record_time(METRIC_TIME_WIFI_RECONNECT, (esp_timer_get_time() - s_wifi_lost_us) / 1000, 0);
+            s_wifi_lost_us = 0;
+        }
+        boot_timeline_mark(BOOT_STAGE_WIFI_CONNECTED);
+        ota_selftest_pass(OTA_SELFTEST_WIFI);
+        xEventGroupClearBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_SAVE_LINK_BIT);
+        telemetry_set_connected(true);
+#if IBEACON_MODE == IBEACON_RECEIVER
+        beacon_scan_set_connected(true);
+#endif
+    }
+}
+
+/**
+ * Load the cached AP; it is ignored unless it is for WIFI_SSID
+ */
+static void wifi_link_load(void)
+{
+    beacon_config_t config;
+    beacon_config_get(&config);
+    s_wifi_link = config.wifi;
+
+    s_wifi_link.ssid[sizeof(s_wifi_link.ssid) - 1] = '\0';
+    if (strcmp(s_wifi_link.ssid, WIFI_SSID) != 0 ||
+        s_wifi_link.channel < 1 || s_wifi_link.channel > 14) {
+        memset(&s_wifi_link, 0, sizeof(s_wifi_link));
+    }
+}
+
+/**
+ * Remember the AP just joined; flash is only written when it changed
+ */
+static void wifi_link_save(void)
+{
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+
+    beacon_config_wifi_t link = {0};
+    strlcpy(link.ssid, WIFI_SSID, sizeof(link.ssid));
+    memcpy(link.bssid, ap.bssid, sizeof(link.bssid));
+    link.channel = ap.primary;
+    if (memcmp(&link, &s_wifi_link, sizeof(link)) == 0) {
+        return;
+    }
+
+    esp_err_t err = beacon_config_set_wifi(&link);
+    if (err != ESP_OK) {
+        ESP_LOGW(WIFI_TAG, "⚠️  Failed to cache AP: %s", esp_err_to_name(err));
+        return;
+    }
+    s_wifi_link = link;
+    ESP_LOGI(WIFI_TAG, "✓ Cached AP " MACSTR " on channel %d for fast connect", MAC2STR(link.bssid), link.channel);
+}
+
+/**
+ * Station configuration, with the cached AP's channel and BSSID when fast
+ * is set: the driver then probes that one channel instead of scanning all
+ */
+static esp_err_t wifi_apply_config(bool fast)
+{
+    wifi_config_t wifi_config = {
+        .sta = {
+            .ssid = WIFI_SSID,
+            .password = WIFI_PASSWORD,
+            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+#if LOW_POWER_MODE
+            .listen_interval = 3,   // Wake for every 3rd beacon in modem sleep
+#endif
+        },
+    };
+    if (fast) {
+        wifi_config.sta.channel = s_wifi_link.channel;
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, s_wifi_link.bssid, sizeof(wifi_config.sta.bssid));
+    }
+
+    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    if (err == ESP_OK) {
+        s_wifi_fast_connect = fast;
+    }
+    return err;
+}
+
+/**
+ * Delay before reconnect attempt n (1 = first retry), see WIFI_BACKOFF_BASE_MS
+ */
+static uint32_t wifi_backoff_ms(int attempt)
+{
+    if (attempt <= 1) {
+        return 0;
+    }
+    int shift = attempt - 2;
+    uint32_t delay = shift >= 7 ? WIFI_BACKOFF_MAX_MS : WIFI_BACKOFF_BASE_MS << shift;
+    if (delay > WIFI_BACKOFF_MAX_MS) {
+        delay = WIFI_BACKOFF_MAX_MS;
+    }
+    return delay / 2 + esp_random() % (delay / 2 + 1);
+}
+
+/**
+ * Reconnects with backoff for as long as Wi-Fi is meant to be on, and
+ * keeps the AP cache up to date; the event handler only signals it
+ */
+static void wifi_link_task(void *pvParameter)
+{
+    while (1) {
+        EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
+                WIFI_RECONNECT_BIT | WIFI_SAVE_LINK_BIT,
+                pdTRUE,
+                pdFALSE,
+                portMAX_DELAY);
+
+        if (bits & WIFI_SAVE_LINK_BIT) {
+            wifi_link_save();
+        }
+        if (!(bits & WIFI_RECONNECT_BIT)) {
+            continue;
+        }
+
+        int attempt = s_retry_num;
+        uint32_t delay_ms = wifi_backoff_ms(attempt);
+        if (delay_ms > 0) {
+            ESP_LOGI(WIFI_TAG, "Reconnecting in %lu ms (attempt %d)", (unsigned long)delay_ms, attempt);
+            vTaskDelay(delay_ms / portTICK_PERIOD_MS);
+        }
+        if (s_wifi_powered_down) {
+            continue;
+        }
+
+        // A few attempts on the cached AP, then scan for the SSID
+        bool fast = s_wifi_link.channel != 0 && attempt < WIFI_FAST_CONNECT_ATTEMPTS;
+        if (fast != s_wifi_fast_connect) {
+            if (!fast) {
+                ESP_LOGW(WIFI_TAG, "⚠️  Cached AP not reachable, scanning all channels");
+            }
+            wifi_apply_config(fast);
+        }
+
+        metrics_count(METRIC_WIFI_RETRIES);
+        esp_err_t err = esp_wifi_connect();
+        if (err != ESP_OK) {
+            ESP_LOGW(WIFI_TAG, "⚠️  Connect failed: %s", esp_err_to_name(err));
+        }
+    }
+}
+
+/**
+ * Use CONFIG_BEACON_STATIC_IP instead of DHCP
+ */
+static void wifi_apply_static_ip(esp_netif_t *netif)
+{
+    const char *dns_str = sizeof(CONFIG_BEACON_STATIC_DNS) > 1 ? CONFIG_BEACON_STATIC_DNS : CONFIG_BEACON_STATIC_GATEWAY;
+    esp_netif_ip_info_t ip_info = {0};
+    esp_netif_dns_info_t dns = {0};
+    if (esp_netif_str_to_ip4(CONFIG_BEACON_STATIC_IP, &ip_info.ip) != ESP_OK ||
+        esp_netif_str_to_ip4(CONFIG_BEACON_STATIC_NETMASK, &ip_info.netmask) != ESP_OK ||
+        esp_netif_str_to_ip4(CONFIG_BEACON_STATIC_GATEWAY, &ip_info.gw) != ESP_OK ||
+        esp_netif_str_to_ip4(dns_str, &dns.ip.u_addr.ip4) != ESP_OK) {
+        ESP_LOGE(WIFI_TAG, "✗ Invalid static IP configuration, using DHCP");
+        return;
     }
+
+    dns.ip.type = ESP_IPADDR_TYPE_V4;
+    esp_netif_dhcpc_stop(netif);
+    if (esp_netif_set_ip_info(netif, &ip_info) != ESP_OK ||
+        esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns) != ESP_OK) {
+        ESP_LOGE(WIFI_TAG, "✗ Failed to set static IP, using DHCP");
+        esp_netif_dhcpc_start(netif);
+        return;
+    }
+    ESP_LOGI(WIFI_TAG, "Static IP " IPSTR ", no DHCP", IP2STR(&ip_info.ip));
 }
 
 /**
  * Initialize WiFi connection
+ *
+ * Joins the cached AP directly when there is one. Returns once connected;
+ * after WIFI_MAXIMUM_RETRY failed attempts it logs the failure and keeps
+ * waiting while wifi_link_task retries.
  */
 static void wifi_init_sta(void)
 {
-    s_wifi_event_group = xEventGroupCreate();
-
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    esp_netif_t *netif = esp_netif_create_default_wifi_sta();
+    if (sizeof(CONFIG_BEACON_STATIC_IP) > 1) {
+        wifi_apply_static_ip(netif);
+    }
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -249,19 +601,24 @@ static void wifi_init_sta(void)
                                                         NULL,
                                                         &instance_got_ip));
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = WIFI_SSID,
-            .password = WIFI_PASSWORD,
-            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-        },
-    };
+    wifi_link_load();
+    xTaskCreate(&wifi_link_task, "wifi_link", 3072, NULL, 4, NULL);
+
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    ESP_ERROR_CHECK(wifi_apply_config(s_wifi_link.channel != 0));
     ESP_ERROR_CHECK(esp_wifi_start());
+#if LOW_POWER_MODE
+    esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+#endif
+    power_mgr_set_state(POWER_STATE_WIFI);
 
     ESP_LOGI(WIFI_TAG, "WiFi initialization finished");
-    ESP_LOGI(WIFI_TAG, "Connecting to SSID: %s", WIFI_SSID);
+    if (s_wifi_fast_connect) {
+        ESP_LOGI(WIFI_TAG, "Connecting to SSID: %s (cached AP " MACSTR ", channel %d)",
+                 WIFI_SSID, MAC2STR(s_wifi_link.bssid), s_wifi_link.channel);
+    } else {
+        ESP_LOGI(WIFI_TAG, "Connecting to SSID: %s", WIFI_SSID);
+    }
 
     /* Wait until either connected or failed */
     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
@@ -270,6 +627,12 @@ static void wifi_init_sta(void)
             pdFALSE,
             portMAX_DELAY);
 
+    if (!(bits & WIFI_CONNECTED_BIT)) {
+        // SNTP and the online event follow whenever the AP is back
+        ESP_LOGE(WIFI_TAG, "✗ Failed to connect to SSID: %s, retrying in the background", WIFI_SSID);
+        bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+    }
+
     if (bits & WIFI_CONNECTED_BIT) {
         ESP_LOGI(WIFI_TAG, "✓ Connected to SSID: %s", WIFI_SSID);
 
@@ -282,233 +645,230 @@ static void wifi_init_sta(void)
             vTaskDelay(250 / portTICK_PERIOD_MS);
         }
 
+#if CONFIG_BEACON_SNTP
         ESP_LOGI(WIFI_TAG, "Network stable, initializing time sync...");
         initialize_sntp();
+#endif
 
-        ESP_LOGI(WIFI_TAG, "Starting webhook task...");
-        xTaskCreate(&webhook_task, "webhook", 12288, NULL, 3, NULL);  // 12KB stack (HTTPS with TLS)
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGE(WIFI_TAG, "✗ Failed to connect to SSID: %s", WIFI_SSID);
-    } else {
-        ESP_LOGE(WIFI_TAG, "✗ Unexpected WiFi event");
+#if CONFIG_BEACON_TELEMETRY
+        post_online_event();
+#endif
+        boot_timeline_log();
     }
 }
 
+#if LOW_POWER_MODE && CONFIG_BEACON_OTA
 /**
- * Initialize SNTP for time synchronization
+ * Bring Wi-Fi back up for a maintenance window
+ * Returns true once connected
  */
-static void initialize_sntp(void)
+static bool wifi_power_up(void)
 {
-    ESP_LOGI(TAG, "Initializing SNTP...");
-    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    esp_sntp_setservername(0, "pool.ntp.org");
-    esp_sntp_setservername(1, "time.google.com");
-    esp_sntp_init();
+    ESP_LOGI(WIFI_TAG, "Maintenance window: starting WiFi...");
+    xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+    s_retry_num = 0;
+    s_wifi_powered_down = false;
+    power_mgr_set_state(POWER_STATE_WIFI);
 
-    // Set timezone to UTC
-    setenv("TZ", "UTC", 1);
-    tzset();
+    ESP_ERROR_CHECK(esp_wifi_start());
+    esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
 
-    // Wait for time to be synchronized (max 10 seconds)
-    int retry = 0;
-    const int retry_count = 50;  // 50 * 200ms = 10 seconds
-    while (esp_sntp_get_sync_status() == SNTP_SYNC_STATUS_RESET && ++retry < retry_count) {
-        ESP_LOGI(TAG, "Waiting for system time to sync... (%d/%d)", retry, retry_count);
-        vTaskDelay(200 / portTICK_PERIOD_MS);
+    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
+            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+            pdFALSE,
+            pdFALSE,
+            30000 / portTICK_PERIOD_MS);
+    if (bits & WIFI_CONNECTED_BIT) {
+        return true;
     }
 
-    if (esp_sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED) {
-        ESP_LOGI(TAG, "✓ Time synchronized via SNTP");
-    } else {
-        ESP_LOGW(TAG, "⚠️ Failed to sync time via SNTP");
-    }
+    ESP_LOGW(WIFI_TAG, "⚠️  WiFi unavailable for this maintenance window");
+    return false;
 }
 
 /**
- * Get current timestamp in ISO 8601 format (UTC)
+ * Switch Wi-Fi off until the next maintenance window
  */
-static void get_timestamp(char* buffer, size_t buffer_size)
+static void wifi_power_down(void)
 {
-    time_t now;
-    struct tm timeinfo;
-    time(&now);
-    gmtime_r(&now, &timeinfo);
+    ESP_LOGI(WIFI_TAG, "Maintenance window closed, stopping WiFi");
+    s_wifi_powered_down = true;
+    esp_wifi_stop();
+    xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    power_mgr_set_state(POWER_STATE_ADVERTISING);
+}
+#endif
 
-    // Format: 2026-02-08T17:45:30Z
-    strftime(buffer, buffer_size, "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+/**
+ * Network bring-up, off the boot path so advertising does not wait for
+ * the access point or SNTP
+ */
+static void network_task(void *pvParameter)
+{
+    ESP_LOGI(TAG, "Initializing WiFi...");
+    wifi_init_sta();
+    vTaskDelete(NULL);
 }
+#endif
 
+#if CONFIG_BEACON_SNTP
 /**
- * Webhook task (runs once or periodically, depending on WEBHOOK_INTERVAL_SEC)
+ * SNTP callback - the clock is valid from here on
  */
-static void webhook_task(void *pvParameter)
+static void time_sync_notification_cb(struct timeval *tv)
 {
-    ESP_LOGI(TAG, "Webhook task started, sending notification...");
-    ESP_LOGI(TAG, "Free heap: %lu bytes", esp_get_free_heap_size());
+    boot_timeline_mark(BOOT_STAGE_TIME_SYNCED);
+    ESP_LOGI(TAG, "✓ Time synchronized via SNTP");
+}
 
-    // Get MAC address for device identification
-    uint8_t mac[6];
-    esp_read_mac(mac, ESP_MAC_WIFI_STA);
-    char mac_str[18];
-    snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
-             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+/**
+ * Initialize SNTP for time synchronization
+ * Does not wait for the first sync; users of the time check it is valid
+ */
+static void initialize_sntp(void)
+{
+    ESP_LOGI(TAG, "Initializing SNTP...");
 
-    while (1) {
-        // Get current timestamp
-        char timestamp[32];
-        get_timestamp(timestamp, sizeof(timestamp));
-
-        // Get firmware version from app descriptor
-        const esp_app_desc_t *app_desc = esp_app_get_description();
-
-        // Create compact JSON payload
-        static char json_payload[650];  // Increased size for version and timestamp fields
-        snprintf(json_payload, sizeof(json_payload),
-            "{\"content\":\"iBeacon Connected\","
-            "\"embeds\":[{\"title\":\"ESP32 iBeacon Online\",\"color\":3066993,"
-            "\"fields\":["
-            "{\"name\":\"Device MAC\",\"value\":\"%s\",\"inline\":true},"
-            "{\"name\":\"Major\",\"value\":\"%d\",\"inline\":true},"
-            "{\"name\":\"Minor\",\"value\":\"%d\",\"inline\":true},"
-            "{\"name\":\"Firmware\",\"value\":\"%s\",\"inline\":true},"
-            "{\"name\":\"UUID\",\"value\":\"%s\",\"inline\":false},"
-            "{\"name\":\"WiFi SSID\",\"value\":\"%s\",\"inline\":true},"
-            "{\"name\":\"Interval\",\"value\":\"%dms\",\"inline\":true},"
-            "{\"name\":\"Timestamp\",\"value\":\"%s\",\"inline\":true}"
-            "]}]}",
-            mac_str,
-            g_beacon_major,
-            g_beacon_minor,
-            app_desc->version,
-            BEACON_UUID_STRING,
-            WIFI_SSID,
-            ADVERTISING_INTERVAL_MS,
-            timestamp
-        );
-
-        ESP_LOGI(TAG, "JSON payload size: %d bytes", strlen(json_payload));
-
-        // Configure HTTP client for HTTPS
-        ESP_LOGI(TAG, "Configuring HTTPS client...");
-        esp_http_client_config_t config = {
-            .url = WEBHOOK_URL,
-            .method = HTTP_METHOD_POST,
-            .timeout_ms = 10000,
-            .crt_bundle_attach = esp_crt_bundle_attach,
-        };
+    // Set timezone to UTC
+    setenv("TZ", "UTC", 1);
+    tzset();
 
-        ESP_LOGI(TAG, "Initializing HTTP client...");
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        if (client == NULL) {
-            ESP_LOGE(TAG, "Failed to initialize HTTP client");
-            gpio_set_level(LED_GPIO, 0);
-            if (WEBHOOK_INTERVAL_SEC == 0) {
-                vTaskDelete(NULL);
-            }
-            continue;
-        }
+    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, "pool.ntp.org");
+    esp_sntp_setservername(1, "time.google.com");
+    esp_sntp_set_time_sync_notification_cb(time_sync_notification_cb);
+    esp_sntp_init();
+}
+#endif
 
-        ESP_LOGI(TAG, "Setting headers...");
-        esp_http_client_set_header(client, "Content-Type", "application/json");
-        esp_http_client_set_post_field(client, json_payload, strlen(json_payload));
-
-        ESP_LOGI(TAG, "Performing HTTP POST to webhook (payload: %d bytes)...", strlen(json_payload));
-        esp_err_t err = esp_http_client_perform(client);
-        ESP_LOGI(TAG, "HTTP perform completed: %s", esp_err_to_name(err));
-
-        if (err == ESP_OK) {
-            int status_code = esp_http_client_get_status_code(client);
-            int content_length = esp_http_client_get_content_length(client);
-
-            ESP_LOGI(TAG, "HTTP Status: %d, Content-Length: %d", status_code, content_length);
-
-            if (status_code == 200 || status_code == 204) {
-                ESP_LOGI(TAG, "✓ Webhook sent successfully (HTTP %d)", status_code);
-
-                // Blink LED 5 times rapidly to indicate success
-                for (int i = 0; i < 5; i++) {
-                    gpio_set_level(LED_GPIO, 1);  // On
-                    vTaskDelay(100 / portTICK_PERIOD_MS);
-                    gpio_set_level(LED_GPIO, 0);  // Off
-                    vTaskDelay(100 / portTICK_PERIOD_MS);
-                }
-            } else if (status_code >= 400) {
-                ESP_LOGE(TAG, "✗ Webhook error: HTTP %d", status_code);
-                gpio_set_level(LED_GPIO, 0);  // Turn off LED
-            } else {
-                ESP_LOGW(TAG, "⚠️  Webhook returned status: %d", status_code);
-                gpio_set_level(LED_GPIO, 0);  // Turn off LED
-            }
-        } else {
-            ESP_LOGE(TAG, "✗ Failed to send webhook: %s", esp_err_to_name(err));
-            gpio_set_level(LED_GPIO, 0);  // Turn off LED
-        }
+#if CONFIG_BEACON_TELEMETRY
+/**
+ * Queue the "online" telemetry event
+ */
+static void post_online_event(void)
+{
+    char uuid_str[37];
+    format_uuid_string(g_beacon_uuid, uuid_str);
+
+    char message[TELEMETRY_MESSAGE_LEN];
+    snprintf(message, sizeof(message), "UUID: %s\nWiFi SSID: %s\nInterval: %dms\nFirst advertisement: %ld ms after boot",
+             uuid_str, WIFI_SSID, ADVERTISING_INTERVAL_MS,
+             (long)boot_timeline_get_ms(BOOT_STAGE_FIRST_ADV));
+    telemetry_post(TELEMETRY_INFO, "ESP32 iBeacon Online", message);
+}
 
-        esp_http_client_cleanup(client);
+static void heartbeat_timer_cb(void *arg)
+{
+    post_online_event();
+}
 
-        // If WEBHOOK_INTERVAL_SEC is 0, send once and exit
-        // Otherwise, wait and send again
-        if (WEBHOOK_INTERVAL_SEC == 0) {
-            ESP_LOGI(TAG, "Webhook task complete (one-time mode), deleting task");
-            vTaskDelete(NULL);
-            return;
-        } else {
-            ESP_LOGI(TAG, "Waiting %d seconds before next webhook...", WEBHOOK_INTERVAL_SEC);
-            vTaskDelay((WEBHOOK_INTERVAL_SEC * 1000) / portTICK_PERIOD_MS);
-        }
+/**
+ * Blink LED 5 times rapidly when telemetry was delivered
+ */
+static void telemetry_delivered(int events)
+{
+    for (int i = 0; i < 5; i++) {
+        gpio_set_level(LED_GPIO, 1);  // On
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+        gpio_set_level(LED_GPIO, 0);  // Off
+        vTaskDelay(100 / portTICK_PERIOD_MS);
     }
 }
 
 /**
- * Convert UUID string to byte array
+ * Start the telemetry queue and the optional heartbeat
  */
-static void parse_uuid_string(const char* uuid_str, uint8_t* uuid_bytes)
+static void start_telemetry(void)
 {
-    int byte_index = 0;
+    const telemetry_config_t telemetry_config = {
+        .url = WEBHOOK_URL,
+        .flush_interval_ms = TELEMETRY_FLUSH_SEC * 1000,
+        .major = g_beacon_major,
+        .minor = g_beacon_minor,
+        .on_delivered = telemetry_delivered,
+    };
+    esp_err_t err = telemetry_start(&telemetry_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start telemetry: %s", esp_err_to_name(err));
+        return;
+    }
 
-    for (int i = 0; uuid_str[i] != '\0' && byte_index < 16; i++) {
-        if (uuid_str[i] == '-') {
-            continue;
+    if (WEBHOOK_INTERVAL_SEC > 0) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = heartbeat_timer_cb,
+            .name = "heartbeat",
+        };
+        esp_timer_handle_t heartbeat_timer;
+        if (esp_timer_create(&timer_args, &heartbeat_timer) == ESP_OK) {
+            esp_timer_start_periodic(heartbeat_timer, (uint64_t)WEBHOOK_INTERVAL_SEC * 1000000);
         }
-        char hex_pair[3] = {uuid_str[i], uuid_str[i+1], '\0'};
-        uuid_bytes[byte_index] = (uint8_t)strtol(hex_pair, NULL, 16);
-        byte_index++;
-        i++;
     }
 }
-
-// Bluetooth advertising parameters
-static esp_ble_adv_params_t adv_params = {
-    .adv_int_min        = ADVERTISING_INTERVAL_MS * 1000 / 625,
-    .adv_int_max        = ADVERTISING_INTERVAL_MS * 1000 / 625,
-    .adv_type           = ADV_TYPE_NONCONN_IND,
-    .own_addr_type      = BLE_ADDR_TYPE_PUBLIC,
-    .channel_map        = ADV_CHNL_ALL,
-    .adv_filter_policy  = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+#endif
+
+#if IBEACON_MODE == IBEACON_SENDER
+// Additional identities from BEACON_EXTRA_IDENTITIES
+typedef struct {
+    const char *uuid;
+    uint16_t major;
+    uint16_t minor;
+} beacon_identity_config_t;
+
+static const beacon_identity_config_t s_extra_identities[] = {
+    BEACON_EXTRA_IDENTITIES
+    { NULL, 0, 0 }
 };
+#endif
 
+#if CONFIG_BT_BLUEDROID_ENABLED
 /**
  * Bluetooth GAP event handler
  */
 static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
 {
-    esp_err_t err;
-
-    switch (event) {
-    case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT:
-        esp_ble_gap_start_advertising(&adv_params);
-        break;
+#if IBEACON_MODE == IBEACON_RECEIVER
+    beacon_scan_handle_gap_event(event, param);
+
+    // For a gateway the radio check is scanning
+    if ((event == ESP_GAP_BLE_SCAN_START_COMPLETE_EVT &&
+         param->scan_start_cmpl.status == ESP_BT_STATUS_SUCCESS)
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+        || (event == ESP_GAP_BLE_EXT_SCAN_START_COMPLETE_EVT &&
+            param->ext_scan_start.status == ESP_BT_STATUS_SUCCESS)
+#endif
+        ) {
+        ota_selftest_pass(OTA_SELFTEST_ADVERTISING);
+    }
+    return;
+#endif
+
+    // Advertising is driven by the beacon_adv engine
+    beacon_adv_handle_gap_event(event, param);
+
+    // Time off air while the engine restarts advertising (profile or
+    // parameter changes); on-air jitter is measured by a gateway
+    static int64_t s_adv_stopped_us;
+    if (event == ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+        || event == ESP_GAP_BLE_EXT_ADV_STOP_COMPLETE_EVT
+#endif
+        ) {
+        s_adv_stopped_us = esp_timer_get_time();
+    }
 
-    case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
-        if ((err = param->adv_start_cmpl.status) != ESP_BT_STATUS_SUCCESS) {
-            ESP_LOGE(TAG, "Advertising start failed: %s", esp_err_to_name(err));
-        } else {
-            ESP_LOGI(TAG, "✓ iBeacon is broadcasting at %dms intervals!", ADVERTISING_INTERVAL_MS);
+    if ((event == ESP_GAP_BLE_ADV_START_COMPLETE_EVT &&
+         param->adv_start_cmpl.status == ESP_BT_STATUS_SUCCESS)
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+        || (event == ESP_GAP_BLE_EXT_ADV_START_COMPLETE_EVT &&
+            param->ext_adv_start.status == ESP_BT_STATUS_SUCCESS)
+#endif
+        ) {
+        boot_timeline_mark(BOOT_STAGE_FIRST_ADV);
+        ota_selftest_pass(OTA_SELFTEST_ADVERTISING);
+        if (s_adv_stopped_us != 0) {
+            metrics_record_time(METRIC_TIME_ADV_OFF, (esp_timer_get_time() - s_adv_stopped_us) / 1000, 0);
+            s_adv_stopped_us = 0;
         }
-        break;
-
-    default:
-        break;
     }
 }
 
@@ -535,178 +895,189 @@ static void bluetooth_init(void)
 
     ESP_LOGI(TAG, "✓ Bluetooth initialized");
 }
+#endif
 
+#if IBEACON_MODE == IBEACON_SENDER
 /**
  * Configure and start iBeacon advertising
  */
-static void start_ibeacon(void)
+static esp_err_t start_ibeacon(void)
 {
     ESP_LOGI(TAG, "Configuring iBeacon...");
 
-    uint8_t beacon_uuid[16];
-    parse_uuid_string(BEACON_UUID_STRING, beacon_uuid);
+    // Primary identity first, then the extras - all encoded once here
+    beacon_adv_identity_t identities[BEACON_ADV_MAX_IDENTITIES] = {0};
+    size_t count = 0;
+
+    memcpy(identities[count].uuid, g_beacon_uuid, sizeof(g_beacon_uuid));
+    identities[count].major = g_beacon_major;
+    identities[count].minor = g_beacon_minor;
+    identities[count].measured_power = BEACON_MEASURED_POWER;
+    count++;
+
+    for (size_t i = 0; s_extra_identities[i].uuid != NULL; i++) {
+        if (count == BEACON_ADV_MAX_IDENTITIES) {
+            ESP_LOGW(TAG, "⚠️  Too many identities, ignoring the rest");
+            break;
+        }
+        if (!parse_uuid_string(s_extra_identities[i].uuid, identities[count].uuid)) {
+            ESP_LOGW(TAG, "⚠️  Invalid extra identity UUID \"%s\", skipped", s_extra_identities[i].uuid);
+            continue;
+        }
+        identities[count].major = s_extra_identities[i].major;
+        identities[count].minor = s_extra_identities[i].minor;
+        identities[count].measured_power = BEACON_MEASURED_POWER;
+        count++;
+    }
 
-    esp_ble_set_ibeacon_params(beacon_uuid, g_beacon_major, g_beacon_minor);
-    esp_ble_print_ibeacon_config();
+    const beacon_adv_config_t adv_config = {
+        .interval_ms = ADVERTISING_INTERVAL_MS,
+        .tx_power = TRANSMIT_POWER,
+        .rotation_ms = BEACON_ROTATION_MS,
+    };
 
-    esp_ble_ibeacon_t ibeacon_adv_data;
-    esp_err_t status = esp_ble_config_ibeacon_data(&vendor_config, &ibeacon_adv_data);
+    esp_err_t status = beacon_adv_init(identities, count, &adv_config);
+    if (status == ESP_OK) {
+        status = beacon_adv_start();
+    }
 
     if (status == ESP_OK) {
-        esp_ble_gap_config_adv_data_raw((uint8_t*)&ibeacon_adv_data, sizeof(ibeacon_adv_data));
-        esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_ADV, TRANSMIT_POWER);
-        ESP_LOGI(TAG, "✓ iBeacon configured successfully");
+        ESP_LOGI(TAG, "✓ iBeacon configured successfully (%d identit%s)", (int)count, count == 1 ? "y" : "ies");
     } else {
         ESP_LOGE(TAG, "Failed to configure iBeacon: %s", esp_err_to_name(status));
     }
+    return status;
 }
+#endif
 
+#if IBEACON_MODE == IBEACON_RECEIVER
 /**
- * Send OTA error webhook notification
+ * Scan for beacons instead of advertising
  */
-static void send_ota_error_webhook(const char* error_message)
+static void start_gateway(void)
 {
-    ESP_LOGI(OTA_TAG, "Sending OTA error webhook...");
-
-    // Get MAC address
-    uint8_t mac[6];
-    esp_read_mac(mac, ESP_MAC_WIFI_STA);
-    char mac_str[18];
-    snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
-             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    const beacon_scan_config_t scan_config = {
+        .report_url = GATEWAY_REPORT_URL,
+        .report_interval_ms = GATEWAY_REPORT_SEC * 1000,
+        .expire_ms = GATEWAY_EXPIRE_SEC * 1000,
+        .scan_interval_ms = GATEWAY_SCAN_INTERVAL_MS,
+        .adv_interval_ms = GATEWAY_BEACON_INTERVAL_MS,
+        .major = g_beacon_major,
+        .minor = g_beacon_minor,
+    };
 
-    // Get current timestamp
-    char timestamp[32];
-    get_timestamp(timestamp, sizeof(timestamp));
-
-    // Get firmware version from app descriptor
-    const esp_app_desc_t *app_desc = esp_app_get_description();
+    esp_err_t err = beacon_scan_start(&scan_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start gateway scan: %s", esp_err_to_name(err));
+    }
+}
+#endif
 
-    // Create JSON payload for error
-    static char json_payload[650];
-    snprintf(json_payload, sizeof(json_payload),
-        "{\"content\":\"⚠️ OTA Update Failed\","
-        "\"embeds\":[{\"title\":\"ESP32 OTA Error\",\"color\":15158332,"
-        "\"fields\":["
-        "{\"name\":\"Device MAC\",\"value\":\"%s\",\"inline\":true},"
-        "{\"name\":\"Major\",\"value\":\"%d\",\"inline\":true},"
-        "{\"name\":\"Minor\",\"value\":\"%d\",\"inline\":true},"
-        "{\"name\":\"Error\",\"value\":\"%s\",\"inline\":false},"
-        "{\"name\":\"Firmware\",\"value\":\"%s\",\"inline\":true},"
-        "{\"name\":\"Timestamp\",\"value\":\"%s\",\"inline\":true},"
-        "{\"name\":\"OTA URL\",\"value\":\"%s\",\"inline\":false}"
-        "]}]}",
-        mac_str,
-        g_beacon_major,
-        g_beacon_minor,
-        error_message,
-        app_desc->version,
-        timestamp,
-        OTA_DOWNLOAD_URL
-    );
-
-    // Configure HTTP client for HTTPS
-    esp_http_client_config_t config = {
-        .url = WEBHOOK_URL,
-        .method = HTTP_METHOD_POST,
-        .timeout_ms = 10000,
-        .crt_bundle_attach = esp_crt_bundle_attach,
+#if ADV_PROFILES_ENABLED && IBEACON_MODE == IBEACON_SENDER
+/**
+ * Hand advertising over to the adaptive profile scheduler
+ */
+static void start_adv_profiles(void)
+{
+    const adv_profile_config_t profile_config = {
+        .profiles = {
+            [ADV_PROFILE_BOOT]   = { ADVERTISING_INTERVAL_MS, TRANSMIT_POWER },
+            [ADV_PROFILE_MOTION] = { ADVERTISING_INTERVAL_MS, TRANSMIT_POWER },
+            [ADV_PROFILE_IDLE]   = { ADV_IDLE_INTERVAL_MS, TRANSMIT_POWER },
+            [ADV_PROFILE_NIGHT]  = { ADV_NIGHT_INTERVAL_MS, ADV_NIGHT_TX_POWER },
+        },
+        .boot_fast_sec = ADV_BOOT_FAST_SEC,
+        .motion_hold_sec = ADV_MOTION_HOLD_SEC,
+        .motion_gpio = ADV_MOTION_GPIO,
+        .night_start_hour = ADV_NIGHT_START_HOUR,
+        .night_end_hour = ADV_NIGHT_END_HOUR,
     };
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (client == NULL) {
-        ESP_LOGE(OTA_TAG, "Failed to initialize HTTP client for webhook");
-        return;
+    esp_err_t err = adv_profile_start(&profile_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start adaptive advertising: %s", esp_err_to_name(err));
     }
+}
+#endif
 
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, json_payload, strlen(json_payload));
+#if CONFIG_BT_NIMBLE_ENABLED
+#if IBEACON_MODE == IBEACON_RECEIVER
+#error "The gateway scanner (beacon_scan.c) needs the Bluedroid host"
+#endif
 
-    esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        if (status_code == 200 || status_code == 204) {
-            ESP_LOGI(OTA_TAG, "✓ OTA error webhook sent successfully");
-        } else {
-            ESP_LOGW(OTA_TAG, "⚠️ Webhook returned status: %d", status_code);
-        }
+/**
+ * Host and controller in sync - advertising can start. Called again after
+ * a host reset, which loses the advertiser.
+ */
+static void nimble_on_sync(void)
+{
+    static bool s_configured = false;
+
+    esp_err_t err;
+    if (!s_configured) {
+        err = start_ibeacon();
+#if ADV_PROFILES_ENABLED
+        start_adv_profiles();
+#endif
+        s_configured = true;
     } else {
-        ESP_LOGE(OTA_TAG, "✗ Failed to send webhook: %s", esp_err_to_name(err));
+        err = beacon_adv_start();
     }
 
-    esp_http_client_cleanup(client);
+    // NimBLE has started the advertiser once the call returns
+    if (err == ESP_OK) {
+        boot_timeline_mark(BOOT_STAGE_FIRST_ADV);
+        ota_selftest_pass(OTA_SELFTEST_ADVERTISING);
+    }
 }
 
-/**
- * Send OTA success webhook notification
- */
-static void send_ota_success_webhook(const char* status_message)
+static void nimble_on_reset(int reason)
 {
-    ESP_LOGI(OTA_TAG, "Sending OTA success webhook...");
-
-    // Get MAC address
-    uint8_t mac[6];
-    esp_read_mac(mac, ESP_MAC_WIFI_STA);
-    char mac_str[18];
-    snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
-             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-
-    // Get current timestamp
-    char timestamp[32];
-    get_timestamp(timestamp, sizeof(timestamp));
+    ESP_LOGW(TAG, "⚠️  NimBLE host reset (reason %d), advertising resumes on resync", reason);
+}
 
-    // Get firmware version from app descriptor
-    const esp_app_desc_t *app_desc = esp_app_get_description();
+static void nimble_host_task(void *param)
+{
+    nimble_port_run();      // Returns only once the host is stopped
+    nimble_port_freertos_deinit();
+}
 
-    // Create JSON payload for success
-    static char json_payload[650];
-    snprintf(json_payload, sizeof(json_payload),
-        "{\"content\":\"✅ OTA Check Complete\","
-        "\"embeds\":[{\"title\":\"ESP32 OTA Status\",\"color\":5763719,"
-        "\"fields\":["
-        "{\"name\":\"Device MAC\",\"value\":\"%s\",\"inline\":true},"
-        "{\"name\":\"Major\",\"value\":\"%d\",\"inline\":true},"
-        "{\"name\":\"Minor\",\"value\":\"%d\",\"inline\":true},"
-        "{\"name\":\"Status\",\"value\":\"%s\",\"inline\":false},"
-        "{\"name\":\"Firmware\",\"value\":\"%s\",\"inline\":true},"
-        "{\"name\":\"Timestamp\",\"value\":\"%s\",\"inline\":true},"
-        "{\"name\":\"Free Heap\",\"value\":\"%lu bytes\",\"inline\":true}"
-        "]}]}",
-        mac_str,
-        g_beacon_major,
-        g_beacon_minor,
-        status_message,
-        app_desc->version,
-        timestamp,
-        esp_get_free_heap_size()
-    );
-
-    // Configure HTTP client for HTTPS
-    esp_http_client_config_t config = {
-        .url = WEBHOOK_URL,
-        .method = HTTP_METHOD_POST,
-        .timeout_ms = 10000,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-    };
+/**
+ * Bring up the NimBLE host; it initializes the controller as well.
+ * Advertising starts from the sync callback.
+ */
+static void bluetooth_init(void)
+{
+    ESP_LOGI(TAG, "Initializing Bluetooth (NimBLE)...");
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (client == NULL) {
-        ESP_LOGE(OTA_TAG, "Failed to initialize HTTP client for webhook");
+    esp_err_t err = nimble_port_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NimBLE init failed: %s", esp_err_to_name(err));
         return;
     }
+    ble_hs_cfg.sync_cb = nimble_on_sync;
+    ble_hs_cfg.reset_cb = nimble_on_reset;
+    nimble_port_freertos_init(nimble_host_task);
 
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, json_payload, strlen(json_payload));
+    ESP_LOGI(TAG, "✓ Bluetooth initialized");
+}
+#endif
 
-    esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        if (status_code == 200 || status_code == 204) {
-            ESP_LOGI(OTA_TAG, "✓ OTA success webhook sent");
-        }
-    }
+#if CONFIG_BEACON_OTA
+/**
+ * Queue OTA error telemetry
+ */
+static void send_ota_error_webhook(const char* error_message)
+{
+    telemetry_post(TELEMETRY_ERROR, "⚠️ OTA Update Failed", error_message);
+}
 
-    esp_http_client_cleanup(client);
+/**
+ * Queue OTA status telemetry
+ */
+static void send_ota_success_webhook(const char* status_message)
+{
+    telemetry_post(TELEMETRY_INFO, "✅ OTA Check Complete", status_message);
 }
 
 /**
@@ -763,35 +1134,174 @@ static int compare_versions(const char *v1, const char *v2)
     return 0;  // Equal
 }
 
+// Response headers captured by the OTA session event handler
+static char s_response_etag[72];
+static char s_response_last_modified[32];
+
+// Backoff requested by the server (Retry-After on a 503), 0 when none
+static int s_retry_after_sec = 0;
+
+// Validators and body of the last 200 version response, for conditional polling
+static char s_version_etag[72];
+static char s_version_last_modified[32];
+static char s_cached_version[32];
+
+// X-Image-Size of the last response (decompressed size of a .z image)
+static uint32_t s_response_image_size;
+
+// X-Force-Update of the last response, and of the cached version answer:
+// the server asks for its build even when it is not a newer version
+static bool s_response_force;
+static bool s_cached_force;
+
+// Connection stats of the OTA session and the long-poll client
+static tls_profile_stats_t s_ota_tls_stats = TLS_PROFILE_STATS_INIT("ota");
+static tls_profile_stats_t s_ota_wait_tls_stats = TLS_PROFILE_STATS_INIT("ota-wait");
+
+/**
+ * HTTP event handler for the OTA session - captures validators
+ */
+static esp_err_t ota_http_event_handler(esp_http_client_event_t *evt)
+{
+    tls_profile_http_event(evt->user_data, evt);
+    if (evt->event_id != HTTP_EVENT_ON_HEADER) {
+        return ESP_OK;
+    }
+
+    if (strcasecmp(evt->header_key, "ETag") == 0) {
+        strncpy(s_response_etag, evt->header_value, sizeof(s_response_etag) - 1);
+        s_response_etag[sizeof(s_response_etag) - 1] = '\0';
+    } else if (strcasecmp(evt->header_key, "Last-Modified") == 0) {
+        strncpy(s_response_last_modified, evt->header_value, sizeof(s_response_last_modified) - 1);
+        s_response_last_modified[sizeof(s_response_last_modified) - 1] = '\0';
+    } else if (strcasecmp(evt->header_key, "X-Image-Size") == 0) {
+        s_response_image_size = strtoul(evt->header_value, NULL, 10);
+    } else if (strcasecmp(evt->header_key, "X-Force-Update") == 0) {
+        s_response_force = strcasecmp(evt->header_value, "true") == 0;
+    } else if (strcasecmp(evt->header_key, "Retry-After") == 0) {
+        int seconds = atoi(evt->header_value);
+        if (seconds > OTA_RETRY_AFTER_MAX_SEC) {
+            seconds = OTA_RETRY_AFTER_MAX_SEC;
+        }
+        s_retry_after_sec = seconds > 0 ? seconds : 0;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Identify this device to the OTA server: the rollout scheduler, and the
+ * channel targeting, which picks a build by MAC or beacon major and
+ * compares it with the running one by SHA-256
+ */
+static void ota_set_device_headers(esp_http_client_handle_t client)
+{
+    static char mac_str[18];
+    static char sha_str[65];
+    if (mac_str[0] == '\0') {
+        uint8_t mac[6];
+        esp_read_mac(mac, ESP_MAC_WIFI_STA);
+        snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    }
+    if (sha_str[0] == '\0') {
+        // Same hash the server computes for the images in its store
+        uint8_t sha[32];
+        if (esp_partition_get_sha256(esp_ota_get_running_partition(), sha) == ESP_OK) {
+            for (int i = 0; i < 32; i++) {
+                snprintf(&sha_str[i * 2], 3, "%02x", sha[i]);
+            }
+        }
+    }
+
+    char major_str[6];
+    snprintf(major_str, sizeof(major_str), "%u", g_beacon_major);
+
+    esp_http_client_set_header(client, "X-Device-MAC", mac_str);
+    esp_http_client_set_header(client, "X-Firmware-Version", esp_app_get_description()->version);
+    esp_http_client_set_header(client, "X-Beacon-Major", major_str);
+    if (sha_str[0] != '\0') {
+        esp_http_client_set_header(client, "X-Firmware-SHA256", sha_str);
+    }
+}
+
+/**
+ * Sleep for the server-requested backoff, if any
+ * Returns true if a Retry-After was honored
+ */
+static bool ota_honor_retry_after(void)
+{
+    if (s_retry_after_sec <= 0) {
+        return false;
+    }
+
+    ESP_LOGI(OTA_TAG, "Server asked to retry in %d seconds", s_retry_after_sec);
+    vTaskDelay((s_retry_after_sec * 1000) / portTICK_PERIOD_MS);
+    s_retry_after_sec = 0;
+    return true;
+}
+
+/**
+ * Start a request on the OTA session, reusing its keep-alive connection
+ */
+static void ota_session_request(esp_http_client_handle_t client, const char *url, int timeout_ms)
+{
+    s_response_etag[0] = '\0';
+    s_response_last_modified[0] = '\0';
+    s_response_image_size = 0;
+    s_response_force = false;
+    tls_profile_request_begin(&s_ota_tls_stats);
+
+    // Same host keeps the connection; headers from the previous request are dropped
+    esp_http_client_set_url(client, url);
+    esp_http_client_set_timeout_ms(client, timeout_ms);
+    esp_http_client_delete_header(client, "If-None-Match");
+    esp_http_client_delete_header(client, "If-Modified-Since");
+    esp_http_client_delete_header(client, "Range");
+    esp_http_client_delete_header(client, "If-Range");
+    ota_set_device_headers(client);
+}
+
+/**
+ * Finish a response so the connection can carry the next request
+ */
+static void ota_session_drain(esp_http_client_handle_t client)
+{
+    int flushed = 0;
+    if (esp_http_client_flush_response(client, &flushed) != ESP_OK) {
+        // Unknown state on the wire - reconnect for the next request
+        esp_http_client_close(client);
+    }
+}
+
 /**
- * Check if OTA update is available (using HEAD request)
- * Returns: 1 if update available, 0 if up to date, -1 on error
+ * Check if OTA update is available (conditional GET on the version endpoint)
+ *
+ * Sends the validators of the last answer, so an unchanged server replies
+ * 304 with no body and the cached version is compared again.
+ * Returns: 1 if update available, 0 if up to date, 2 if the rollout
+ * scheduler deferred us (see s_retry_after_sec), -1 on error
  */
-static int check_ota_available(char *new_version, size_t version_len, bool *force_update)
+static int check_ota_available(esp_http_client_handle_t client, char *new_version, size_t version_len, bool *force_update)
 {
     ESP_LOGI(OTA_TAG, "Checking version at: %s", OTA_VERSION_CHECK_URL);
 
     *force_update = false;
 
-    // Simple GET request to version endpoint
-    esp_http_client_config_t config = {
-        .url = OTA_VERSION_CHECK_URL,
-        .timeout_ms = 10000,
-        .method = HTTP_METHOD_GET,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-    };
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (client == NULL) {
-        ESP_LOGE(OTA_TAG, "Failed to initialize HTTP client");
-        return -1;
+    ota_session_request(client, OTA_VERSION_CHECK_URL, 10000);
+    if (s_cached_version[0] != '\0') {
+        if (s_version_etag[0] != '\0') {
+            esp_http_client_set_header(client, "If-None-Match", s_version_etag);
+        }
+        if (s_version_last_modified[0] != '\0') {
+            esp_http_client_set_header(client, "If-Modified-Since", s_version_last_modified);
+        }
     }
 
-    // Open connection
+    // Open connection (reused if still alive)
     esp_err_t err = esp_http_client_open(client, 0);
     if (err != ESP_OK) {
         ESP_LOGE(OTA_TAG, "Failed to open connection: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
+        esp_http_client_close(client);
         return -1;
     }
 
@@ -801,43 +1311,57 @@ static int check_ota_available(char *new_version, size_t version_len, bool *forc
 
     ESP_LOGI(OTA_TAG, "GET response: status=%d, content_length=%d", status_code, content_length);
 
-    if (status_code != 200) {
+    if (status_code == 304) {
+        ESP_LOGI(OTA_TAG, "Version unchanged since last check (304)");
+        ota_session_drain(client);
+        strncpy(new_version, s_cached_version, version_len - 1);
+        new_version[version_len - 1] = '\0';
+        *force_update = s_cached_force;
+    } else if (status_code == 503) {
+        ESP_LOGI(OTA_TAG, "Rollout wave not open for this device yet");
+        ota_session_drain(client);
+        return 2;
+    } else if (status_code != 200) {
         ESP_LOGE(OTA_TAG, "GET request returned status: %d", status_code);
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
+        ota_session_drain(client);
         return -1;
-    }
-
-    // Read the response body (version string)
-    char buffer[32] = {0};
-    int read_len = esp_http_client_read(client, buffer, sizeof(buffer) - 1);
+    } else {
+        // Read the response body (version string)
+        char buffer[32] = {0};
+        int read_len = esp_http_client_read_response(client, buffer, sizeof(buffer) - 1);
+        ota_session_drain(client);
+
+        if (read_len <= 0) {
+            ESP_LOGE(OTA_TAG, "Failed to read version from response body (read_len=%d)", read_len);
+            return -1;
+        }
 
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
+        buffer[read_len] = '\0';
 
-    if (read_len <= 0) {
-        ESP_LOGE(OTA_TAG, "Failed to read version from response body (read_len=%d)", read_len);
-        return -1;
-    }
+        // Remove any whitespace/newlines
+        char *version_start = buffer;
+        while (*version_start && (*version_start == ' ' || *version_start == '\n' || *version_start == '\r')) {
+            version_start++;
+        }
 
-    buffer[read_len] = '\0';
+        char *version_end = version_start + strlen(version_start) - 1;
+        while (version_end > version_start && (*version_end == ' ' || *version_end == '\n' || *version_end == '\r')) {
+            *version_end = '\0';
+            version_end--;
+        }
 
-    // Remove any whitespace/newlines
-    char *version_start = buffer;
-    while (*version_start && (*version_start == ' ' || *version_start == '\n' || *version_start == '\r')) {
-        version_start++;
-    }
+        // Copy version string to output buffer
+        strncpy(new_version, version_start, version_len - 1);
+        new_version[version_len - 1] = '\0';
 
-    char *version_end = version_start + strlen(version_start) - 1;
-    while (version_end > version_start && (*version_end == ' ' || *version_end == '\n' || *version_end == '\r')) {
-        *version_end = '\0';
-        version_end--;
+        // Remember validators for the next conditional request
+        strncpy(s_cached_version, new_version, sizeof(s_cached_version) - 1);
+        strcpy(s_version_etag, s_response_etag);
+        strcpy(s_version_last_modified, s_response_last_modified);
+        s_cached_force = s_response_force;
+        *force_update = s_response_force;
     }
 
-    // Copy version string to output buffer
-    strncpy(new_version, version_start, version_len - 1);
-    new_version[version_len - 1] = '\0';
-
     ESP_LOGI(OTA_TAG, "Server version: %s", new_version);
 
     // Get current version
@@ -845,7 +1369,8 @@ static int check_ota_available(char *new_version, size_t version_len, bool *forc
     ESP_LOGI(OTA_TAG, "Current firmware version: %s", running_app_info->version);
     ESP_LOGI(OTA_TAG, "Available firmware version: %s", new_version);
 
-    // If force update requested, always return update available
+    // The server targets this device at a different build: take it even if
+    // it is not a newer version (a canary, or a rollback)
     if (*force_update) {
         return 1;
     }
@@ -865,24 +1390,629 @@ static int check_ota_available(char *new_version, size_t version_len, bool *forc
     return 1;  // Update available
 }
 
+// OTA download tuning: the network fills OTA_WRITE_BLOCKS blocks of
+// OTA_BLOCK_SIZE while the writer task flashes them (see ota_writer.h);
+// OTA_HTTP_BUFFER_SIZE is the HTTP client's own receive buffer
+#define OTA_BLOCK_SIZE 4096
+#define OTA_WRITE_BLOCKS 4
+
+// Wi-Fi and BLE share one radio: a download at full speed keeps Wi-Fi busy
+// and advertising events are skipped. While advertising, reads are paced
+// to this rate, so the TCP window drains between bursts and the radio goes
+// idle for BLE. 0 = unpaced.
+#define OTA_COEX_MAX_KBPS CONFIG_BEACON_OTA_COEX_MAX_KBPS
+#define OTA_HTTP_BUFFER_SIZE 4096
+
+// Resume state is checkpointed to NVS every time this much firmware is flashed
+// (compressed images checkpoint at their 64 KB chunk boundaries)
+#define OTA_RESUME_CHECKPOINT_BYTES (64 * 1024)
+
+// Retry interval while a partial download is waiting to be resumed
+#define OTA_RESUME_RETRY_SEC 30
+
+// NVS namespace and key for the interrupted-download state
+#define NVS_OTA_NAMESPACE "ota_state"
+#define NVS_KEY_OTA_RESUME "resume"
+
+/**
+ * Interrupted download, saved so the next attempt can continue with Range
+ */
+typedef struct {
+    char etag[72];                      // Server ETag of the image being downloaded
+    uint8_t compressed;                 // 1 = chunked zlib image, 0 = raw binary
+    uint32_t partition_address;         // Target partition (must still be the next update slot)
+    uint32_t download_offset;           // Next byte to request from the server
+    uint32_t image_offset;              // Firmware bytes already in flash
+    ota_image_checkpoint_t checkpoint;  // Decoder position (compressed images only)
+} ota_resume_state_t;
+
+/**
+ * Load the saved resume state, if any
+ */
+static bool load_ota_resume_state(ota_resume_state_t *state)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_OTA_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+
+    size_t len = sizeof(*state);
+    esp_err_t err = nvs_get_blob(nvs_handle, NVS_KEY_OTA_RESUME, state, &len);
+    nvs_close(nvs_handle);
+
+    return err == ESP_OK && len == sizeof(*state) && state->etag[0] != '\0';
+}
+
+/**
+ * Save the resume state after a checkpoint
+ */
+static esp_err_t save_ota_resume_state(const ota_resume_state_t *state)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_OTA_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = nvs_set_blob(nvs_handle, NVS_KEY_OTA_RESUME, state, sizeof(*state));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+/**
+ * Forget any partial download
+ */
+static void clear_ota_resume_state(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_OTA_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        if (nvs_erase_key(nvs_handle, NVS_KEY_OTA_RESUME) == ESP_OK) {
+            nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+}
+
+/**
+ * Check whether an interrupted download is waiting to be resumed
+ */
+static bool ota_resume_pending(void)
+{
+    ota_resume_state_t state;
+    return load_ota_resume_state(&state);
+}
+
+/**
+ * Read until the buffer is full or the response ends
+ */
+static int http_read_block(esp_http_client_handle_t client, uint8_t *buffer, int len)
+{
+    int total = 0;
+    while (total < len) {
+        int read_len = esp_http_client_read(client, (char *)buffer + total, len - total);
+        if (read_len < 0) {
+            return read_len;
+        }
+        if (read_len == 0) {
+            break;
+        }
+        total += read_len;
+    }
+    return total;
+}
+
+/**
+ * Fetch and check the signed manifest of the offered build.
+ * Returns ESP_ERR_NOT_FOUND when the server publishes none.
+ */
+static esp_err_t fetch_ota_manifest(esp_http_client_handle_t client, ota_manifest_t **out_manifest)
+{
+    ota_session_request(client, OTA_MANIFEST_URL, 10000);
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "Failed to open connection: %s", esp_err_to_name(err));
+        esp_http_client_close(client);
+        return err;
+    }
+
+    int content_length = esp_http_client_fetch_headers(client);
+    int status_code = esp_http_client_get_status_code(client);
+    if (status_code != 200) {
+        ota_session_drain(client);
+        return (status_code == 404) ? ESP_ERR_NOT_FOUND : ESP_ERR_INVALID_RESPONSE;
+    }
+    if (content_length <= 0 || content_length > OTA_MANIFEST_MAX_SIZE) {
+        ESP_LOGE(OTA_TAG, "✗ Unexpected manifest size: %d", content_length);
+        esp_http_client_close(client);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t *buffer = malloc(content_length);
+    if (buffer == NULL) {
+        esp_http_client_close(client);
+        return ESP_ERR_NO_MEM;
+    }
+    if (http_read_block(client, buffer, content_length) == content_length) {
+        err = ota_manifest_parse(buffer, content_length, out_manifest);
+    } else {
+        ESP_LOGE(OTA_TAG, "✗ Manifest download incomplete");
+        err = ESP_FAIL;
+    }
+    free(buffer);
+
+    if (err == ESP_OK) {
+        ota_session_drain(client);
+    } else {
+        esp_http_client_close(client);
+    }
+    return err;
+}
+
+/**
+ * Download in progress, shared with the writer task
+ */
+typedef struct {
+    const esp_partition_t *partition;
+    bool compressed;
+    bool resuming;
+    uint32_t erase_size;                // Pre-erase size, or OTA_WITH_SEQUENTIAL_WRITES
+    esp_ota_handle_t update_handle;
+    ota_image_decoder_t *decoder;
+    ota_manifest_t *manifest;           // NULL when the server publishes none
+    ota_resume_state_t resume;
+    uint32_t saved_offset;              // image_offset of the last NVS checkpoint
+} ota_download_t;
+
+/**
+ * Writer task: check firmware against the manifest, then flash it.
+ * Also the write callback of the decoder for compressed images.
+ */
+static esp_err_t ota_flash_write_cb(const uint8_t *data, size_t len, void *ctx)
+{
+    ota_download_t *dl = ctx;
+    if (dl->manifest != NULL) {
+        esp_err_t err = ota_manifest_verify(dl->manifest, data, len);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return esp_ota_write(dl->update_handle, data, len);
+}
+
+/**
+ * Writer task: open the update partition, pre-erasing it when the image
+ * size is known (resumed downloads keep erasing sector by sector)
+ */
+static esp_err_t ota_download_begin(void *ctx)
+{
+    ota_download_t *dl = ctx;
+    esp_err_t err;
+
+    if (dl->resuming) {
+        err = esp_ota_resume(dl->partition, OTA_WITH_SEQUENTIAL_WRITES, dl->resume.image_offset, &dl->update_handle);
+    } else {
+        err = esp_ota_begin(dl->partition, dl->erase_size, &dl->update_handle);
+    }
+    if (err == ESP_OK && dl->resuming && dl->manifest != NULL) {
+        err = ota_manifest_seek(dl->manifest, dl->partition, dl->resume.image_offset);
+        if (err != ESP_OK) {
+            esp_ota_abort(dl->update_handle);
+        }
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "✗ OTA %s failed: %s", dl->resuming ? "resume" : "begin", esp_err_to_name(err));
+        dl->update_handle = 0;
+        clear_ota_resume_state();
+    }
+    return err;
+}
+
+/**
+ * Writer task: flash one block and checkpoint the resume state
+ */
+static esp_err_t ota_download_write(const uint8_t *data, size_t len, void *ctx)
+{
+    ota_download_t *dl = ctx;
+    ota_resume_state_t *resume = &dl->resume;
+
+    esp_err_t err = dl->compressed ? ota_image_decoder_feed(dl->decoder, data, len)
+                                   : ota_flash_write_cb(data, len, dl);
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "✗ Flash write failed: %s", esp_err_to_name(err));
+        // Bad data, not a dropped connection - don't resume from it
+        clear_ota_resume_state();
+        return err;
+    }
+
+    // Advance the resume point to the last fully flashed boundary
+    if (dl->compressed) {
+        ota_image_decoder_get_checkpoint(dl->decoder, &resume->checkpoint);
+        resume->download_offset = resume->checkpoint.input_offset;
+        resume->image_offset = resume->checkpoint.output_offset;
+    } else {
+        resume->image_offset += len;
+        resume->download_offset = resume->image_offset;
+    }
+
+    // Raw images are read in whole blocks, so only a short final block can be unaligned
+    bool aligned = dl->compressed || (resume->image_offset % OTA_BLOCK_SIZE) == 0;
+    if (resume->etag[0] != '\0' && aligned &&
+        resume->image_offset - dl->saved_offset >= OTA_RESUME_CHECKPOINT_BYTES) {
+        save_ota_resume_state(resume);
+        dl->saved_offset = resume->image_offset;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Stream a firmware image into the inactive OTA partition
+ *
+ * Compressed images are inflated chunk by chunk as they arrive, so only the
+ * block pool and the 32 KB inflate window are held in RAM. Inflating and
+ * flashing run on the ota_writer task, overlapped with receiving.
+ *
+ * Progress is checkpointed to NVS. If a previous attempt for the same image
+ * was interrupted, the download continues with a Range request guarded by
+ * If-Range, so a new build on the server restarts the download from zero
+ * instead of mixing two images in flash.
+ *
+ * The request goes out on the OTA session's keep-alive connection, the
+ * same one the version check used.
+ *
+ * Returns ESP_ERR_NOT_FOUND if the server does not have the image and
+ * ESP_ERR_NOT_FINISHED if it is too busy to serve it now.
+ */
+static esp_err_t download_and_flash_image(esp_http_client_handle_t client, const char *url, bool compressed,
+                                          ota_manifest_t *manifest)
+{
+    ESP_LOGI(OTA_TAG, "Downloading firmware from: %s", url);
+
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(OTA_TAG, "No OTA partition available");
+        return ESP_FAIL;
+    }
+
+    ota_resume_state_t resume = {0};
+    bool resuming = load_ota_resume_state(&resume) &&
+                    resume.compressed == compressed &&
+                    resume.partition_address == update_partition->address &&
+                    resume.download_offset > 0;
+    if (!resuming) {
+        memset(&resume, 0, sizeof(resume));
+    }
+
+    ota_session_request(client, url, 30000);
+    if (resuming) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%lu-", (unsigned long)resume.download_offset);
+        esp_http_client_set_header(client, "Range", range);
+        esp_http_client_set_header(client, "If-Range", resume.etag);
+        ESP_LOGI(OTA_TAG, "Resuming download at byte %lu (%lu bytes already flashed)",
+                 (unsigned long)resume.download_offset, (unsigned long)resume.image_offset);
+    }
+
+    int64_t request_start = esp_timer_get_time();
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "Failed to open connection: %s", esp_err_to_name(err));
+        esp_http_client_close(client);
+        return err;
+    }
+
+    int content_length = esp_http_client_fetch_headers(client);
+    int status_code = esp_http_client_get_status_code(client);
+    metrics_record_time(METRIC_TIME_OTA_HEADERS, (esp_timer_get_time() - request_start) / 1000, 0);
+    ESP_LOGI(OTA_TAG, "Download response: status=%d, content_length=%d", status_code, content_length);
+
+    if (status_code == 200 && resuming) {
+        // If-Range did not match: the server has a different build now
+        ESP_LOGW(OTA_TAG, "Image changed on server, restarting download from zero");
+        clear_ota_resume_state();
+        resuming = false;
+        memset(&resume, 0, sizeof(resume));
+    } else if (status_code == 503) {
+        // All download slots taken - Retry-After says when to come back
+        ota_session_drain(client);
+        return ESP_ERR_NOT_FINISHED;
+    } else if (status_code != 200 && !(status_code == 206 && resuming)) {
+        // Drain the error body so a fallback request can reuse the connection
+        ota_session_drain(client);
+        return (status_code == 404) ? ESP_ERR_NOT_FOUND : ESP_ERR_INVALID_RESPONSE;
+    }
+
+    if (!resuming) {
+        if (s_response_etag[0] == '\0') {
+            ESP_LOGW(OTA_TAG, "Server sent no ETag - download cannot be resumed");
+        }
+        strncpy(resume.etag, s_response_etag, sizeof(resume.etag) - 1);
+        resume.compressed = compressed;
+        resume.partition_address = update_partition->address;
+    }
+
+    // Pre-erase needs the decompressed size: Content-Length of a full raw
+    // download, X-Image-Size for the compressed image
+    uint32_t image_size = compressed ? s_response_image_size : (content_length > 0 ? content_length : 0);
+    if (manifest != NULL && !resuming) {
+        if (image_size == 0) {
+            image_size = ota_manifest_image_size(manifest);
+        } else if (image_size != ota_manifest_image_size(manifest)) {
+            // Most likely a build was published between the two requests
+            ESP_LOGE(OTA_TAG, "✗ Offered image is %lu bytes, manifest says %lu",
+                     (unsigned long)image_size, (unsigned long)ota_manifest_image_size(manifest));
+            esp_http_client_close(client);
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+    ota_download_t dl = {
+        .partition = update_partition,
+        .compressed = compressed,
+        .resuming = resuming,
+        .manifest = manifest,
+        .erase_size = (!resuming && image_size > 0 && image_size <= update_partition->size)
+                      ? image_size : OTA_WITH_SEQUENTIAL_WRITES,
+        .resume = resume,
+        .saved_offset = resume.image_offset,
+    };
+
+    ESP_LOGI(OTA_TAG, "Writing to partition: %s (offset 0x%lx)%s",
+             update_partition->label, (unsigned long)update_partition->address,
+             dl.erase_size != OTA_WITH_SEQUENTIAL_WRITES ? ", pre-erasing" : "");
+
+    ota_writer_t *writer = NULL;
+    int total_read = 0;
+
+    if (compressed) {
+        err = ota_image_decoder_create(ota_flash_write_cb, &dl, &dl.decoder);
+        if (err == ESP_OK && resuming) {
+            err = ota_image_decoder_resume(dl.decoder, &dl.resume.checkpoint);
+        }
+        if (err != ESP_OK) {
+            clear_ota_resume_state();
+            goto cleanup;
+        }
+    }
+
+    const ota_writer_config_t writer_config = {
+        .block_size = OTA_BLOCK_SIZE,
+        .block_count = OTA_WRITE_BLOCKS,
+        .begin = ota_download_begin,
+        .sink = ota_download_write,
+        .ctx = &dl,
+    };
+    err = ota_writer_start(&writer_config, &writer);
+    if (err != ESP_OK) {
+        goto cleanup;
+    }
+
+    ESP_LOGI(OTA_TAG, "Downloading and flashing firmware...");
+
+#if IBEACON_MODE == IBEACON_RECEIVER
+    const uint32_t coex_kbps = 0;   // Nothing on air to protect
+#else
+    const uint32_t coex_kbps = beacon_adv_is_active() ? OTA_COEX_MAX_KBPS : 0;
+#endif
+    int64_t transfer_start = esp_timer_get_time();
+    uint32_t paced_ms = 0;
+    while (1) {
+        uint8_t *block = ota_writer_acquire(writer);
+        if (block == NULL) {
+            break;  // Writer failed - ota_writer_finish() returns why
+        }
+
+        int read_len = http_read_block(client, block, OTA_BLOCK_SIZE);
+        if (read_len <= 0) {
+            ota_writer_submit(writer, block, 0);
+            if (read_len < 0) {
+                ESP_LOGE(OTA_TAG, "✗ Read error during download");
+                err = ESP_FAIL;
+            } else if (!esp_http_client_is_complete_data_received(client)) {
+                ESP_LOGE(OTA_TAG, "✗ Connection closed after %d bytes", total_read);
+                err = ESP_FAIL;
+            }
+            break;
+        }
+
+        ota_writer_submit(writer, block, read_len);
+        total_read += read_len;
+
+        if (coex_kbps > 0) {
+            // Sleep off whatever got ahead of the rate
+            int64_t due_us = transfer_start + (int64_t)total_read * 1000000 / (coex_kbps * 1024);
+            int64_t ahead_us = due_us - esp_timer_get_time();
+            if (ahead_us >= 1000 * portTICK_PERIOD_MS) {
+                vTaskDelay(pdMS_TO_TICKS(ahead_us / 1000));
+                paced_ms += ahead_us / 1000;
+            }
+        }
+    }
+
+    // Let the writer catch up before looking at the result
+    esp_err_t write_err = ota_writer_finish(writer);
+    if (err == ESP_OK) {
+        err = write_err;
+    }
+
+    if (total_read > 0) {
+        // Time and rate of the link itself; the pacing sleeps are logged apart
+        uint32_t elapsed_ms = (esp_timer_get_time() - transfer_start) / 1000;
+        uint32_t transfer_ms = elapsed_ms > paced_ms ? elapsed_ms - paced_ms : 0;
+        ota_writer_stats_t writer_stats;
+        ota_writer_get_stats(writer, &writer_stats);
+        metrics_record_time(METRIC_TIME_OTA_TRANSFER, transfer_ms, total_read);
+        ESP_LOGI(OTA_TAG, "Transfer: %d bytes in %lu ms (%lu KB/s, plus %lu ms paced for BLE)", total_read,
+                 (unsigned long)transfer_ms, (unsigned long)(transfer_ms > 0 ? total_read / transfer_ms : 0),
+                 (unsigned long)paced_ms);
+        ESP_LOGI(OTA_TAG, "Writer: pre-erase %lu ms, flash %lu ms, network waited %lu ms for flash",
+                 (unsigned long)writer_stats.begin_ms, (unsigned long)writer_stats.sink_ms,
+                 (unsigned long)writer_stats.stall_ms);
+    }
+
+    if (err == ESP_OK && compressed) {
+        err = ota_image_decoder_finish(dl.decoder);
+    }
+
+    if (err == ESP_OK && manifest != NULL) {
+        err = ota_manifest_finish(manifest);
+    }
+
+    if (err == ESP_OK) {
+        ESP_LOGI(OTA_TAG, "Downloaded %d bytes%s", total_read, compressed ? " (compressed)" : "");
+        err = esp_ota_end(dl.update_handle);
+        dl.update_handle = 0;
+        // Either way this image is finished with - a corrupt one must not be resumed
+        clear_ota_resume_state();
+        if (err != ESP_OK) {
+            ESP_LOGE(OTA_TAG, "✗ Image validation failed: %s", esp_err_to_name(err));
+        }
+    }
+
+    if (err == ESP_OK) {
+        err = esp_ota_set_boot_partition(update_partition);
+        if (err != ESP_OK) {
+            ESP_LOGE(OTA_TAG, "✗ Failed to set boot partition: %s", esp_err_to_name(err));
+        }
+    }
+
+cleanup:
+    // Writer first - it may still hold the update handle
+    ota_writer_destroy(writer);
+    if (dl.update_handle != 0) {
+        esp_ota_abort(dl.update_handle);
+    }
+    ota_image_decoder_destroy(dl.decoder);
+    if (err == ESP_OK) {
+        ota_session_drain(client);
+    } else {
+        esp_http_client_close(client);
+    }
+    return err;
+}
+
+/**
+ * Block until the server announces a new build (long-poll)
+ *
+ * The server answers as soon as its version ETag differs from ours, either
+ * because a build finished while we waited or because we are already behind.
+ * A 503 means the build exists but our rollout wave opens later.
+ * Returns: 1 when notified, 0 on long-poll timeout, -1 on error
+ */
+static int wait_for_update_notification(void)
+{
+    char url[128];
+    snprintf(url, sizeof(url), "%s?timeout=%d", OTA_VERSION_WAIT_URL, OTA_LONG_POLL_SEC);
+
+    esp_http_client_config_t config = {
+        .url = url,
+        .timeout_ms = (OTA_LONG_POLL_SEC + 30) * 1000,
+        .method = HTTP_METHOD_GET,
+        // Sparse TCP keep-alive probes keep NAT state without waking the radio often
+        .keep_alive_enable = true,
+        .keep_alive_idle = 120,
+        .keep_alive_interval = 30,
+        .keep_alive_count = 3,
+        .event_handler = ota_http_event_handler,
+        .user_data = &s_ota_wait_tls_stats,
+    };
+    tls_profile_apply(&config);
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        ESP_LOGE(OTA_TAG, "Failed to initialize HTTP client");
+        return -1;
+    }
+    esp_http_client_set_header(client, "If-None-Match", s_version_etag);
+    ota_set_device_headers(client);
+
+    int result = -1;
+    tls_profile_request_begin(&s_ota_wait_tls_stats);
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        ESP_LOGW(OTA_TAG, "Long-poll connect failed: %s", esp_err_to_name(err));
+        goto cleanup;
+    }
+
+    esp_http_client_fetch_headers(client);
+    int status_code = esp_http_client_get_status_code(client);
+    if (status_code == 200 || status_code == 503) {
+        ESP_LOGI(OTA_TAG, "🔔 Server announced a new build");
+        result = 1;
+    } else if (status_code == 304) {
+        ESP_LOGI(OTA_TAG, "Long-poll expired, no new build");
+        result = 0;
+    } else {
+        ESP_LOGW(OTA_TAG, "Long-poll returned status: %d", status_code);
+    }
+
+cleanup:
+    tls_profile_request_end(&s_ota_wait_tls_stats);
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return result;
+}
+
 /**
  * Perform OTA update
+ *
+ * The version check and the download share one keep-alive connection.
  */
 static void perform_ota_update(void)
 {
-    // Step 1: Quick check using HEAD request
+    if (ota_selftest_pending()) {
+        // esp_ota_begin() is refused until the running image is confirmed
+        ESP_LOGW(OTA_TAG, "⚠️  Self-test still running, skipping update check");
+        return;
+    }
+
+    esp_http_client_config_t config = {
+        .url = OTA_VERSION_CHECK_URL,
+        .timeout_ms = 10000,
+        .method = HTTP_METHOD_GET,
+        .keep_alive_enable = true,
+        .buffer_size = OTA_HTTP_BUFFER_SIZE,
+        .event_handler = ota_http_event_handler,
+        .user_data = &s_ota_tls_stats,
+    };
+    tls_profile_apply(&config);
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        ESP_LOGE(OTA_TAG, "Failed to initialize HTTP client");
+        send_ota_error_webhook("Failed to initialize HTTP client");
+        return;
+    }
+
+    // Step 1: Quick check using a conditional GET
     char new_version[32] = {0};
     bool force_update = false;
-    int check_result = check_ota_available(new_version, sizeof(new_version), &force_update);
+    int64_t check_start = esp_timer_get_time();
+    int check_result = check_ota_available(client, new_version, sizeof(new_version), &force_update);
+    metrics_count(METRIC_OTA_CHECKS);
+    metrics_record_time(METRIC_TIME_VERSION_CHECK, (esp_timer_get_time() - check_start) / 1000, 0);
 
     if (check_result < 0) {
         ESP_LOGE(OTA_TAG, "Failed to check for updates");
+        tls_profile_request_end(&s_ota_tls_stats);
+        esp_http_client_cleanup(client);
         send_ota_error_webhook("Failed to check for updates");
         return;
     }
 
+    if (check_result == 2) {
+        // Not our turn yet - ota_task waits out the Retry-After
+        tls_profile_request_end(&s_ota_tls_stats);
+        esp_http_client_cleanup(client);
+        return;
+    }
+
     if (check_result == 0 && !force_update) {
-        // No update needed
+        // No update needed - a partial download of an older offer is stale
+        tls_profile_request_end(&s_ota_tls_stats);
+        esp_http_client_cleanup(client);
+        clear_ota_resume_state();
         send_ota_success_webhook("Already on latest firmware - no update needed");
         return;
     }
@@ -891,87 +2021,289 @@ static void perform_ota_update(void)
         ESP_LOGW(OTA_TAG, "🔥 FORCED UPDATE MODE - bypassing version check");
     }
 
-    // Step 2: Download and install firmware
-    ESP_LOGI(OTA_TAG, "Downloading firmware from: %s", OTA_DOWNLOAD_URL);
-
-    esp_http_client_config_t config = {
-        .url = OTA_DOWNLOAD_URL,
-        .timeout_ms = 30000,
-        .keep_alive_enable = true,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-    };
-
-    esp_https_ota_config_t ota_config = {
-        .http_config = &config,
-    };
-
-    esp_https_ota_handle_t ota_handle = NULL;
-    esp_err_t ret = esp_https_ota_begin(&ota_config, &ota_handle);
-
-    if (ret != ESP_OK) {
-        ESP_LOGE(OTA_TAG, "✗ OTA begin failed: %s", esp_err_to_name(ret));
-        blink_led_ota_error();
-        send_ota_error_webhook(esp_err_to_name(ret));
-        return;
+    // Step 2: Signed manifest of the offered build
+    ota_manifest_t *manifest = NULL;
+    esp_err_t ret = fetch_ota_manifest(client, &manifest);
+#if OTA_MANIFEST_PUBKEY
+    if (ret == ESP_ERR_NOT_FOUND) {
+        ESP_LOGE(OTA_TAG, "✗ Server publishes no manifest - refusing unsigned image");
     }
-
-    ESP_LOGI(OTA_TAG, "Downloading and flashing firmware...");
-
-    // Download and flash the new firmware
-    while (1) {
-        ret = esp_https_ota_perform(ota_handle);
-        if (ret != ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
-            break;
-        }
+#else
+    if (ret == ESP_ERR_NOT_FOUND) {
+        // No key built in, so images without a manifest are still accepted
+        ESP_LOGW(OTA_TAG, "⚠️  Server publishes no manifest - image checked only after download");
+        ret = ESP_OK;
+    }
+#endif
+    if (manifest != NULL && new_version[0] != '\0' && strcmp(ota_manifest_version(manifest), new_version) != 0) {
+        ESP_LOGE(OTA_TAG, "✗ Manifest is for %s, server offered %s", ota_manifest_version(manifest), new_version);
+        ret = ESP_ERR_INVALID_VERSION;
     }
 
-    if (ret != ESP_OK) {
-        ESP_LOGE(OTA_TAG, "✗ OTA download failed: %s", esp_err_to_name(ret));
-        esp_https_ota_abort(ota_handle);
-        blink_led_ota_error();
-        send_ota_error_webhook(esp_err_to_name(ret));
-        return;
+    // Step 3: Download and install firmware over the same connection
+    if (ret == ESP_OK) {
+        ret = download_and_flash_image(client, OTA_COMPRESSED_DOWNLOAD_URL, true, manifest);
+        if (ret == ESP_ERR_NOT_FOUND) {
+            ESP_LOGW(OTA_TAG, "No compressed image on server, downloading raw binary");
+            ret = download_and_flash_image(client, OTA_DOWNLOAD_URL, false, manifest);
+        }
     }
+    ota_manifest_destroy(manifest);
+    tls_profile_request_end(&s_ota_tls_stats);
+    esp_http_client_cleanup(client);
 
-    // Finish OTA update
-    ret = esp_https_ota_finish(ota_handle);
     if (ret == ESP_OK) {
         ESP_LOGI(OTA_TAG, "✓ OTA update successful! Rebooting...");
         send_ota_success_webhook("Firmware updated successfully - rebooting");
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+        telemetry_flush(10000);
         esp_restart();
+    } else if (ret == ESP_ERR_NOT_FINISHED) {
+        ESP_LOGW(OTA_TAG, "⚠️  OTA server busy, download postponed");
     } else {
-        ESP_LOGE(OTA_TAG, "✗ OTA finish failed: %s", esp_err_to_name(ret));
+        ESP_LOGE(OTA_TAG, "✗ OTA update failed: %s", esp_err_to_name(ret));
+        metrics_count(METRIC_OTA_FAILURES);
         blink_led_ota_error();
         send_ota_error_webhook(esp_err_to_name(ret));
     }
 }
 
+/**
+ * Run one OTA check, timing it and sending metrics now and then
+ */
+static void ota_check_and_report(void)
+{
+    static int64_t s_last_metrics_us = -1;
+
+    ESP_LOGI(OTA_TAG, "Checking for firmware updates...");
+    int64_t start = esp_timer_get_time();
+    perform_ota_update();
+    int64_t now = esp_timer_get_time();
+    metrics_record_time(METRIC_TIME_OTA_SESSION, (now - start) / 1000, 0);
+
+    if (s_last_metrics_us < 0 || now - s_last_metrics_us >= (int64_t)METRICS_POST_INTERVAL_SEC * 1000000) {
+        metrics_post_telemetry();
+        s_last_metrics_us = now;
+    }
+}
+
 /**
  * OTA task - periodically checks for updates
  */
 static void ota_task(void *pvParameter)
 {
     ESP_LOGI(OTA_TAG, "OTA task started");
-    ESP_LOGI(OTA_TAG, "Will check for updates every %d seconds", OTA_CHECK_INTERVAL_SEC);
+    ESP_LOGI(OTA_TAG, "Waiting for build notifications (fallback: check every %d seconds)", OTA_CHECK_INTERVAL_SEC);
+
+    // Wait for WiFi to connect first (boot continues in network_task)
+    xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+                        pdFALSE, pdFALSE, 60000 / portTICK_PERIOD_MS);
+
+#if LOW_POWER_MODE
+    // Maintenance windows: Wi-Fi is up only for an OTA check and to
+    // deliver queued telemetry, then switched off until the next window
+    while (1) {
+        if (xEventGroupGetBits(s_wifi_event_group) & WIFI_CONNECTED_BIT) {
+            ota_check_and_report();
+            telemetry_flush(30000);
+        }
+        power_mgr_log_report(POWER_REPORT_BATTERY_MAH);
+        wifi_power_down();
+
+        uint32_t sleep_sec = MAINTENANCE_INTERVAL_SEC;
+        if (s_retry_after_sec > 0 && (uint32_t)s_retry_after_sec < sleep_sec) {
+            sleep_sec = s_retry_after_sec;
+        } else if (ota_resume_pending() && OTA_RESUME_RETRY_SEC < sleep_sec) {
+            sleep_sec = OTA_RESUME_RETRY_SEC;
+        }
+        s_retry_after_sec = 0;
+        ESP_LOGI(OTA_TAG, "Next maintenance window in %lu seconds", (unsigned long)sleep_sec);
+        vTaskDelay(((TickType_t)sleep_sec * 1000) / portTICK_PERIOD_MS);
 
-    // Wait for WiFi to connect first
-    vTaskDelay(10000 / portTICK_PERIOD_MS);
+        wifi_power_up();
+    }
+#endif
 
     while (1) {
-        ESP_LOGI(OTA_TAG, "Checking for firmware updates...");
-        perform_ota_update();
+        ota_check_and_report();
+
+        // Rollout wave not open or download slots full
+        if (ota_honor_retry_after()) {
+            continue;
+        }
+
+        // Retry sooner if a download was interrupted
+        if (ota_resume_pending()) {
+            ESP_LOGI(OTA_TAG, "Partial download saved, resuming in %d seconds", OTA_RESUME_RETRY_SEC);
+            vTaskDelay((OTA_RESUME_RETRY_SEC * 1000) / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        // Without a version ETag the server would answer the long-poll at
+        // once - fall back to the fixed interval until a check succeeds
+        if (s_version_etag[0] == '\0') {
+            vTaskDelay((OTA_CHECK_INTERVAL_SEC * 1000) / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        // Block on the server until it publishes a build
+        int notified;
+        do {
+            notified = wait_for_update_notification();
+        } while (notified == 0);
+
+        if (ota_honor_retry_after()) {
+            continue;
+        } else if (notified < 0) {
+            vTaskDelay((OTA_CHECK_INTERVAL_SEC * 1000) / portTICK_PERIOD_MS);
+        } else {
+            uint32_t jitter_ms = esp_random() % (OTA_NOTIFY_JITTER_SEC * 1000);
+            vTaskDelay(jitter_ms / portTICK_PERIOD_MS);
+        }
+    }
+}
+#endif
+
+/**
+ * METRICS serial command
+ */
+static void cmd_metrics(const char *args)
+{
+    metrics_print();
+}
+
+/**
+ * Change the beacon identity at runtime: persist it, then swap the
+ * advertised payload - Bluetooth, Wi-Fi and the OTA task keep running
+ */
+static esp_err_t set_beacon_identity(uint16_t major, uint16_t minor, const uint8_t *uuid)
+{
+    esp_err_t err = save_beacon_config_to_nvs(major, minor, uuid);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    beacon_adv_identity_t identity = {
+        .major = g_beacon_major,
+        .minor = g_beacon_minor,
+        .measured_power = BEACON_MEASURED_POWER,
+    };
+    memcpy(identity.uuid, g_beacon_uuid, sizeof(identity.uuid));
+#if IBEACON_MODE == IBEACON_RECEIVER
+    // Not advertising; the identity only labels the reports
+    beacon_scan_set_device(g_beacon_major, g_beacon_minor);
+#else
+    err = beacon_adv_set_identity(0, &identity);
+#endif
+
+    telemetry_set_device(g_beacon_major, g_beacon_minor);
+    return err;
+}
+
+/**
+ * CONFIG prints the identity; CONFIG:<major>:<minor>[:<uuid>] changes it
+ * without a reboot. Replies CONFIG_OK or CONFIG_ERROR for flash_beacon.py.
+ */
+static void cmd_config(const char *args)
+{
+    if (args[0] != '\0') {
+        uint8_t uuid[16];
+        memcpy(uuid, g_beacon_uuid, sizeof(uuid));
+
+        char *end;
+        unsigned long major = strtoul(args, &end, 10);
+        bool valid = end != args && *end == ':' && major <= UINT16_MAX;
+        unsigned long minor = 0;
+        if (valid) {
+            const char *minor_str = end + 1;
+            minor = strtoul(minor_str, &end, 10);
+            valid = end != minor_str && (*end == '\0' || *end == ':') && minor <= UINT16_MAX;
+        }
+        if (valid && *end == ':') {
+            valid = parse_uuid_string(end + 1, uuid);
+        }
+        if (!valid) {
+            printf("CONFIG_ERROR usage: CONFIG:<major>:<minor>[:<uuid>]\n");
+            return;
+        }
+
+        esp_err_t err = set_beacon_identity(major, minor, uuid);
+        if (err != ESP_OK) {
+            printf("CONFIG_ERROR %s\n", esp_err_to_name(err));
+            return;
+        }
+    }
 
-        // Wait before next check
-        vTaskDelay((OTA_CHECK_INTERVAL_SEC * 1000) / portTICK_PERIOD_MS);
+    char uuid_str[37];
+    format_uuid_string(g_beacon_uuid, uuid_str);
+    printf("CONFIG_OK major=%u minor=%u uuid=%s\n", g_beacon_major, g_beacon_minor, uuid_str);
+}
+
+#if CONFIG_BEACON_WIFI
+/**
+ * WIFI prints the connection state; WIFI:drop disconnects from the AP so
+ * host tools can time the recovery (hil_bench.py). Replies WIFI_OK or
+ * WIFI_ERROR.
+ */
+static void cmd_wifi(const char *args)
+{
+    if (strcasecmp(args, "drop") == 0) {
+        if (s_wifi_powered_down) {
+            printf("WIFI_ERROR powered down\n");
+            return;
+        }
+        esp_err_t err = esp_wifi_disconnect();
+        if (err != ESP_OK) {
+            printf("WIFI_ERROR %s\n", esp_err_to_name(err));
+            return;
+        }
+        ESP_LOGW(WIFI_TAG, "⚠️  Disconnected on request, reconnecting");
+        printf("WIFI_OK dropped\n");
+        return;
+    }
+    if (args[0] != '\0') {
+        printf("WIFI_ERROR usage: WIFI[:drop]\n");
+        return;
+    }
+
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        printf("WIFI_OK connected=1 channel=%d rssi=%d\n", ap.primary, ap.rssi);
+    } else {
+        printf("WIFI_OK connected=0\n");
     }
 }
+#endif
+
+// Boot banner
+#if CONFIG_BEACON_PROFILE_GATEWAY
+#define BUILD_PROFILE_NAME "gateway"
+#elif CONFIG_BEACON_PROFILE_BEACON_ONLY
+#define BUILD_PROFILE_NAME "beacon-only"
+#else
+#define BUILD_PROFILE_NAME "full"
+#endif
+#if CONFIG_BEACON_TELEMETRY
+#define TELEMETRY_STATE "ENABLED"
+#else
+#define TELEMETRY_STATE "DISABLED"
+#endif
+#if CONFIG_BEACON_OTA
+#define OTA_STATE "ENABLED"
+#else
+#define OTA_STATE "DISABLED"
+#endif
 
 /**
  * Main application entry point
  */
 void app_main(void)
 {
+    boot_timeline_mark(BOOT_STAGE_APP_START);
+
+    // Hand Classic Bluetooth's memory to the heap before anything allocates
+    // (only BLE is used); the controller must not be initialized yet
+    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+
     // Get firmware version from app descriptor
     const esp_app_desc_t *app_desc = esp_app_get_description();
 
@@ -994,82 +2326,116 @@ void app_main(void)
     gpio_set_level(LED_GPIO, 0);  // LED off initially
     ESP_LOGI(TAG, "✓ LED initialized on GPIO %d", LED_GPIO);
 
-    // Initialize Non-Volatile Storage (required for Bluetooth and WiFi)
-    // First, try to backup beacon config before any potential NVS erase
-    uint16_t backup_major = DEFAULT_BEACON_MAJOR;
-    uint16_t backup_minor = DEFAULT_BEACON_MINOR;
-    bool had_backup = false;
-
+    // Initialize Non-Volatile Storage (required for Bluetooth and WiFi).
+    // A partition NVS cannot mount cannot be read either, so there is
+    // nothing to back up: the beacon starts over with its defaults and has
+    // to be provisioned again.
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        // NVS needs to be erased - try to backup beacon config first
-        ESP_LOGW(NVS_TAG, "NVS migration required, attempting to backup beacon config...");
-
-        // Try to read existing values before erasing
-        nvs_handle_t backup_handle;
-        if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &backup_handle) == ESP_OK) {
-            if (nvs_get_u16(backup_handle, NVS_KEY_MAJOR, &backup_major) == ESP_OK &&
-                nvs_get_u16(backup_handle, NVS_KEY_MINOR, &backup_minor) == ESP_OK) {
-                had_backup = true;
-                ESP_LOGI(NVS_TAG, "✓ Backed up beacon config: Major=%d, Minor=%d", backup_major, backup_minor);
-            }
-            nvs_close(backup_handle);
-        }
-
-        ESP_LOGW(NVS_TAG, "Erasing NVS...");
+        ESP_LOGW(NVS_TAG, "⚠️  NVS unreadable (%s), erasing it: beacon config reset to defaults", esp_err_to_name(ret));
         ESP_ERROR_CHECK(nvs_flash_erase());
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
 
-    // Load beacon configuration from NVS
-    bool config_loaded = load_beacon_config_from_nvs();
+    // Put a freshly installed image on trial (and report a rollback)
+    ota_selftest_start(OTA_SELFTEST_TIMEOUT_SEC * 1000);
 
-    if (!config_loaded) {
-        if (had_backup) {
-            // NVS was erased but we have a backup - restore it
-            ESP_LOGI(NVS_TAG, "Restoring beacon config from backup");
-            g_beacon_major = backup_major;
-            g_beacon_minor = backup_minor;
-            save_beacon_config_to_nvs(g_beacon_major, g_beacon_minor);
-        } else {
-            // First boot: save the DEFAULT values from this firmware to NVS
-            ESP_LOGI(NVS_TAG, "First boot detected, saving configuration to NVS");
-            save_beacon_config_to_nvs(g_beacon_major, g_beacon_minor);
-        }
-    }
+    // Load beacon configuration from NVS (first boot: stores the defaults)
+    bool config_loaded = load_beacon_config_from_nvs();
 
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "** BEACON CONFIGURATION **");
-    ESP_LOGI(TAG, "UUID:     %s", BEACON_UUID_STRING);
+    char uuid_str[37];
+    format_uuid_string(g_beacon_uuid, uuid_str);
+    ESP_LOGI(TAG, "UUID:     %s", uuid_str);
     ESP_LOGI(TAG, "MAJOR:    %d %s", g_beacon_major, config_loaded ? "(from NVS)" : "(default)");
     ESP_LOGI(TAG, "MINOR:    %d %s", g_beacon_minor, config_loaded ? "(from NVS)" : "(default)");
+    ESP_LOGI(TAG, "Power:    %d dBm at 1 m (measured power)", BEACON_MEASURED_POWER);
     ESP_LOGI(TAG, "Interval: %dms (50ms = 20 broadcasts/sec)", ADVERTISING_INTERVAL_MS);
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "");
+    boot_timeline_mark(BOOT_STAGE_CONFIG_LOADED);
 
-    // Initialize WiFi
-    ESP_LOGI(TAG, "Initializing WiFi...");
-    wifi_init_sta();
+    // Power management before the radios come up
+    const float nominal_ma[POWER_STATE_COUNT] = {
+        [POWER_STATE_ADVERTISING] = POWER_NOMINAL_ADV_MA,
+        [POWER_STATE_WIFI]        = POWER_NOMINAL_WIFI_MA,
+    };
+    power_mgr_init(LOW_POWER_MODE, nominal_ma);
 
-    // Release Classic Bluetooth memory (we only need BLE)
-    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+    // Boot fast path: advertise from the NVS config first, everything
+    // that needs the network comes up afterwards in the background
 
-    // Initialize Bluetooth controller
+#if CONFIG_BT_BLUEDROID_ENABLED
+    // Initialize Bluetooth controller (nimble_port_init() does this itself)
     esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_bt_controller_init(&bt_cfg));
     ESP_ERROR_CHECK(esp_bt_controller_enable(ESP_BT_MODE_BLE));
+#endif
 
     // Initialize Bluetooth stack and start beacon
     bluetooth_init();
+    boot_timeline_mark(BOOT_STAGE_BT_READY);
+#if IBEACON_MODE == IBEACON_RECEIVER
+    start_gateway();
+#elif CONFIG_BT_BLUEDROID_ENABLED
     start_ibeacon();
+#if ADV_PROFILES_ENABLED
+    start_adv_profiles();
+#endif
+#endif
+
+#if CONFIG_BEACON_WIFI
+    tls_profile_init();
+#endif
+#if CONFIG_BEACON_TELEMETRY
+    // Events queue up until WiFi connects
+    start_telemetry();
+#endif
+
+#if CONFIG_BEACON_WIFI
+    // WiFi, SNTP and the online event
+    s_wifi_event_group = xEventGroupCreate();
+    xTaskCreate(&network_task, "network", 4096, NULL, 4, NULL);
+#endif
 
+#if CONFIG_BEACON_OTA
     // Start OTA update task
     xTaskCreate(&ota_task, "ota_task", 8192, NULL, 5, NULL);
     ESP_LOGI(OTA_TAG, "✓ OTA task created");
+#endif
+
+    // Metrics, readable with the METRICS serial command
+    metrics_track_task("serial_cmd");
+#if ADV_PROFILES_ENABLED && IBEACON_MODE == IBEACON_SENDER
+    metrics_track_task("adv_profile");
+#endif
+#if CONFIG_BEACON_WIFI
+    metrics_track_task("wifi_link");
+#endif
+#if CONFIG_BEACON_OTA
+    metrics_track_task("ota_task");
+    metrics_track_connection(&s_ota_tls_stats);
+    metrics_track_connection(&s_ota_wait_tls_stats);
+#endif
+#if CONFIG_BEACON_TELEMETRY
+    metrics_track_task("telemetry");
+    metrics_track_connection(telemetry_tls_stats());
+#endif
+#if IBEACON_MODE == IBEACON_RECEIVER
+    metrics_track_task("gateway");
+    metrics_track_connection(beacon_scan_tls_stats());
+#endif
+    serial_cmd_register("METRICS", cmd_metrics);
+    serial_cmd_register("CONFIG", cmd_config);
+#if CONFIG_BEACON_WIFI
+    serial_cmd_register("WIFI", cmd_wifi);
+#endif
+    serial_cmd_start();
 
     ESP_LOGI(TAG, "========================================");
-    ESP_LOGI(TAG, "Setup complete! iBeacon is broadcasting.");
-    ESP_LOGI(TAG, "Webhook: ENABLED | OTA: ENABLED");
+    ESP_LOGI(TAG, "Setup complete! iBeacon is starting, network comes up in the background.");
+    ESP_LOGI(TAG, "Profile: %s | Telemetry: %s | OTA: %s", BUILD_PROFILE_NAME, TELEMETRY_STATE, OTA_STATE);
     ESP_LOGI(TAG, "========================================");
 }
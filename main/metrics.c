@@ -0,0 +1,197 @@
+/**
+ * Runtime Metrics Implementation
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_app_desc.h"
+#include "esp_mac.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "boot_timeline.h"
+#include "beacon_adv.h"
+#include "telemetry.h"
+#include "metrics.h"
+
+static const char *s_counter_names[METRIC_COUNTER_COUNT] = {
+    [METRIC_WIFI_RETRIES]     = "wifi_retries",
+    [METRIC_WIFI_DISCONNECTS] = "wifi_disconnects",
+    [METRIC_OTA_CHECKS]       = "ota_checks",
+    [METRIC_OTA_FAILURES]     = "ota_failures",
+};
+
+static const char *s_timing_names[METRIC_TIMING_COUNT] = {
+    [METRIC_TIME_VERSION_CHECK]  = "version_check",
+    [METRIC_TIME_OTA_HEADERS]    = "ota_headers",
+    [METRIC_TIME_OTA_TRANSFER]   = "ota_transfer",
+    [METRIC_TIME_OTA_SESSION]    = "ota_session",
+    [METRIC_TIME_ADV_OFF]        = "adv_off",
+    [METRIC_TIME_WIFI_RECONNECT] = "wifi_reconnect",
+};
+
+typedef struct {
+    uint32_t count;
+    uint32_t last_ms;
+    uint32_t max_ms;
+    uint64_t total_ms;
+    uint64_t total_bytes;
+    uint32_t last_kbps;
+} metric_timing_stats_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_counters[METRIC_COUNTER_COUNT];
+static metric_timing_stats_t s_timings[METRIC_TIMING_COUNT];
+
+static const char *s_tasks[METRICS_MAX_TASKS];
+static int s_task_count;
+static const tls_profile_stats_t *s_connections[METRICS_MAX_CONNECTIONS];
+static int s_connection_count;
+
+void metrics_count(metric_counter_t counter)
+{
+    if (counter >= METRIC_COUNTER_COUNT) {
+        return;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    s_counters[counter]++;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void metrics_record_time(metric_timing_t timing, uint32_t ms, size_t bytes)
+{
+    if (timing >= METRIC_TIMING_COUNT) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    metric_timing_stats_t *stats = &s_timings[timing];
+    stats->count++;
+    stats->last_ms = ms;
+    if (ms > stats->max_ms) {
+        stats->max_ms = ms;
+    }
+    stats->total_ms += ms;
+    stats->total_bytes += bytes;
+    if (bytes > 0 && ms > 0) {
+        // bytes per ms is KB/s (1 KB = 1000 bytes)
+        stats->last_kbps = bytes / ms;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void metrics_track_task(const char *name)
+{
+    if (s_task_count < METRICS_MAX_TASKS) {
+        s_tasks[s_task_count++] = name;
+    }
+}
+
+void metrics_track_connection(const tls_profile_stats_t *stats)
+{
+    if (s_connection_count < METRICS_MAX_CONNECTIONS) {
+        s_connections[s_connection_count++] = stats;
+    }
+}
+
+/**
+ * Free stack of a tracked task in bytes, -1 if it is not running
+ */
+static int32_t task_stack_free(const char *name)
+{
+    TaskHandle_t task = xTaskGetHandle(name);
+    if (task == NULL) {
+        return -1;
+    }
+    // ESP-IDF reports the high water mark in bytes
+    return (int32_t)uxTaskGetStackHighWaterMark(task);
+}
+
+void metrics_print(void)
+{
+    uint32_t counters[METRIC_COUNTER_COUNT];
+    metric_timing_stats_t timings[METRIC_TIMING_COUNT];
+    taskENTER_CRITICAL(&s_lock);
+    memcpy(counters, s_counters, sizeof(counters));
+    memcpy(timings, s_timings, sizeof(timings));
+    taskEXIT_CRITICAL(&s_lock);
+
+    printf("METRICS_BEGIN\n");
+    printf("firmware=%s\n", esp_app_get_description()->version);
+    printf("uptime_ms=%lld\n", esp_timer_get_time() / 1000);
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    printf("mac=%02X:%02X:%02X:%02X:%02X:%02X\n", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    printf("heap.free=%lu\n", (unsigned long)esp_get_free_heap_size());
+    printf("heap.min=%lu\n", (unsigned long)esp_get_minimum_free_heap_size());
+    printf("heap.largest_block=%u\n", (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+
+    for (int i = 0; i < s_task_count; i++) {
+        printf("stack_free.%s=%ld\n", s_tasks[i], (long)task_stack_free(s_tasks[i]));
+    }
+
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        printf("boot.%s_ms=%ld\n", boot_timeline_stage_name(i), (long)boot_timeline_get_ms(i));
+    }
+    int32_t bt_ready = boot_timeline_get_ms(BOOT_STAGE_BT_READY);
+    int32_t first_adv = boot_timeline_get_ms(BOOT_STAGE_FIRST_ADV);
+    printf("ble.adv_start_latency_ms=%ld\n",
+           (long)(bt_ready >= 0 && first_adv >= 0 ? first_adv - bt_ready : -1));
+    printf("ble.adv_interval_ms=%u\n", (unsigned)beacon_adv_get_interval_ms());
+
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        printf("counter.%s=%lu\n", s_counter_names[i], (unsigned long)counters[i]);
+    }
+
+    for (int i = 0; i < METRIC_TIMING_COUNT; i++) {
+        const metric_timing_stats_t *t = &timings[i];
+        printf("time.%s.count=%lu\n", s_timing_names[i], (unsigned long)t->count);
+        printf("time.%s.last_ms=%lu\n", s_timing_names[i], (unsigned long)t->last_ms);
+        printf("time.%s.max_ms=%lu\n", s_timing_names[i], (unsigned long)t->max_ms);
+        printf("time.%s.avg_ms=%lu\n", s_timing_names[i],
+               (unsigned long)(t->count > 0 ? t->total_ms / t->count : 0));
+        if (t->total_bytes > 0) {
+            printf("time.%s.bytes=%llu\n", s_timing_names[i], (unsigned long long)t->total_bytes);
+            printf("time.%s.last_kbps=%lu\n", s_timing_names[i], (unsigned long)t->last_kbps);
+        }
+    }
+
+    for (int i = 0; i < s_connection_count; i++) {
+        const tls_profile_stats_t *c = s_connections[i];
+        printf("conn.%s.connects=%lu\n", c->name, (unsigned long)c->connects);
+        printf("conn.%s.last_ms=%lu\n", c->name, (unsigned long)c->last_connect_ms);
+        printf("conn.%s.max_ms=%lu\n", c->name, (unsigned long)c->max_connect_ms);
+        printf("conn.%s.peak_heap=%u\n", c->name, (unsigned)c->peak_heap_bytes);
+        printf("conn.%s.min_stack_free=%ld\n", c->name,
+               (long)(c->connects > 0 ? (int32_t)c->min_stack_free : -1));
+    }
+    printf("METRICS_END\n");
+}
+
+void metrics_post_telemetry(void)
+{
+    char message[TELEMETRY_MESSAGE_LEN];
+    int len = snprintf(message, sizeof(message),
+                       "Heap free %lu / min %lu bytes\nFirst adv %ld ms, WiFi retries %lu\nOTA %lu KB/s, version check %lu ms",
+                       (unsigned long)esp_get_free_heap_size(),
+                       (unsigned long)esp_get_minimum_free_heap_size(),
+                       (long)boot_timeline_get_ms(BOOT_STAGE_FIRST_ADV),
+                       (unsigned long)s_counters[METRIC_WIFI_RETRIES],
+                       (unsigned long)s_timings[METRIC_TIME_OTA_TRANSFER].last_kbps,
+                       (unsigned long)s_timings[METRIC_TIME_VERSION_CHECK].last_ms);
+
+    for (int i = 0; i < s_task_count && len > 0 && (size_t)len < sizeof(message); i++) {
+        len += snprintf(message + len, sizeof(message) - len, "%s%s stack %ld",
+                        i == 0 ? "\nFree stack: " : ", ", s_tasks[i], (long)task_stack_free(s_tasks[i]));
+    }
+
+    telemetry_post(TELEMETRY_INFO, "📊 Metrics", message);
+}
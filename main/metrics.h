@@ -0,0 +1,69 @@
+/**
+ * Runtime Metrics
+ *
+ * Collects the numbers needed to compare firmware versions on the device:
+ * task stack high water marks, free and minimum heap, boot stages and BLE
+ * advertising start latency and interval, Wi-Fi retries and reconnect
+ * time, OTA request timings and throughput, and connection setup times of
+ * the HTTP clients.
+ *
+ * metrics_print() writes one key=value per line between METRICS_BEGIN and
+ * METRICS_END for host tools (serial command METRICS);
+ * metrics_post_telemetry() sends a one-line summary through telemetry.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "tls_profile.h"
+
+#define METRICS_MAX_TASKS        8
+#define METRICS_MAX_CONNECTIONS  4
+
+typedef enum {
+    METRIC_WIFI_RETRIES,        // Reconnect attempts after a disconnect
+    METRIC_WIFI_DISCONNECTS,
+    METRIC_OTA_CHECKS,
+    METRIC_OTA_FAILURES,
+    METRIC_COUNTER_COUNT
+} metric_counter_t;
+
+typedef enum {
+    METRIC_TIME_VERSION_CHECK,  // check_ota_available() round trip
+    METRIC_TIME_OTA_HEADERS,    // Download request until response headers
+    METRIC_TIME_OTA_TRANSFER,   // Download body; bytes give the throughput
+    METRIC_TIME_OTA_SESSION,    // Whole perform_ota_update()
+    METRIC_TIME_ADV_OFF,        // Advertising stopped until it was on air again
+    METRIC_TIME_WIFI_RECONNECT, // Connection lost until an IP address again
+    METRIC_TIMING_COUNT
+} metric_timing_t;
+
+void metrics_count(metric_counter_t counter);
+
+/**
+ * Record one duration; bytes is the payload moved in that time, or 0
+ */
+void metrics_record_time(metric_timing_t timing, uint32_t ms, size_t bytes);
+
+/**
+ * Report the stack high water mark of a task, looked up by name
+ */
+void metrics_track_task(const char *name);
+
+/**
+ * Report an HTTP client's connection stats (must stay valid)
+ */
+void metrics_track_connection(const tls_profile_stats_t *stats);
+
+/**
+ * Print all metrics to the console in key=value form
+ */
+void metrics_print(void);
+
+/**
+ * Queue a metrics summary as a telemetry event
+ */
+void metrics_post_telemetry(void);
@@ -0,0 +1,294 @@
+/**
+ * Compressed OTA Image Decoder Implementation
+ *
+ * Parses the chunked image framing and inflates each chunk with the
+ * miniz inflater from ROM into a wrapping 32 KB dictionary window.
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "miniz.h"
+#include "ota_image.h"
+
+static const char* TAG = "OTA-Image";
+
+typedef enum {
+    DECODER_STATE_HEADER,
+    DECODER_STATE_CHUNK_LEN,
+    DECODER_STATE_CHUNK_DATA,
+    DECODER_STATE_DONE,
+} decoder_state_t;
+
+struct ota_image_decoder {
+    decoder_state_t state;
+    ota_image_write_cb_t write_cb;
+    void *write_ctx;
+
+    // Small fields (header, chunk length) may arrive split across reads
+    uint8_t field_buf[OTA_IMAGE_HEADER_SIZE];
+    size_t field_len;
+
+    uint32_t chunk_size;
+    uint32_t image_size;
+    uint32_t chunk_index;
+    uint32_t chunk_in_left;     // Compressed bytes of the current chunk not yet inflated
+    uint32_t chunk_out;         // Bytes inflated from the current chunk
+    uint32_t total_out;
+    uint32_t total_in;          // Compressed bytes consumed, from the start of the file
+    ota_image_checkpoint_t checkpoint;
+
+    tinfl_decompressor inflator;
+    uint8_t *dict;
+    size_t dict_ofs;
+};
+
+static uint32_t read_u32_le(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * Collect a fixed-size field that may be split across several feeds.
+ * Returns true once field_buf holds 'size' bytes.
+ */
+static bool collect_field(ota_image_decoder_t *dec, const uint8_t **data, size_t *len, size_t size)
+{
+    size_t take = size - dec->field_len;
+    if (take > *len) {
+        take = *len;
+    }
+    memcpy(dec->field_buf + dec->field_len, *data, take);
+    dec->field_len += take;
+    dec->total_in += take;
+    *data += take;
+    *len -= take;
+
+    if (dec->field_len < size) {
+        return false;
+    }
+    dec->field_len = 0;
+    return true;
+}
+
+static uint32_t expected_chunk_out(const ota_image_decoder_t *dec)
+{
+    uint32_t remaining = dec->image_size - dec->total_out;
+    return remaining < dec->chunk_size ? remaining : dec->chunk_size;
+}
+
+static void update_checkpoint(ota_image_decoder_t *dec)
+{
+    dec->checkpoint.chunk_size = dec->chunk_size;
+    dec->checkpoint.image_size = dec->image_size;
+    dec->checkpoint.chunk_index = dec->chunk_index;
+    dec->checkpoint.input_offset = dec->total_in;
+    dec->checkpoint.output_offset = dec->total_out;
+}
+
+static esp_err_t parse_header(ota_image_decoder_t *dec)
+{
+    const uint8_t *h = dec->field_buf;
+
+    if (memcmp(h, OTA_IMAGE_MAGIC, 4) != 0) {
+        ESP_LOGE(TAG, "Bad image magic");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (h[4] != OTA_IMAGE_VERSION) {
+        ESP_LOGE(TAG, "Unsupported image version: %d", h[4]);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    dec->chunk_size = read_u32_le(h + 8);
+    dec->image_size = read_u32_le(h + 12);
+    if (dec->chunk_size == 0 || dec->image_size == 0) {
+        ESP_LOGE(TAG, "Invalid image header (chunk=%lu, size=%lu)",
+                 (unsigned long)dec->chunk_size, (unsigned long)dec->image_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    ESP_LOGI(TAG, "Compressed image: %lu bytes in %lu KB chunks",
+             (unsigned long)dec->image_size, (unsigned long)(dec->chunk_size / 1024));
+    update_checkpoint(dec);
+    return ESP_OK;
+}
+
+/**
+ * Inflate as much of the current chunk as the given data allows
+ */
+static esp_err_t inflate_chunk_data(ota_image_decoder_t *dec, const uint8_t **data, size_t *len)
+{
+    while (true) {
+        size_t avail = *len < dec->chunk_in_left ? *len : dec->chunk_in_left;
+        size_t in_bytes = avail;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - dec->dict_ofs;
+        mz_uint32 flags = TINFL_FLAG_PARSE_ZLIB_HEADER;
+        if (dec->chunk_in_left > avail) {
+            flags |= TINFL_FLAG_HAS_MORE_INPUT;
+        }
+
+        tinfl_status status = tinfl_decompress(&dec->inflator, *data, &in_bytes,
+                                               dec->dict, dec->dict + dec->dict_ofs, &out_bytes, flags);
+        *data += in_bytes;
+        *len -= in_bytes;
+        dec->chunk_in_left -= in_bytes;
+        dec->total_in += in_bytes;
+
+        if (out_bytes > 0) {
+            if (dec->chunk_out + out_bytes > expected_chunk_out(dec)) {
+                ESP_LOGE(TAG, "Chunk %lu inflates past its size", (unsigned long)dec->chunk_index);
+                return ESP_ERR_INVALID_SIZE;
+            }
+            esp_err_t err = dec->write_cb(dec->dict + dec->dict_ofs, out_bytes, dec->write_ctx);
+            if (err != ESP_OK) {
+                return err;
+            }
+            dec->chunk_out += out_bytes;
+            dec->dict_ofs = (dec->dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (status == TINFL_STATUS_HAS_MORE_OUTPUT) {
+            continue;
+        }
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+            return ESP_OK;  // Wait for the next feed
+        }
+        if (status != TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Inflate failed in chunk %lu (status %d)", (unsigned long)dec->chunk_index, status);
+            return ESP_ERR_INVALID_CRC;
+        }
+
+        // Chunk complete - it must have used exactly its compressed bytes
+        if (dec->chunk_in_left != 0 || dec->chunk_out != expected_chunk_out(dec)) {
+            ESP_LOGE(TAG, "Chunk %lu size mismatch", (unsigned long)dec->chunk_index);
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        dec->total_out += dec->chunk_out;
+        dec->chunk_index++;
+        update_checkpoint(dec);
+        dec->state = (dec->total_out == dec->image_size) ? DECODER_STATE_DONE : DECODER_STATE_CHUNK_LEN;
+        return ESP_OK;
+    }
+}
+
+esp_err_t ota_image_decoder_create(ota_image_write_cb_t write_cb, void *ctx, ota_image_decoder_t **out_decoder)
+{
+    if (write_cb == NULL || out_decoder == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ota_image_decoder_t *dec = calloc(1, sizeof(ota_image_decoder_t));
+    if (dec == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    dec->dict = malloc(TINFL_LZ_DICT_SIZE);
+    if (dec->dict == NULL) {
+        free(dec);
+        return ESP_ERR_NO_MEM;
+    }
+
+    dec->write_cb = write_cb;
+    dec->write_ctx = ctx;
+    dec->state = DECODER_STATE_HEADER;
+    *out_decoder = dec;
+    return ESP_OK;
+}
+
+esp_err_t ota_image_decoder_feed(ota_image_decoder_t *dec, const uint8_t *data, size_t len)
+{
+    esp_err_t err = ESP_OK;
+
+    while (len > 0 && err == ESP_OK) {
+        switch (dec->state) {
+        case DECODER_STATE_HEADER:
+            if (collect_field(dec, &data, &len, OTA_IMAGE_HEADER_SIZE)) {
+                err = parse_header(dec);
+                dec->state = DECODER_STATE_CHUNK_LEN;
+            }
+            break;
+
+        case DECODER_STATE_CHUNK_LEN:
+            if (collect_field(dec, &data, &len, sizeof(uint32_t))) {
+                dec->chunk_in_left = read_u32_le(dec->field_buf);
+                if (dec->chunk_in_left == 0) {
+                    ESP_LOGE(TAG, "Empty chunk %lu", (unsigned long)dec->chunk_index);
+                    err = ESP_ERR_INVALID_SIZE;
+                    break;
+                }
+                dec->chunk_out = 0;
+                dec->dict_ofs = 0;
+                tinfl_init(&dec->inflator);
+                dec->state = DECODER_STATE_CHUNK_DATA;
+            }
+            break;
+
+        case DECODER_STATE_CHUNK_DATA:
+            err = inflate_chunk_data(dec, &data, &len);
+            break;
+
+        case DECODER_STATE_DONE:
+            ESP_LOGE(TAG, "Unexpected data after end of image");
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+    }
+
+    return err;
+}
+
+esp_err_t ota_image_decoder_resume(ota_image_decoder_t *dec, const ota_image_checkpoint_t *cp)
+{
+    if (dec->state != DECODER_STATE_HEADER || dec->total_in != 0 ||
+        cp->chunk_size == 0 || cp->output_offset > cp->image_size ||
+        cp->output_offset != cp->chunk_index * cp->chunk_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    dec->chunk_size = cp->chunk_size;
+    dec->image_size = cp->image_size;
+    dec->chunk_index = cp->chunk_index;
+    dec->total_in = cp->input_offset;
+    dec->total_out = cp->output_offset;
+    dec->checkpoint = *cp;
+    dec->state = (dec->total_out == dec->image_size) ? DECODER_STATE_DONE : DECODER_STATE_CHUNK_LEN;
+
+    ESP_LOGI(TAG, "Resuming at chunk %lu (%lu of %lu bytes)", (unsigned long)cp->chunk_index,
+             (unsigned long)cp->output_offset, (unsigned long)cp->image_size);
+    return ESP_OK;
+}
+
+void ota_image_decoder_get_checkpoint(const ota_image_decoder_t *dec, ota_image_checkpoint_t *cp)
+{
+    *cp = dec->checkpoint;
+}
+
+esp_err_t ota_image_decoder_finish(ota_image_decoder_t *dec)
+{
+    if (dec->state != DECODER_STATE_DONE) {
+        ESP_LOGE(TAG, "Image truncated: %lu of %lu bytes decoded",
+                 (unsigned long)dec->total_out, (unsigned long)dec->image_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+uint32_t ota_image_decoder_image_size(const ota_image_decoder_t *dec)
+{
+    return dec->image_size;
+}
+
+void ota_image_decoder_destroy(ota_image_decoder_t *dec)
+{
+    if (dec == NULL) {
+        return;
+    }
+    free(dec->dict);
+    free(dec);
+}
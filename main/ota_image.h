@@ -0,0 +1,75 @@
+/**
+ * Compressed OTA Image Decoder
+ *
+ * Streaming decoder for the chunked zlib image published by the OTA server
+ * (beacon_firmware.bin.z). Data is fed in as it arrives from the network
+ * and the decompressed firmware is handed to a write callback, so the
+ * whole image is never held in RAM.
+ *
+ * Image layout (all integers little endian):
+ *
+ *   header   magic "BOTZ" | version u8 | reserved[3] | chunk_size u32 | image_size u32
+ *   chunk    compressed_len u32 | zlib stream (inflates to chunk_size bytes,
+ *            the last chunk holds the remainder of image_size)
+ *
+ * Every chunk is an independent zlib stream with its own Adler-32 check.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define OTA_IMAGE_MAGIC        "BOTZ"
+#define OTA_IMAGE_VERSION      1
+#define OTA_IMAGE_HEADER_SIZE  16
+
+/* Called with each block of decompressed firmware, in order */
+typedef esp_err_t (*ota_image_write_cb_t)(const uint8_t *data, size_t len, void *ctx);
+
+typedef struct ota_image_decoder ota_image_decoder_t;
+
+/* Chunk boundary a download can be resumed from */
+typedef struct {
+    uint32_t chunk_size;
+    uint32_t image_size;
+    uint32_t chunk_index;       // Next chunk to decode
+    uint32_t input_offset;      // Offset of that chunk in the compressed file
+    uint32_t output_offset;     // Decompressed bytes before that chunk
+} ota_image_checkpoint_t;
+
+/**
+ * Allocate a decoder (inflate state + 32 KB dictionary window)
+ */
+esp_err_t ota_image_decoder_create(ota_image_write_cb_t write_cb, void *ctx, ota_image_decoder_t **out_decoder);
+
+/**
+ * Feed the next block of compressed data; any amount, split anywhere
+ */
+esp_err_t ota_image_decoder_feed(ota_image_decoder_t *decoder, const uint8_t *data, size_t len);
+
+/**
+ * Continue a download at a saved chunk boundary instead of the file header.
+ * Must be called before the first feed; data then starts at input_offset.
+ */
+esp_err_t ota_image_decoder_resume(ota_image_decoder_t *decoder, const ota_image_checkpoint_t *checkpoint);
+
+/**
+ * Last completed chunk boundary (chunk_size is 0 until the header was parsed)
+ */
+void ota_image_decoder_get_checkpoint(const ota_image_decoder_t *decoder, ota_image_checkpoint_t *checkpoint);
+
+/**
+ * Check that the complete image was received and decoded
+ */
+esp_err_t ota_image_decoder_finish(ota_image_decoder_t *decoder);
+
+/**
+ * Decompressed image size from the header (0 until the header was parsed)
+ */
+uint32_t ota_image_decoder_image_size(const ota_image_decoder_t *decoder);
+
+void ota_image_decoder_destroy(ota_image_decoder_t *decoder);
@@ -0,0 +1,239 @@
+/**
+ * Signed OTA Image Manifest Implementation
+ *
+ * Signature check with mbedtls (ECDSA P-256 over SHA-256) and streaming
+ * per-chunk SHA-256 verification of the firmware being flashed.
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/pk.h"
+#include "ota_manifest.h"
+
+static const char* TAG = "OTA-Manifest";
+
+#ifndef OTA_MANIFEST_PUBKEY
+#define OTA_MANIFEST_PUBKEY 0
+#endif
+
+#if OTA_MANIFEST_PUBKEY
+// main/certs/manifest_pub.pem, embedded by CMakeLists.txt when present
+extern const uint8_t manifest_pub_pem_start[] asm("_binary_manifest_pub_pem_start");
+extern const uint8_t manifest_pub_pem_end[]   asm("_binary_manifest_pub_pem_end");
+#endif
+
+struct ota_manifest {
+    uint32_t image_size;
+    uint32_t chunk_size;
+    uint32_t chunk_count;
+    char version[32];
+
+    // Verification in progress
+    mbedtls_sha256_context sha;
+    uint32_t offset;            // Firmware bytes hashed so far
+    uint32_t chunk_index;       // Chunk being hashed
+    esp_err_t err;              // First mismatch; sticks
+
+    uint8_t hashes[];           // chunk_count x OTA_MANIFEST_HASH_SIZE
+};
+
+static uint16_t read_u16_le(const uint8_t *p)
+{
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static uint32_t read_u32_le(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+#if OTA_MANIFEST_PUBKEY
+static esp_err_t verify_signature(const uint8_t *body, size_t body_len, const uint8_t *sig, size_t sig_len)
+{
+    uint8_t digest[OTA_MANIFEST_HASH_SIZE];
+    mbedtls_sha256(body, body_len, digest, 0);
+
+    mbedtls_pk_context pk;
+    mbedtls_pk_init(&pk);
+
+    // EMBED_TXTFILES adds the NUL terminator the PEM parser expects
+    int ret = mbedtls_pk_parse_public_key(&pk, manifest_pub_pem_start, manifest_pub_pem_end - manifest_pub_pem_start);
+    if (ret != 0 || !mbedtls_pk_can_do(&pk, MBEDTLS_PK_ECKEY)) {
+        ESP_LOGE(TAG, "✗ Built-in manifest key is not an EC public key (-0x%04x)", (unsigned)-ret);
+        mbedtls_pk_free(&pk);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ret = mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, digest, sizeof(digest), sig, sig_len);
+    mbedtls_pk_free(&pk);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "✗ Manifest signature does not verify (-0x%04x)", (unsigned)-ret);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    return ESP_OK;
+}
+#endif
+
+esp_err_t ota_manifest_parse(const uint8_t *data, size_t len, ota_manifest_t **out_manifest)
+{
+    if (len < OTA_MANIFEST_HEADER_SIZE + 4 || memcmp(data, OTA_MANIFEST_MAGIC, 4) != 0) {
+        ESP_LOGE(TAG, "✗ Not a firmware manifest");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (data[4] != OTA_MANIFEST_VERSION) {
+        ESP_LOGE(TAG, "✗ Unsupported manifest version %u", data[4]);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    uint32_t image_size = read_u32_le(data + 8);
+    uint32_t chunk_size = read_u32_le(data + 12);
+    uint32_t chunk_count = read_u32_le(data + 16);
+    if (image_size == 0 || chunk_size == 0 ||
+        chunk_count != (image_size + chunk_size - 1) / chunk_size ||
+        chunk_count > (len - OTA_MANIFEST_HEADER_SIZE - 4) / OTA_MANIFEST_HASH_SIZE) {
+        ESP_LOGE(TAG, "✗ Inconsistent manifest (%lu bytes in %lu x %lu byte chunks)",
+                 (unsigned long)image_size, (unsigned long)chunk_count, (unsigned long)chunk_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t body_len = OTA_MANIFEST_HEADER_SIZE + chunk_count * OTA_MANIFEST_HASH_SIZE;
+    uint16_t sig_len = read_u16_le(data + body_len);
+    if (body_len + 4 + sig_len != len || data[20 + 31] != '\0') {
+        ESP_LOGE(TAG, "✗ Malformed manifest");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+#if OTA_MANIFEST_PUBKEY
+    esp_err_t err = verify_signature(data, body_len, data + body_len + 4, sig_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+#else
+    ESP_LOGW(TAG, "⚠️  No manifest key built in - signature not checked");
+#endif
+
+    ota_manifest_t *manifest = calloc(1, sizeof(*manifest) + chunk_count * OTA_MANIFEST_HASH_SIZE);
+    if (manifest == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    manifest->image_size = image_size;
+    manifest->chunk_size = chunk_size;
+    manifest->chunk_count = chunk_count;
+    memcpy(manifest->version, data + 20, sizeof(manifest->version));
+    memcpy(manifest->hashes, data + OTA_MANIFEST_HEADER_SIZE, chunk_count * OTA_MANIFEST_HASH_SIZE);
+    mbedtls_sha256_init(&manifest->sha);
+    mbedtls_sha256_starts(&manifest->sha, 0);
+
+    ESP_LOGI(TAG, "✓ Manifest for %s: %lu bytes, %lu chunks%s", manifest->version,
+             (unsigned long)image_size, (unsigned long)chunk_count, OTA_MANIFEST_PUBKEY ? ", signature OK" : "");
+    *out_manifest = manifest;
+    return ESP_OK;
+}
+
+const char *ota_manifest_version(const ota_manifest_t *manifest)
+{
+    return manifest->version;
+}
+
+uint32_t ota_manifest_image_size(const ota_manifest_t *manifest)
+{
+    return manifest->image_size;
+}
+
+esp_err_t ota_manifest_seek(ota_manifest_t *manifest, const esp_partition_t *partition, uint32_t offset)
+{
+    if (offset >= manifest->image_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    manifest->chunk_index = offset / manifest->chunk_size;
+    manifest->offset = manifest->chunk_index * manifest->chunk_size;
+    manifest->err = ESP_OK;
+    mbedtls_sha256_starts(&manifest->sha, 0);
+
+    // Earlier chunks were verified before they were checkpointed
+    uint8_t buf[256];
+    while (manifest->offset < offset) {
+        size_t n = offset - manifest->offset;
+        if (n > sizeof(buf)) {
+            n = sizeof(buf);
+        }
+        esp_err_t err = esp_partition_read(partition, manifest->offset, buf, n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        mbedtls_sha256_update(&manifest->sha, buf, n);
+        manifest->offset += n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_manifest_verify(ota_manifest_t *manifest, const uint8_t *data, size_t len)
+{
+    while (len > 0 && manifest->err == ESP_OK) {
+        if (manifest->chunk_index >= manifest->chunk_count) {
+            ESP_LOGE(TAG, "✗ Image is longer than the manifest's %lu bytes", (unsigned long)manifest->image_size);
+            manifest->err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+
+        uint32_t chunk_end = (manifest->chunk_index + 1) * manifest->chunk_size;
+        if (chunk_end > manifest->image_size) {
+            chunk_end = manifest->image_size;
+        }
+        size_t n = chunk_end - manifest->offset;
+        if (n > len) {
+            n = len;
+        }
+        mbedtls_sha256_update(&manifest->sha, data, n);
+        manifest->offset += n;
+        data += n;
+        len -= n;
+
+        if (manifest->offset == chunk_end) {
+            uint8_t digest[OTA_MANIFEST_HASH_SIZE];
+            mbedtls_sha256_finish(&manifest->sha, digest);
+            if (memcmp(digest, manifest->hashes + manifest->chunk_index * OTA_MANIFEST_HASH_SIZE, sizeof(digest)) != 0) {
+                ESP_LOGE(TAG, "✗ Chunk %lu (offset 0x%lx) does not match the manifest",
+                         (unsigned long)manifest->chunk_index,
+                         (unsigned long)(manifest->chunk_index * manifest->chunk_size));
+                manifest->err = ESP_ERR_INVALID_CRC;
+                break;
+            }
+            manifest->chunk_index++;
+            mbedtls_sha256_starts(&manifest->sha, 0);
+        }
+    }
+    return manifest->err;
+}
+
+esp_err_t ota_manifest_finish(ota_manifest_t *manifest)
+{
+    if (manifest->err != ESP_OK) {
+        return manifest->err;
+    }
+    if (manifest->chunk_index != manifest->chunk_count) {
+        ESP_LOGE(TAG, "✗ Image ended after %lu of %lu bytes",
+                 (unsigned long)manifest->offset, (unsigned long)manifest->image_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ESP_LOGI(TAG, "✓ All %lu chunks match the manifest", (unsigned long)manifest->chunk_count);
+    return ESP_OK;
+}
+
+void ota_manifest_destroy(ota_manifest_t *manifest)
+{
+    if (manifest == NULL) {
+        return;
+    }
+    mbedtls_sha256_free(&manifest->sha);
+    free(manifest);
+}
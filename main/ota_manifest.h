@@ -0,0 +1,75 @@
+/**
+ * Signed OTA Image Manifest
+ *
+ * The OTA server publishes a manifest next to each build
+ * (beacon_firmware.manifest). It lists a SHA-256 for every chunk of the
+ * firmware and is signed with the server's ECDSA P-256 key. The firmware
+ * checks the signature once, then hashes the image as it is written to
+ * flash, so a corrupt or tampered download is stopped at the first chunk
+ * that does not match instead of after the whole image.
+ *
+ * Manifest layout (all integers little endian):
+ *
+ *   header     magic "BOTM" | version u8 | reserved[3] | image_size u32 |
+ *              chunk_size u32 | chunk_count u32 | firmware version [32] |
+ *              image SHA-256 [32]
+ *   hashes     chunk_count x SHA-256 of chunk_size bytes of firmware
+ *              (the last chunk holds the remainder of image_size)
+ *   signature  sig_len u16 | reserved u16 | ASN.1 ECDSA signature of the
+ *              SHA-256 of header + hashes
+ *
+ * The public key is built in from main/certs/manifest_pub.pem when the file
+ * exists (OTA_MANIFEST_PUBKEY). Without it signatures are not checked; the
+ * chunk hashes then still catch corruption, but not tampering.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#define OTA_MANIFEST_MAGIC        "BOTM"
+#define OTA_MANIFEST_VERSION      1
+#define OTA_MANIFEST_HEADER_SIZE  84
+#define OTA_MANIFEST_HASH_SIZE    32
+
+// Enough for a 4 MB image in 16 KB chunks
+#define OTA_MANIFEST_MAX_SIZE     (OTA_MANIFEST_HEADER_SIZE + 256 * OTA_MANIFEST_HASH_SIZE + 128)
+
+typedef struct ota_manifest ota_manifest_t;
+
+/**
+ * Check a downloaded manifest and its signature; data is copied
+ */
+esp_err_t ota_manifest_parse(const uint8_t *data, size_t len, ota_manifest_t **out_manifest);
+
+/**
+ * Firmware version the manifest was signed for
+ */
+const char *ota_manifest_version(const ota_manifest_t *manifest);
+
+uint32_t ota_manifest_image_size(const ota_manifest_t *manifest);
+
+/**
+ * Continue verification of a resumed download at image offset 'offset'.
+ * The part of the current chunk already flashed is read back and hashed.
+ */
+esp_err_t ota_manifest_seek(ota_manifest_t *manifest, const esp_partition_t *partition, uint32_t offset);
+
+/**
+ * Hash the next firmware bytes; call before writing them to flash.
+ * Returns ESP_ERR_INVALID_CRC once a completed chunk does not match, so at
+ * most one chunk of bad data reaches the (never activated) partition.
+ */
+esp_err_t ota_manifest_verify(ota_manifest_t *manifest, const uint8_t *data, size_t len);
+
+/**
+ * Check that the whole image was seen and verified
+ */
+esp_err_t ota_manifest_finish(ota_manifest_t *manifest);
+
+void ota_manifest_destroy(ota_manifest_t *manifest);
@@ -0,0 +1,240 @@
+/**
+ * OTA Self-Test Implementation
+ *
+ * One esp_timer decides the trial: it fires at the timeout, or at once when
+ * the last check passes, and either confirms the image or rolls it back.
+ * Flash work therefore never runs in the BT or event loop callbacks.
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_ota_ops.h"
+#include "esp_app_desc.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "boot_timeline.h"
+#include "telemetry.h"
+#include "ota_selftest.h"
+
+static const char* TAG = "SelfTest";
+
+// Shared with the OTA resume state
+#define SELFTEST_NVS_NAMESPACE "ota_state"
+#define SELFTEST_NVS_KEY "selftest"
+
+// An image built without Wi-Fi (beacon-only profile) is judged on the radio alone
+#if CONFIG_BEACON_WIFI
+#define SELFTEST_PRESET 0
+#define SELFTEST_CHECKS "advertising and Wi-Fi"
+#else
+#define SELFTEST_PRESET (1u << OTA_SELFTEST_WIFI)
+#define SELFTEST_CHECKS "advertising"
+#endif
+
+static const char *s_check_names[OTA_SELFTEST_COUNT] = {
+    [OTA_SELFTEST_ADVERTISING] = "advertising",
+    [OTA_SELFTEST_WIFI]        = "Wi-Fi",
+};
+
+/**
+ * Trial record, kept in NVS until the image is confirmed
+ */
+typedef struct {
+    uint32_t partition_address;     // Slot of the image on trial
+    char version[32];
+    char reason[96];                // Why it failed; preset for a reset mid-trial
+} selftest_record_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_pending = false;
+static uint32_t s_passed;           // Bit per ota_selftest_check_t
+static uint32_t s_timeout_ms;
+static esp_timer_handle_t s_timer;
+
+static bool load_record(selftest_record_t *record)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(SELFTEST_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(*record);
+    esp_err_t err = nvs_get_blob(nvs_handle, SELFTEST_NVS_KEY, record, &len);
+    nvs_close(nvs_handle);
+    return err == ESP_OK && len == sizeof(*record);
+}
+
+static void save_record(const selftest_record_t *record)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(SELFTEST_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        if (nvs_set_blob(nvs_handle, SELFTEST_NVS_KEY, record, sizeof(*record)) == ESP_OK) {
+            nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+}
+
+static void clear_record(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(SELFTEST_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        if (nvs_erase_key(nvs_handle, SELFTEST_NVS_KEY) == ESP_OK) {
+            nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+}
+
+/**
+ * A record left by another slot means that image was rolled back
+ */
+static void report_rollback(const esp_partition_t *running)
+{
+    selftest_record_t record;
+    if (!load_record(&record) || record.partition_address == running->address) {
+        return;
+    }
+
+    char message[TELEMETRY_MESSAGE_LEN];
+    snprintf(message, sizeof(message), "Firmware %s failed its self-test and was rolled back: %s. Running %s again.",
+             record.version, record.reason, esp_app_get_description()->version);
+    ESP_LOGE(TAG, "✗ %s", message);
+    telemetry_post(TELEMETRY_ERROR, "OTA Rolled Back", message);
+    clear_record();
+}
+
+static void confirm_image(void)
+{
+    esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "✗ Failed to mark image valid: %s", esp_err_to_name(err));
+        return;
+    }
+    clear_record();
+
+    taskENTER_CRITICAL(&s_lock);
+    s_pending = false;
+    taskEXIT_CRITICAL(&s_lock);
+
+    char message[TELEMETRY_MESSAGE_LEN];
+    snprintf(message, sizeof(message), "Firmware %s passed its self-test (advertising at %ld ms, Wi-Fi at %ld ms)",
+             esp_app_get_description()->version,
+             (long)boot_timeline_get_ms(BOOT_STAGE_FIRST_ADV), (long)boot_timeline_get_ms(BOOT_STAGE_WIFI_CONNECTED));
+    ESP_LOGI(TAG, "✓ %s", message);
+    telemetry_post(TELEMETRY_INFO, "OTA Confirmed", message);
+}
+
+static void roll_back(uint32_t passed)
+{
+    selftest_record_t record;
+    if (!load_record(&record)) {
+        memset(&record, 0, sizeof(record));
+        record.partition_address = esp_ota_get_running_partition()->address;
+        strlcpy(record.version, esp_app_get_description()->version, sizeof(record.version));
+    }
+
+    int len = snprintf(record.reason, sizeof(record.reason), "no");
+    for (int i = 0; i < OTA_SELFTEST_COUNT; i++) {
+        if (!(passed & (1u << i)) && len < (int)sizeof(record.reason)) {
+            len += snprintf(record.reason + len, sizeof(record.reason) - len, "%s %s",
+                            len > 2 ? " or" : "", s_check_names[i]);
+        }
+    }
+    if (len < (int)sizeof(record.reason)) {
+        snprintf(record.reason + len, sizeof(record.reason) - len, " within %lu s",
+                 (unsigned long)(s_timeout_ms / 1000));
+    }
+    save_record(&record);
+
+    ESP_LOGE(TAG, "✗ Self-test failed (%s) - rolling back", record.reason);
+    esp_err_t err = esp_ota_mark_app_invalid_rollback_and_reboot();
+
+    // Only returns when there is nothing to roll back to
+    ESP_LOGE(TAG, "✗ Rollback failed: %s - keeping this image", esp_err_to_name(err));
+}
+
+static void trial_timer_cb(void *arg)
+{
+    taskENTER_CRITICAL(&s_lock);
+    uint32_t passed = s_passed;
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (passed == (1u << OTA_SELFTEST_COUNT) - 1) {
+        confirm_image();
+    } else {
+        roll_back(passed);
+    }
+}
+
+void ota_selftest_start(uint32_t timeout_ms)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    report_rollback(running);
+
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) != ESP_OK || state != ESP_OTA_IMG_PENDING_VERIFY) {
+        // Flashed over USB, or confirmed on an earlier boot
+        return;
+    }
+
+    // A reset before the timer decides leaves this reason behind
+    selftest_record_t record = { .partition_address = running->address };
+    strlcpy(record.version, esp_app_get_description()->version, sizeof(record.version));
+    strlcpy(record.reason, "reset during the self-test", sizeof(record.reason));
+    save_record(&record);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = trial_timer_cb,
+        .name = "ota_selftest",
+    };
+    if (esp_timer_create(&timer_args, &s_timer) != ESP_OK) {
+        // Without the timer a bad image could never be rolled back - keep it
+        ESP_LOGE(TAG, "✗ Failed to create self-test timer, confirming image");
+        confirm_image();
+        return;
+    }
+
+    s_timeout_ms = timeout_ms;
+    taskENTER_CRITICAL(&s_lock);
+    s_pending = true;
+    s_passed |= SELFTEST_PRESET;
+    taskEXIT_CRITICAL(&s_lock);
+    esp_timer_start_once(s_timer, (uint64_t)timeout_ms * 1000);
+
+    ESP_LOGW(TAG, "⚠️  New firmware on trial: " SELFTEST_CHECKS " must come up within %lu s",
+             (unsigned long)(timeout_ms / 1000));
+}
+
+void ota_selftest_pass(ota_selftest_check_t check)
+{
+    bool decide = false;
+
+    taskENTER_CRITICAL(&s_lock);
+    if (s_pending && !(s_passed & (1u << check))) {
+        s_passed |= 1u << check;
+        decide = s_passed == (1u << OTA_SELFTEST_COUNT) - 1;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (decide) {
+        // Let the timer task do the flash write
+        esp_timer_stop(s_timer);
+        esp_timer_start_once(s_timer, 0);
+    }
+}
+
+bool ota_selftest_pending(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    bool pending = s_pending;
+    taskEXIT_CRITICAL(&s_lock);
+    return pending;
+}
@@ -0,0 +1,42 @@
+/**
+ * OTA Self-Test
+ *
+ * With bootloader rollback enabled, a freshly installed image boots in the
+ * PENDING_VERIFY state. It is only marked valid once every self-test check
+ * has passed (advertising started, Wi-Fi connected). If they have not all
+ * passed within the timeout, the image is marked invalid and the device
+ * reboots into the previous firmware; a crash or reset during the trial
+ * has the same effect through the bootloader.
+ *
+ * The trial is recorded in NVS, so the previous firmware can tell after
+ * the rollback which version failed and why, and report it.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    OTA_SELFTEST_ADVERTISING,   // Controller confirmed advertising started
+    OTA_SELFTEST_WIFI,          // Got an IP address (passed at once without CONFIG_BEACON_WIFI)
+    OTA_SELFTEST_COUNT
+} ota_selftest_check_t;
+
+/**
+ * Report an earlier rollback, and start the trial if this image is still
+ * pending verification. Call once after NVS is initialized.
+ */
+void ota_selftest_start(uint32_t timeout_ms);
+
+/**
+ * Record that a check passed; safe from any task
+ */
+void ota_selftest_pass(ota_selftest_check_t check);
+
+/**
+ * True while the running image is on trial (no OTA update possible)
+ */
+bool ota_selftest_pending(void);
@@ -0,0 +1,166 @@
+/**
+ * OTA Flash Writer Implementation
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "ota_writer.h"
+
+static const char* TAG = "OTA-Writer";
+
+#define OTA_WRITER_STACK_SIZE  6144
+
+typedef struct {
+    uint8_t *data;              // NULL stops the writer
+    size_t len;
+} ota_writer_block_t;
+
+struct ota_writer {
+    ota_writer_config_t config;
+    uint8_t *pool;
+    QueueHandle_t free_queue;
+    QueueHandle_t full_queue;
+    SemaphoreHandle_t done;
+    TaskHandle_t task;
+    volatile esp_err_t err;
+    bool finished;
+    ota_writer_stats_t stats;
+};
+
+static void ota_writer_task(void *pvParameter)
+{
+    ota_writer_t *writer = pvParameter;
+
+    int64_t start = esp_timer_get_time();
+    if (writer->config.begin != NULL) {
+        writer->err = writer->config.begin(writer->config.ctx);
+    }
+    writer->stats.begin_ms = (esp_timer_get_time() - start) / 1000;
+
+    while (1) {
+        ota_writer_block_t block;
+        xQueueReceive(writer->full_queue, &block, portMAX_DELAY);
+        if (block.data == NULL) {
+            break;
+        }
+
+        // After a failure blocks are only recycled so the network side never blocks
+        if (writer->err == ESP_OK && block.len > 0) {
+            start = esp_timer_get_time();
+            esp_err_t err = writer->config.sink(block.data, block.len, writer->config.ctx);
+            writer->stats.sink_ms += (esp_timer_get_time() - start) / 1000;
+            if (err != ESP_OK) {
+                writer->err = err;
+            }
+        }
+        xQueueSend(writer->free_queue, &block.data, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(writer->done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t ota_writer_start(const ota_writer_config_t *config, ota_writer_t **out_writer)
+{
+    if (config == NULL || config->sink == NULL || config->block_size == 0 || config->block_count < 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ota_writer_t *writer = calloc(1, sizeof(*writer));
+    if (writer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    writer->config = *config;
+    writer->pool = malloc(config->block_size * config->block_count);
+    writer->free_queue = xQueueCreate(config->block_count, sizeof(uint8_t *));
+    // One extra slot for the stop marker
+    writer->full_queue = xQueueCreate(config->block_count + 1, sizeof(ota_writer_block_t));
+    writer->done = xSemaphoreCreateBinary();
+    if (writer->pool == NULL || writer->free_queue == NULL || writer->full_queue == NULL || writer->done == NULL) {
+        writer->finished = true;
+        ota_writer_destroy(writer);
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < config->block_count; i++) {
+        uint8_t *block = writer->pool + i * config->block_size;
+        xQueueSend(writer->free_queue, &block, 0);
+    }
+
+    if (xTaskCreate(ota_writer_task, "ota_writer", OTA_WRITER_STACK_SIZE, writer, 5, &writer->task) != pdPASS) {
+        writer->finished = true;
+        ota_writer_destroy(writer);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Writer started: %d x %u byte blocks", config->block_count, (unsigned)config->block_size);
+    *out_writer = writer;
+    return ESP_OK;
+}
+
+uint8_t *ota_writer_acquire(ota_writer_t *writer)
+{
+    uint8_t *block = NULL;
+    int64_t start = esp_timer_get_time();
+    xQueueReceive(writer->free_queue, &block, portMAX_DELAY);
+    writer->stats.stall_ms += (esp_timer_get_time() - start) / 1000;
+
+    if (writer->err != ESP_OK) {
+        xQueueSend(writer->free_queue, &block, 0);
+        return NULL;
+    }
+    return block;
+}
+
+void ota_writer_submit(ota_writer_t *writer, uint8_t *block, size_t len)
+{
+    ota_writer_block_t item = { .data = block, .len = len };
+    xQueueSend(writer->full_queue, &item, portMAX_DELAY);
+}
+
+esp_err_t ota_writer_finish(ota_writer_t *writer)
+{
+    if (!writer->finished) {
+        ota_writer_block_t stop = { .data = NULL, .len = 0 };
+        xQueueSend(writer->full_queue, &stop, portMAX_DELAY);
+        xSemaphoreTake(writer->done, portMAX_DELAY);
+        writer->finished = true;
+    }
+    return writer->err;
+}
+
+void ota_writer_get_stats(const ota_writer_t *writer, ota_writer_stats_t *stats)
+{
+    *stats = writer->stats;
+}
+
+void ota_writer_destroy(ota_writer_t *writer)
+{
+    if (writer == NULL) {
+        return;
+    }
+
+    ota_writer_finish(writer);
+    if (writer->free_queue != NULL) {
+        vQueueDelete(writer->free_queue);
+    }
+    if (writer->full_queue != NULL) {
+        vQueueDelete(writer->full_queue);
+    }
+    if (writer->done != NULL) {
+        vSemaphoreDelete(writer->done);
+    }
+    free(writer->pool);
+    free(writer);
+}
@@ -0,0 +1,71 @@
+/**
+ * OTA Flash Writer
+ *
+ * Moves flash work off the download loop: the network task fills blocks
+ * from a small pool and submits them, and a writer task runs the sink
+ * (inflate + esp_ota_write) on each block in order while the next one is
+ * being received.
+ *
+ * The writer first runs the begin callback, which is where the target
+ * partition is pre-erased - bulk erase with 64 KB blocks is much faster
+ * than the per-4 KB-sector erases of sequential writes, and the network
+ * keeps filling the pool while it runs.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef struct ota_writer ota_writer_t;
+
+/* Runs once on the writer task before the first block */
+typedef esp_err_t (*ota_writer_begin_cb_t)(void *ctx);
+
+/* Consumes one block, in submission order */
+typedef esp_err_t (*ota_writer_sink_cb_t)(const uint8_t *data, size_t len, void *ctx);
+
+typedef struct {
+    size_t block_size;
+    int block_count;            // Pool size, at least 2
+    ota_writer_begin_cb_t begin;
+    ota_writer_sink_cb_t sink;
+    void *ctx;
+} ota_writer_config_t;
+
+typedef struct {
+    uint32_t begin_ms;          // Time in the begin callback (pre-erase)
+    uint32_t sink_ms;           // Time writing blocks
+    uint32_t stall_ms;          // Time the network waited for a free block
+} ota_writer_stats_t;
+
+/**
+ * Allocate the block pool and start the writer task
+ */
+esp_err_t ota_writer_start(const ota_writer_config_t *config, ota_writer_t **out_writer);
+
+/**
+ * Wait for a free block. Returns NULL once the writer has failed.
+ */
+uint8_t *ota_writer_acquire(ota_writer_t *writer);
+
+/**
+ * Queue a filled block for writing; len 0 just returns it to the pool
+ */
+void ota_writer_submit(ota_writer_t *writer, uint8_t *block, size_t len);
+
+/**
+ * Write everything submitted and stop the writer task.
+ * Returns the first error of the begin or sink callback.
+ */
+esp_err_t ota_writer_finish(ota_writer_t *writer);
+
+void ota_writer_get_stats(const ota_writer_t *writer, ota_writer_stats_t *stats);
+
+/**
+ * Stop the writer (if still running) and free the pool
+ */
+void ota_writer_destroy(ota_writer_t *writer);
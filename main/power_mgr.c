@@ -0,0 +1,167 @@
+/**
+ * Power Management Implementation
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "power_mgr.h"
+
+static const char* TAG = "Power";
+
+static const char *s_state_names[POWER_STATE_COUNT] = {
+    [POWER_STATE_ADVERTISING] = "adv-only",
+    [POWER_STATE_WIFI]        = "wifi",
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static power_state_t s_state = POWER_STATE_WIFI;
+static int64_t s_state_since_us;
+static uint64_t s_time_us[POWER_STATE_COUNT];
+static float s_nominal_ma[POWER_STATE_COUNT];
+
+// Sampler results: sum of samples and count per state
+static power_current_sampler_t s_sampler;
+static esp_timer_handle_t s_sample_timer;
+static double s_sample_sum_ma[POWER_STATE_COUNT];
+static uint32_t s_sample_count[POWER_STATE_COUNT];
+
+/**
+ * Charge elapsed time to the current state. Caller holds s_lock.
+ */
+static void account_locked(int64_t now_us)
+{
+    s_time_us[s_state] += now_us - s_state_since_us;
+    s_state_since_us = now_us;
+}
+
+static void sample_timer_cb(void *arg)
+{
+    float ma = s_sampler();
+
+    taskENTER_CRITICAL(&s_lock);
+    s_sample_sum_ma[s_state] += ma;
+    s_sample_count[s_state]++;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t power_mgr_init(bool low_power, const float nominal_ma[POWER_STATE_COUNT])
+{
+    memcpy(s_nominal_ma, nominal_ma, sizeof(s_nominal_ma));
+    s_state_since_us = esp_timer_get_time();
+
+    if (!low_power) {
+        return ESP_OK;
+    }
+
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = 40,     // XTAL frequency
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#else
+        .light_sleep_enable = false,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure power management: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "✓ DFS %d-%d MHz, automatic light sleep %s", pm_config.min_freq_mhz,
+             pm_config.max_freq_mhz, pm_config.light_sleep_enable ? "on" : "off");
+    return ESP_OK;
+#else
+    ESP_LOGW(TAG, "⚠️  CONFIG_PM_ENABLE is off - low-power mode only switches Wi-Fi off");
+    return ESP_OK;
+#endif
+}
+
+void power_mgr_set_state(power_state_t state)
+{
+    if (state >= POWER_STATE_COUNT) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    account_locked(esp_timer_get_time());
+    s_state = state;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t power_mgr_set_current_sampler(power_current_sampler_t sampler, uint32_t sample_ms)
+{
+    if (sampler == NULL || sample_ms == 0 || s_sample_timer != NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_sampler = sampler;
+    const esp_timer_create_args_t timer_args = {
+        .callback = sample_timer_cb,
+        .name = "power_sample",
+        // Do not wake the chip just to sample
+        .skip_unhandled_events = true,
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_sample_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return esp_timer_start_periodic(s_sample_timer, (uint64_t)sample_ms * 1000);
+}
+
+void power_mgr_get_report(power_report_t *report)
+{
+    memset(report, 0, sizeof(*report));
+
+    taskENTER_CRITICAL(&s_lock);
+    account_locked(esp_timer_get_time());
+    for (int i = 0; i < POWER_STATE_COUNT; i++) {
+        report->time_ms[i] = s_time_us[i] / 1000;
+        report->measured[i] = s_sample_count[i] > 0;
+        report->avg_ma[i] = report->measured[i] ? (float)(s_sample_sum_ma[i] / s_sample_count[i]) : s_nominal_ma[i];
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    // Time-weighted average over all states
+    double charge = 0;
+    uint64_t total_ms = 0;
+    for (int i = 0; i < POWER_STATE_COUNT; i++) {
+        charge += (double)report->avg_ma[i] * report->time_ms[i];
+        total_ms += report->time_ms[i];
+    }
+    report->overall_avg_ma = total_ms > 0 ? (float)(charge / total_ms) : 0;
+}
+
+void power_mgr_log_report(uint32_t battery_mah)
+{
+    power_report_t report;
+    power_mgr_get_report(&report);
+
+    uint64_t total_ms = 0;
+    for (int i = 0; i < POWER_STATE_COUNT; i++) {
+        total_ms += report.time_ms[i];
+    }
+
+    ESP_LOGI(TAG, "========== Power Report ==========");
+    for (int i = 0; i < POWER_STATE_COUNT; i++) {
+        ESP_LOGI(TAG, "%-9s %8llu s (%5.1f%%)  %6.2f mA %s", s_state_names[i],
+                 (unsigned long long)(report.time_ms[i] / 1000),
+                 total_ms > 0 ? 100.0 * report.time_ms[i] / total_ms : 0.0,
+                 report.avg_ma[i], report.measured[i] ? "measured" : "nominal");
+    }
+    ESP_LOGI(TAG, "Average: %.2f mA", report.overall_avg_ma);
+    if (battery_mah > 0 && report.overall_avg_ma > 0) {
+        ESP_LOGI(TAG, "Estimated runtime on %lu mAh: %.1f days", (unsigned long)battery_mah,
+                 battery_mah / report.overall_avg_ma / 24.0);
+    }
+    ESP_LOGI(TAG, "==================================");
+}
@@ -0,0 +1,65 @@
+/**
+ * Power Management
+ *
+ * Low-power operation for battery beacons: dynamic frequency scaling and
+ * automatic light sleep while only BLE advertising is running, with Wi-Fi
+ * brought up just for maintenance windows.
+ *
+ * Time is accounted per power state. Average current per state comes from
+ * an optional sampler (e.g. a shunt on an ADC or an INA219 driver) and
+ * falls back to nominal per-state figures, which is enough to size
+ * batteries once the figures are calibrated.
+ *
+ * Automatic light sleep needs CONFIG_PM_ENABLE and
+ * CONFIG_FREERTOS_USE_TICKLESS_IDLE (see sdkconfig.defaults). With BLE
+ * enabled the ESP32 only enters light sleep between advertising events
+ * when the controller runs from a 32 kHz crystal
+ * (CONFIG_BTDM_CTRL_LOW_POWER_CLOCK_EXTERNAL_32K); otherwise it still
+ * scales the CPU down to the minimum frequency between events.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef enum {
+    POWER_STATE_ADVERTISING,    // BLE only, Wi-Fi off
+    POWER_STATE_WIFI,           // Wi-Fi associated (modem sleep) + BLE
+    POWER_STATE_COUNT
+} power_state_t;
+
+/* Returns the instantaneous supply current in mA */
+typedef float (*power_current_sampler_t)(void);
+
+typedef struct {
+    uint64_t time_ms[POWER_STATE_COUNT];
+    float avg_ma[POWER_STATE_COUNT];        // Measured if sampled, else nominal
+    bool measured[POWER_STATE_COUNT];
+    float overall_avg_ma;
+} power_report_t;
+
+/**
+ * Enable DFS / automatic light sleep when low_power is set.
+ * nominal_ma gives the fallback current of each state.
+ */
+esp_err_t power_mgr_init(bool low_power, const float nominal_ma[POWER_STATE_COUNT]);
+
+void power_mgr_set_state(power_state_t state);
+
+/**
+ * Install a current sampler, polled every sample_ms from an esp_timer
+ * callback (so it must be quick and not block)
+ */
+esp_err_t power_mgr_set_current_sampler(power_current_sampler_t sampler, uint32_t sample_ms);
+
+void power_mgr_get_report(power_report_t *report);
+
+/**
+ * Log time share and average current per state, plus the runtime a
+ * battery of battery_mah would give at the overall average
+ */
+void power_mgr_log_report(uint32_t battery_mah);
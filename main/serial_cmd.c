@@ -0,0 +1,116 @@
+/**
+ * Serial Commands Implementation
+ *
+ * Reads the console UART through the UART driver; log output keeps going
+ * through the regular console.
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+#include "serial_cmd.h"
+
+static const char* TAG = "Serial-Cmd";
+
+typedef struct {
+    const char *name;
+    serial_cmd_handler_t handler;
+} serial_cmd_t;
+
+static serial_cmd_t s_commands[SERIAL_CMD_MAX_COMMANDS];
+static int s_command_count;
+static TaskHandle_t s_task;
+
+esp_err_t serial_cmd_register(const char *name, serial_cmd_handler_t handler)
+{
+    if (name == NULL || handler == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_command_count == SERIAL_CMD_MAX_COMMANDS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_commands[s_command_count].name = name;
+    s_commands[s_command_count].handler = handler;
+    s_command_count++;
+    return ESP_OK;
+}
+
+static void dispatch(char *line)
+{
+    size_t name_len = strcspn(line, ": ");
+    const char *args = line[name_len] != '\0' ? line + name_len + 1 : "";
+    line[name_len] = '\0';
+
+    for (int i = 0; i < s_command_count; i++) {
+        if (strcasecmp(s_commands[i].name, line) == 0) {
+            s_commands[i].handler(args);
+            return;
+        }
+    }
+    printf("ERR unknown command: %s\n", line);
+}
+
+#if CONFIG_ESP_CONSOLE_UART
+static void serial_cmd_task(void *pvParameter)
+{
+    char line[SERIAL_CMD_MAX_LINE];
+    size_t len = 0;
+    bool overflow = false;
+
+    while (1) {
+        uint8_t c;
+        if (uart_read_bytes(CONFIG_ESP_CONSOLE_UART_NUM, &c, 1, portMAX_DELAY) != 1) {
+            continue;
+        }
+
+        if (c == '\r' || c == '\n') {
+            if (len > 0 && !overflow) {
+                line[len] = '\0';
+                dispatch(line);
+            } else if (overflow) {
+                printf("ERR line too long\n");
+            }
+            len = 0;
+            overflow = false;
+        } else if (len < sizeof(line) - 1) {
+            line[len++] = (char)c;
+        } else {
+            overflow = true;
+        }
+    }
+}
+#endif
+
+esp_err_t serial_cmd_start(void)
+{
+    if (s_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+#if CONFIG_ESP_CONSOLE_UART
+    esp_err_t err = uart_driver_install(CONFIG_ESP_CONSOLE_UART_NUM, 256, 0, 0, NULL, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to install UART driver: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    if (xTaskCreate(serial_cmd_task, "serial_cmd", 4096, NULL, 2, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "✓ Listening for commands on UART%d", CONFIG_ESP_CONSOLE_UART_NUM);
+    return ESP_OK;
+#else
+    ESP_LOGW(TAG, "⚠️  Console is not a UART, serial commands disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
@@ -0,0 +1,29 @@
+/**
+ * Serial Commands
+ *
+ * Line-based commands on the console UART, for the host tools. A line is
+ * NAME or NAME:ARGS (NAME ARGS also accepted); the handler gets ARGS, or
+ * an empty string. Handlers print their reply with printf so it is not
+ * mixed with log prefixes.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#define SERIAL_CMD_MAX_COMMANDS  8
+#define SERIAL_CMD_MAX_LINE      128
+
+typedef void (*serial_cmd_handler_t)(const char *args);
+
+/**
+ * Register a command; name matching is case-insensitive
+ */
+esp_err_t serial_cmd_register(const char *name, serial_cmd_handler_t handler);
+
+/**
+ * Start reading commands from the console UART
+ */
+esp_err_t serial_cmd_start(void);
@@ -0,0 +1,386 @@
+/**
+ * Telemetry Queue Implementation
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_mac.h"
+#include "esp_app_desc.h"
+#include "esp_http_client.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "tls_profile.h"
+#include "telemetry.h"
+
+static const char* TAG = "Telemetry";
+
+// Discord accepts up to 10 embeds per message
+#define TELEMETRY_BATCH_MAX     10
+#define TELEMETRY_PAYLOAD_SIZE  4096
+
+// Clock counts as set by SNTP once it is past 2020-09-13
+#define SNTP_VALID_EPOCH        1600000000
+
+typedef struct {
+    telemetry_level_t level;
+    uint16_t repeat;
+    int64_t uptime_us;
+    time_t time;
+    char title[TELEMETRY_TITLE_LEN];
+    char message[TELEMETRY_MESSAGE_LEN];
+} telemetry_event_t;
+
+static const uint32_t s_level_colors[] = {
+    [TELEMETRY_INFO]    = 5763719,
+    [TELEMETRY_WARNING] = 15105570,
+    [TELEMETRY_ERROR]   = 15158332,
+};
+
+// Ring buffer, shared with posting tasks
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static telemetry_event_t s_events[TELEMETRY_QUEUE_LEN];
+static int s_head;              // Oldest event
+static int s_count;
+static int s_in_flight;         // Oldest events being sent, not merged into
+static uint32_t s_dropped;
+static volatile bool s_connected;
+static uint16_t s_major;
+static uint16_t s_minor;
+
+// Telemetry task only
+static telemetry_config_t s_config;
+static TaskHandle_t s_task;
+static esp_http_client_handle_t s_client;
+static tls_profile_stats_t s_tls_stats = TLS_PROFILE_STATS_INIT("webhook");
+static char s_mac_str[18];
+static telemetry_event_t s_batch[TELEMETRY_BATCH_MAX];
+static char s_payload[TELEMETRY_PAYLOAD_SIZE];
+
+/**
+ * Append src to dst as JSON string content. Returns characters written.
+ */
+static size_t json_escape(char *dst, size_t size, const char *src)
+{
+    size_t n = 0;
+    for (; *src != '\0' && n + 7 < size; src++) {
+        unsigned char c = (unsigned char)*src;
+        if (c == '"' || c == '\\') {
+            dst[n++] = '\\';
+            dst[n++] = c;
+        } else if (c == '\n') {
+            dst[n++] = '\\';
+            dst[n++] = 'n';
+        } else if (c < 0x20) {
+            n += snprintf(dst + n, size - n, "\\u%04x", c);
+        } else {
+            dst[n++] = c;
+        }
+    }
+    dst[n] = '\0';
+    return n;
+}
+
+/**
+ * Event time, back-dated from uptime if it was queued before SNTP synced
+ */
+static time_t event_time(const telemetry_event_t *event)
+{
+    if (event->time >= SNTP_VALID_EPOCH) {
+        return event->time;
+    }
+
+    time_t now = time(NULL);
+    if (now < SNTP_VALID_EPOCH) {
+        return 0;
+    }
+    return now - (time_t)((esp_timer_get_time() - event->uptime_us) / 1000000);
+}
+
+/**
+ * Render one embed at buf. Returns its length, 0 if it does not fit.
+ */
+static size_t format_embed(char *buf, size_t size, const telemetry_event_t *event, bool first)
+{
+    char title[TELEMETRY_TITLE_LEN * 2];
+    char message[TELEMETRY_MESSAGE_LEN * 2];
+    json_escape(title, sizeof(title), event->title);
+    json_escape(message, sizeof(message), event->message);
+
+    char timestamp[40] = "";
+    time_t t = event_time(event);
+    if (t != 0) {
+        struct tm tm_utc;
+        gmtime_r(&t, &tm_utc);
+        strftime(timestamp, sizeof(timestamp), ",\"timestamp\":\"%Y-%m-%dT%H:%M:%SZ\"", &tm_utc);
+    }
+
+    char repeat[48] = "";
+    if (event->repeat > 1) {
+        snprintf(repeat, sizeof(repeat), ",\"footer\":{\"text\":\"repeated %u times\"}", event->repeat);
+    }
+
+    int len = snprintf(buf, size, "%s{\"title\":\"%s\",\"description\":\"%s\",\"color\":%lu%s%s}",
+                       first ? "" : ",", title, message,
+                       (unsigned long)s_level_colors[event->level], timestamp, repeat);
+    return (len > 0 && (size_t)len < size) ? (size_t)len : 0;
+}
+
+/**
+ * Build the batch payload from s_batch. Returns the number of events it holds.
+ */
+static int format_payload(int count, uint32_t dropped)
+{
+    const esp_app_desc_t *app_desc = esp_app_get_description();
+    char drop_note[48] = "";
+    if (dropped > 0) {
+        snprintf(drop_note, sizeof(drop_note), " - %lu events dropped", (unsigned long)dropped);
+    }
+
+    size_t len = snprintf(s_payload, sizeof(s_payload),
+                          "{\"content\":\"iBeacon %s (Major %u, Minor %u, fw %s)%s\",\"embeds\":[",
+                          s_mac_str, s_major, s_minor, app_desc->version, drop_note);
+
+    int included = 0;
+    for (int i = 0; i < count; i++) {
+        // Keep room for the closing brackets
+        size_t n = format_embed(s_payload + len, sizeof(s_payload) - len - 4, &s_batch[i], i == 0);
+        if (n == 0) {
+            break;
+        }
+        len += n;
+        included++;
+    }
+    strcpy(s_payload + len, "]}");
+    return included;
+}
+
+/**
+ * Drop the oldest count events after they were delivered (or rejected)
+ */
+static void commit_batch(int count, uint32_t dropped)
+{
+    taskENTER_CRITICAL(&s_lock);
+    s_head = (s_head + count) % TELEMETRY_QUEUE_LEN;
+    s_count -= count;
+    s_in_flight = 0;
+    s_dropped -= dropped;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static esp_err_t telemetry_http_event_handler(esp_http_client_event_t *evt)
+{
+    tls_profile_http_event(&s_tls_stats, evt);
+    return ESP_OK;
+}
+
+static bool ensure_client(void)
+{
+    if (s_client != NULL) {
+        return true;
+    }
+
+    esp_http_client_config_t config = {
+        .url = s_config.url,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = 10000,
+        .keep_alive_enable = true,
+        .event_handler = telemetry_http_event_handler,
+    };
+    tls_profile_apply(&config);
+    s_client = esp_http_client_init(&config);
+    if (s_client == NULL) {
+        ESP_LOGE(TAG, "Failed to initialize HTTP client");
+        return false;
+    }
+    esp_http_client_set_header(s_client, "Content-Type", "application/json");
+    return true;
+}
+
+/**
+ * Send the oldest queued events as one message.
+ * Returns true if they left the queue.
+ */
+static bool send_batch(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    int count = s_count < TELEMETRY_BATCH_MAX ? s_count : TELEMETRY_BATCH_MAX;
+    for (int i = 0; i < count; i++) {
+        s_batch[i] = s_events[(s_head + i) % TELEMETRY_QUEUE_LEN];
+    }
+    s_in_flight = count;
+    uint32_t dropped = s_dropped;
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (count == 0) {
+        return false;
+    }
+
+    count = format_payload(count, dropped);
+    if (count == 0 || !ensure_client()) {
+        commit_batch(0, 0);
+        return false;
+    }
+
+    esp_http_client_set_post_field(s_client, s_payload, strlen(s_payload));
+    int64_t start = esp_timer_get_time();
+    tls_profile_request_begin(&s_tls_stats);
+    esp_err_t err = esp_http_client_perform(s_client);
+    tls_profile_request_end(&s_tls_stats);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️  Failed to send %d events: %s", count, esp_err_to_name(err));
+        esp_http_client_close(s_client);
+        commit_batch(0, 0);
+        return false;
+    }
+
+    int status_code = esp_http_client_get_status_code(s_client);
+    if (status_code == 200 || status_code == 204) {
+        ESP_LOGI(TAG, "✓ Sent %d events in %lld ms (%d bytes)", count,
+                 (esp_timer_get_time() - start) / 1000, strlen(s_payload));
+        commit_batch(count, dropped);
+        if (s_config.on_delivered != NULL) {
+            s_config.on_delivered(count);
+        }
+        return true;
+    }
+
+    if (status_code == 429 || status_code >= 500) {
+        // Rate limited or server trouble - keep the events for the next flush
+        ESP_LOGW(TAG, "⚠️  Webhook returned status: %d, retrying later", status_code);
+        commit_batch(0, 0);
+        return false;
+    }
+
+    // The payload itself was rejected; resending it would fail forever
+    ESP_LOGE(TAG, "✗ Webhook error: HTTP %d, dropping %d events", status_code, count);
+    commit_batch(count, dropped);
+    return true;
+}
+
+static void telemetry_task(void *pvParameter)
+{
+    while (1) {
+        // Woken early by telemetry_flush()
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(s_config.flush_interval_ms));
+
+        while (s_connected && s_count > 0) {
+            if (!send_batch()) {
+                break;
+            }
+        }
+    }
+}
+
+esp_err_t telemetry_start(const telemetry_config_t *config)
+{
+    if (config == NULL || config->url == NULL || config->flush_interval_ms == 0 || s_task != NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_config = *config;
+    telemetry_set_device(config->major, config->minor);
+
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(s_mac_str, sizeof(s_mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    // TLS handshake needs a large stack
+    if (xTaskCreate(telemetry_task, "telemetry", 12288, NULL, 3, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "✓ Telemetry started (flush every %lu ms, %d event queue)",
+             (unsigned long)config->flush_interval_ms, TELEMETRY_QUEUE_LEN);
+    return ESP_OK;
+}
+
+void telemetry_post(telemetry_level_t level, const char *title, const char *message)
+{
+    if (message == NULL) {
+        message = "";
+    }
+
+    int64_t uptime_us = esp_timer_get_time();
+    time_t now = time(NULL);
+    bool dropped = false;
+
+    taskENTER_CRITICAL(&s_lock);
+    telemetry_event_t *newest = s_count > s_in_flight
+            ? &s_events[(s_head + s_count - 1) % TELEMETRY_QUEUE_LEN] : NULL;
+
+    if (newest != NULL && newest->level == level &&
+        strncmp(newest->title, title, sizeof(newest->title) - 1) == 0 &&
+        strncmp(newest->message, message, sizeof(newest->message) - 1) == 0) {
+        // Same as the newest queued event - merge
+        if (newest->repeat < UINT16_MAX) {
+            newest->repeat++;
+        }
+        newest->uptime_us = uptime_us;
+        newest->time = now;
+    } else if (s_count == TELEMETRY_QUEUE_LEN) {
+        s_dropped++;
+        dropped = true;
+    } else {
+        telemetry_event_t *event = &s_events[(s_head + s_count) % TELEMETRY_QUEUE_LEN];
+        event->level = level;
+        event->repeat = 1;
+        event->uptime_us = uptime_us;
+        event->time = now;
+        strlcpy(event->title, title, sizeof(event->title));
+        strlcpy(event->message, message, sizeof(event->message));
+        s_count++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (dropped) {
+        ESP_LOGW(TAG, "⚠️  Queue full, dropped: %s", title);
+    }
+}
+
+void telemetry_set_connected(bool connected)
+{
+    bool was_connected = s_connected;
+    s_connected = connected;
+    if (connected && !was_connected && s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+void telemetry_set_device(uint16_t major, uint16_t minor)
+{
+    taskENTER_CRITICAL(&s_lock);
+    s_major = major;
+    s_minor = minor;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t telemetry_flush(uint32_t timeout_ms)
+{
+    if (s_task == NULL || !s_connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xTaskNotifyGive(s_task);
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (s_count > 0) {
+        if (esp_timer_get_time() >= deadline) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    return ESP_OK;
+}
+
+const tls_profile_stats_t *telemetry_tls_stats(void)
+{
+    return &s_tls_stats;
+}
@@ -0,0 +1,86 @@
+/**
+ * Telemetry Queue
+ *
+ * Non-blocking status reporting to a Discord webhook. Any task can post an
+ * event; it is copied into a bounded ring buffer and the call returns at
+ * once. A dedicated task sends everything queued as one HTTPS POST (one
+ * embed per event) every flush interval, over a single keep-alive client
+ * so the TLS session is set up once rather than per message.
+ *
+ * A post identical to the newest queued event only bumps its repeat
+ * count. When the ring is full new events are dropped, and the number of
+ * drops is reported with the next batch. Events stay queued while the
+ * network is down and are delivered once telemetry_set_connected(true).
+ *
+ * Without CONFIG_BEACON_TELEMETRY the calls below compile to nothing, so
+ * modules that report events need no build-profile checks of their own.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "tls_profile.h"
+
+#define TELEMETRY_QUEUE_LEN     16
+#define TELEMETRY_TITLE_LEN     48
+#define TELEMETRY_MESSAGE_LEN   256
+
+typedef enum {
+    TELEMETRY_INFO,             // Green embed
+    TELEMETRY_WARNING,          // Orange embed
+    TELEMETRY_ERROR,            // Red embed
+} telemetry_level_t;
+
+typedef struct {
+    const char *url;            // Discord webhook URL
+    uint32_t flush_interval_ms;
+    uint16_t major;             // Reported with every batch
+    uint16_t minor;
+    void (*on_delivered)(int events);   // Optional, called from the telemetry task
+} telemetry_config_t;
+
+#if CONFIG_BEACON_TELEMETRY
+/**
+ * Start the telemetry task. Events posted before this are kept.
+ */
+esp_err_t telemetry_start(const telemetry_config_t *config);
+
+/**
+ * Queue an event; never blocks. message may be NULL.
+ */
+void telemetry_post(telemetry_level_t level, const char *title, const char *message);
+
+/**
+ * Tell the queue whether the network is up (from the Wi-Fi event handler)
+ */
+void telemetry_set_connected(bool connected);
+
+/**
+ * Update the beacon identity reported with each batch
+ */
+void telemetry_set_device(uint16_t major, uint16_t minor);
+
+/**
+ * Send queued events now and wait until the queue is empty.
+ * Returns ESP_ERR_TIMEOUT if events are still queued after timeout_ms.
+ */
+esp_err_t telemetry_flush(uint32_t timeout_ms);
+
+/**
+ * Connection stats of the webhook client
+ */
+const tls_profile_stats_t *telemetry_tls_stats(void);
+
+#else
+
+static inline void telemetry_post(telemetry_level_t level, const char *title, const char *message) {}
+static inline void telemetry_set_connected(bool connected) {}
+static inline void telemetry_set_device(uint16_t major, uint16_t minor) {}
+static inline esp_err_t telemetry_flush(uint32_t timeout_ms) { return ESP_OK; }
+
+#endif
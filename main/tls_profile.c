@@ -0,0 +1,122 @@
+/**
+ * TLS Profile Implementation
+ *
+ * @license MIT
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+#include "esp_tls.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "tls_profile.h"
+
+static const char* TAG = "TLS";
+
+#if TLS_PINNED_CA
+// main/certs/pinned_ca.pem, embedded by CMakeLists.txt when present
+extern const uint8_t pinned_ca_pem_start[] asm("_binary_pinned_ca_pem_start");
+extern const uint8_t pinned_ca_pem_end[]   asm("_binary_pinned_ca_pem_end");
+#endif
+
+esp_err_t tls_profile_init(void)
+{
+#if TLS_PINNED_CA
+    esp_err_t err = esp_tls_set_global_ca_store(pinned_ca_pem_start, pinned_ca_pem_end - pinned_ca_pem_start);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to load pinned CA set: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "✓ Using pinned CA set (%d bytes)", (int)(pinned_ca_pem_end - pinned_ca_pem_start));
+#elif CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    ESP_LOGI(TAG, "Using the certificate bundle (no certs/pinned_ca.pem)");
+#else
+    ESP_LOGW(TAG, "⚠️  No CA set (bundle disabled, no certs/pinned_ca.pem): HTTPS servers cannot be verified");
+#endif
+    return ESP_OK;
+}
+
+void tls_profile_apply(esp_http_client_config_t *config)
+{
+#if TLS_PINNED_CA
+    config->use_global_ca_store = true;
+    config->crt_bundle_attach = NULL;
+#elif CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    config->crt_bundle_attach = esp_crt_bundle_attach;
+#endif
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    config->save_client_session = true;
+#endif
+}
+
+static void stop_monitor(tls_profile_stats_t *stats)
+{
+    if (stats->monitoring) {
+        heap_caps_monitor_local_minimum_free_size_stop();
+        stats->monitoring = false;
+    }
+}
+
+void tls_profile_request_begin(tls_profile_stats_t *stats)
+{
+    stop_monitor(stats);
+    stats->start_us = esp_timer_get_time();
+    stats->heap_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+
+    // One monitor for the whole heap - skipped while another client connects
+    stats->monitoring = heap_caps_monitor_local_minimum_free_size_start() == ESP_OK;
+}
+
+void tls_profile_http_event(tls_profile_stats_t *stats, const esp_http_client_event_t *evt)
+{
+    if (stats == NULL || evt->event_id != HTTP_EVENT_ON_CONNECTED) {
+        return;
+    }
+
+    uint32_t connect_ms = (esp_timer_get_time() - stats->start_us) / 1000;
+    stats->connects++;
+    stats->last_connect_ms = connect_ms;
+    if (connect_ms > stats->max_connect_ms) {
+        stats->max_connect_ms = connect_ms;
+    }
+
+    size_t heap_used = 0;
+    if (stats->monitoring) {
+        size_t min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+        heap_used = stats->heap_before > min_free ? stats->heap_before - min_free : 0;
+        if (heap_used > stats->peak_heap_bytes) {
+            stats->peak_heap_bytes = heap_used;
+        }
+        stop_monitor(stats);
+    }
+
+    // ESP-IDF reports the high water mark in bytes
+    uint32_t stack_free = uxTaskGetStackHighWaterMark(NULL);
+    if (stack_free < stats->min_stack_free) {
+        stats->min_stack_free = stack_free;
+    }
+
+    ESP_LOGI(TAG, "%s connected in %lu ms (heap used %u bytes, stack free %lu bytes)",
+             stats->name, (unsigned long)connect_ms, (unsigned)heap_used, (unsigned long)stack_free);
+}
+
+void tls_profile_request_end(tls_profile_stats_t *stats)
+{
+    stop_monitor(stats);
+}
+
+void tls_profile_log_stats(const tls_profile_stats_t *stats)
+{
+    ESP_LOGI(TAG, "%s: %lu connects, last %lu ms, max %lu ms, peak heap %u bytes, min stack free %lu bytes",
+             stats->name, (unsigned long)stats->connects, (unsigned long)stats->last_connect_ms,
+             (unsigned long)stats->max_connect_ms, (unsigned)stats->peak_heap_bytes,
+             (unsigned long)(stats->connects > 0 ? stats->min_stack_free : 0));
+}
@@ -0,0 +1,76 @@
+/**
+ * TLS Profile
+ *
+ * One TLS setup for every HTTP client in the firmware (webhook and OTA):
+ * - Trust: the pinned CA set in certs/pinned_ca.pem when the file exists
+ *   (loaded once into the esp-tls global CA store), otherwise the
+ *   common-CA certificate bundle
+ * - Session tickets: each client keeps its TLS session, so reconnects on
+ *   a keep-alive client resume instead of doing a full handshake
+ *
+ * Per-client connection stats record how long each new connection took to
+ * come up (DNS + TCP + TLS) and the heap it used while connecting, plus the
+ * lowest free stack seen in the calling task, to size task stacks.
+ *
+ * The stats type is always available (metrics prints it); the client
+ * helpers exist only in builds with CONFIG_BEACON_WIFI.
+ *
+ * @license MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#if CONFIG_BEACON_WIFI
+#include "esp_http_client.h"
+#endif
+
+typedef struct {
+    const char *name;
+    uint32_t connects;          // New connections (keep-alive reuse not counted)
+    uint32_t last_connect_ms;
+    uint32_t max_connect_ms;
+    size_t peak_heap_bytes;     // Largest heap use while a connection came up
+    uint32_t min_stack_free;    // Lowest free stack of the calling task, bytes
+
+    // Request in progress
+    int64_t start_us;
+    size_t heap_before;
+    bool monitoring;
+} tls_profile_stats_t;
+
+#define TLS_PROFILE_STATS_INIT(label) { .name = (label), .min_stack_free = UINT32_MAX }
+
+#if CONFIG_BEACON_WIFI
+
+/**
+ * Load the pinned CA set, if built in. Call once before any client.
+ */
+esp_err_t tls_profile_init(void);
+
+/**
+ * Fill in trust and session settings of an HTTP client config
+ */
+void tls_profile_apply(esp_http_client_config_t *config);
+
+/**
+ * Call before each request on a client
+ */
+void tls_profile_request_begin(tls_profile_stats_t *stats);
+
+/**
+ * Call from the client's HTTP event handler
+ */
+void tls_profile_http_event(tls_profile_stats_t *stats, const esp_http_client_event_t *evt);
+
+/**
+ * Call once the request (or session) is over
+ */
+void tls_profile_request_end(tls_profile_stats_t *stats);
+
+void tls_profile_log_stats(const tls_profile_stats_t *stats);
+#endif
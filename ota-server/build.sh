@@ -9,18 +9,61 @@ cd /project
 # Source IDF environment
 . $IDF_PATH/export.sh
 
-# Clean build cache if it exists (to avoid path conflicts)
-if [ -d "build" ]; then
-    echo "🧹 Cleaning previous build cache..."
-    idf.py fullclean
+# Build directory and ccache live on a persistent volume, so only the
+# components that changed since the last build are recompiled
+BUILD_CACHE=${BUILD_CACHE:-/build-cache}
+BUILD_DIR="$BUILD_CACHE/build"
+export IDF_CCACHE_ENABLE=1
+export CCACHE_DIR="$BUILD_CACHE/ccache"
+mkdir -p "$BUILD_DIR" "$CCACHE_DIR"
+
+# A cache configured for another source tree cannot be reused
+if [ -f "$BUILD_DIR/CMakeCache.txt" ] && \
+   ! grep -q "^CMAKE_HOME_DIRECTORY:INTERNAL=/project$" "$BUILD_DIR/CMakeCache.txt"; then
+    echo "🧹 Build cache belongs to another project, starting clean..."
+    rm -rf "$BUILD_DIR"
+fi
+
+if [ -f "$BUILD_DIR/CMakeCache.txt" ]; then
+    echo "♻️  Incremental build (cache: $BUILD_DIR)"
+else
+    echo "🆕 Clean build (cache: $BUILD_DIR)"
 fi
 
 # Build the project
-idf.py build
+idf.py -B "$BUILD_DIR" build
+ccache -s | grep -iE "hits|misses" || true
+
+# Everything is published with a rename, so the server (or a restart)
+# never reads a half-copied file
+publish() {
+    cp "$1" "$2.tmp"
+    mv -f "$2.tmp" "$2"
+}
+
+# Section sizes for the server's benchmark history
+SIZE_JSON="$BUILD_DIR/size.json"
+idf.py -B "$BUILD_DIR" size --format json --output-file "$SIZE_JSON" || rm -f "$SIZE_JSON"
+
+# Keep a copy keyed by commit so the server can republish it without
+# rebuilding; written first, so the copy exists once the image is live
+FIRMWARE="$BUILD_DIR/esp32-ibeacon-transmitter.bin"
+if [ -n "$BUILD_COMMIT" ]; then
+    mkdir -p /firmware/builds
+    publish "$FIRMWARE" "/firmware/builds/$BUILD_COMMIT.bin"
+    if [ -f "$SIZE_JSON" ]; then
+        publish "$SIZE_JSON" "/firmware/builds/$BUILD_COMMIT.size.json"
+    fi
+fi
 
 # Copy firmware to output directory
 echo "📦 Copying firmware to /firmware..."
-cp build/esp32-ibeacon-transmitter.bin /firmware/beacon_firmware.bin
+if [ -f "$SIZE_JSON" ]; then
+    publish "$SIZE_JSON" /firmware/beacon_firmware.size.json
+else
+    rm -f /firmware/beacon_firmware.size.json
+fi
+publish "$FIRMWARE" /firmware/beacon_firmware.bin
 
 echo "✅ Build complete!"
 ls -lh /firmware/beacon_firmware.bin
@@ -1,57 +1,554 @@
 package main
 
 import (
+	"bytes"
+	"compress/gzip"
+	"compress/zlib"
+	"context"
+	"crypto/ecdsa"
+	"crypto/elliptic"
+	"crypto/rand"
+	"crypto/sha256"
+	"crypto/x509"
+	"encoding/binary"
+	"encoding/hex"
+	"encoding/json"
+	"encoding/pem"
+	"errors"
 	"fmt"
+	"hash/fnv"
 	"log"
+	"net"
 	"net/http"
 	"os"
 	"os/exec"
 	"path/filepath"
+	"slices"
+	"sort"
+	"strconv"
 	"strings"
 	"sync"
 	"time"
 )
 
 const (
-	port          = "8080"
-	firmwarePath  = "/firmware"
-	firmwareFile  = "beacon_firmware.bin"
-	projectPath   = "/project"
-	gitBranch     = "main"
-	checkInterval = 1 * time.Hour
+	port           = "8080"
+	firmwarePath   = "/firmware"
+	firmwareFile   = "beacon_firmware.bin"
+	compressedFile = "beacon_firmware.bin.z"
+	projectPath    = "/project"
+	gitBranch      = "main"
+	checkInterval  = 1 * time.Hour
+
+	// Builds are kept per commit under firmwarePath/buildsDir so a commit
+	// that was built before is republished without running the builder
+	buildsDir        = "builds"
+	keepBuilds       = 10
+	buildCacheVolume = "ota-server_build-cache"
+	buildHistorySize = 10
+
+	// Published builds live in a content-addressed store,
+	// firmwarePath/storeDir/<sha256>.bin (and .bin.z). channelsFile says
+	// which build each channel serves and which devices follow which
+	// channel; builds no channel serves are pruned beyond keepStored.
+	storeDir      = "store"
+	channelsFile  = "channels.json"
+	keepStored    = 10
+	channelStable = "stable"
+	channelCanary = "canary"
+
+	// Long-poll limits for /version/wait
+	longPollDefault = 5 * time.Minute
+	longPollMax     = 30 * time.Minute
+
+	// Rollout defaults, overridable with ROLLOUT_WAVES,
+	// ROLLOUT_WAVE_INTERVAL and MAX_CONCURRENT_DOWNLOADS
+	defaultRolloutWaves      = 4
+	defaultWaveInterval      = 10 * time.Minute
+	defaultMaxDownloads      = 8
+	downloadRetryAfterBase   = 30 // seconds, plus a per-device spread
+	downloadRetryAfterSpread = 30
+
+	// Compressed image framing (see main/ota_image.h on the firmware side)
+	compressedMagic     = "BOTZ"
+	compressedVersion   = 1
+	compressedChunkSize = 64 * 1024
+
+	// Signed image manifest (see main/ota_manifest.h on the firmware side).
+	// The ECDSA P-256 signing key is read from MANIFEST_KEY, or created in
+	// firmwarePath on first start together with the public key to build in.
+	manifestFile       = "beacon_firmware.manifest"
+	manifestMagic      = "BOTM"
+	manifestVersion    = 1
+	manifestChunkSize  = 16 * 1024
+	manifestHeaderSize = 84
+	manifestKeyFile    = "manifest_key.pem"
+	manifestPubFile    = "manifest_pub.pem"
+
+	// Gateway reports (see main/beacon_scan.h on the firmware side)
+	gatewaySightingTTL = 5 * time.Minute
+	maxGatewayReport   = 256 * 1024
+
+	// Benchmark history: one record per commit, persisted in firmwarePath.
+	// sizeFile is `idf.py size --format json` of the build (see build.sh).
+	benchmarksFile        = "benchmarks.json"
+	sizeFile              = "beacon_firmware.size.json"
+	benchmarkHistorySize  = 500
+	benchmarkDeviceRuns   = 16       // Device results kept per commit
+	defaultOTASlotSize    = 0x1E0000 // ota_0 in partitions_ota.csv
+	defaultBootRegression = 10       // Percent, overridable with BOOT_REGRESSION_PCT
+	bootRegressionMinMs   = 20       // Smaller changes are noise
+	maxDeviceBenchmark    = 4 * 1024
+
+	// Connection limits, overridable with MAX_CONNECTIONS and
+	// MAX_CONNECTIONS_PER_IP. Beacons behind one NAT share an address, so
+	// the per-address limit is generous; each device (X-Device-MAC) gets
+	// one download at a time.
+	defaultMaxConnections = 1024
+	defaultMaxConnsPerIP  = 64
+
+	// No server-wide write timeout: long-polls and BLE-paced downloads are
+	// slow by design. Downloads get their own deadline instead; a cut one
+	// resumes with Range.
+	readHeaderTimeout    = 10 * time.Second
+	idleTimeout          = 2 * time.Minute // Version check and download share a connection
+	tcpKeepAlive         = 30 * time.Second
+	maxHeaderBytes       = 16 * 1024
+	downloadWriteTimeout = 15 * time.Minute
 )
 
 type ServerState struct {
 	sync.RWMutex
-	LastGitCommit  string
-	LastBuildTime  time.Time
-	LastCheckTime  time.Time
+	LastGitCommit   string
+	LastBuildTime   time.Time
+	LastCheckTime   time.Time
 	BuildInProgress bool
-	FirmwareSize   int64
-	BuildError     string
+	FirmwareSize    int64
+	CompressedSize  int64
+	BuildError      string
+	BuildHistory    []buildRecord // Newest first
+}
+
+// buildRecord describes one build attempt for /status
+type buildRecord struct {
+	Commit       string    `json:"commit"`
+	Started      time.Time `json:"started"`
+	BuildMs      int64     `json:"buildMs"`
+	CompressMs   int64     `json:"compressMs"`
+	Cached       bool      `json:"cached"` // Republished from builds/ without compiling
+	Success      bool      `json:"success"`
+	FirmwareSize int64     `json:"firmwareSize"`
+}
+
+func (s *ServerState) recordBuild(rec buildRecord) {
+	s.BuildHistory = append([]buildRecord{rec}, s.BuildHistory...)
+	if len(s.BuildHistory) > buildHistorySize {
+		s.BuildHistory = s.BuildHistory[:buildHistorySize]
+	}
 }
 
 var state = &ServerState{}
 
+// Benchmark flags. An image over the slot is never published; a boot
+// regression holds the rollout at the waves that were already open.
+const (
+	flagOverOTASlot    = "over-ota-slot"
+	flagBootRegression = "boot-regression"
+)
+
+// benchmarkRecord is one commit in the /benchmarks time series
+type benchmarkRecord struct {
+	Commit      string            `json:"commit"`
+	Version     string            `json:"version"`
+	Built       time.Time         `json:"built"`
+	Dirty       bool              `json:"dirty,omitempty"` // Built from a modified work tree
+	BuildMs     int64             `json:"buildMs"`
+	ImageSize   int64             `json:"imageSize"`
+	OTASlot     int64             `json:"otaSlot"`
+	Sections    map[string]int64  `json:"sections,omitempty"` // From idf.py size
+	Devices     []deviceBenchmark `json:"devices,omitempty"`
+	BootToAdvMs int64             `json:"bootToAdvMs,omitempty"` // Median over Devices
+	FreeHeap    int64             `json:"freeHeap,omitempty"`    // Median over Devices
+	Flags       []string          `json:"flags,omitempty"`
+}
+
+// deviceBenchmark is one run of the build on a test device
+type deviceBenchmark struct {
+	MAC         string    `json:"mac"`
+	BootToAdvMs int64     `json:"bootToAdvMs"`
+	FreeHeap    int64     `json:"freeHeap"`
+	MinFreeHeap int64     `json:"minFreeHeap"`
+	Reported    time.Time `json:"reported"`
+}
+
+// Keys kept from `idf.py size --format json`
+var sizeSections = []string{"flash_code", "flash_rodata", "used_dram", "dram_data", "dram_bss", "used_iram"}
+
+var benchmarks = struct {
+	sync.Mutex
+	records []benchmarkRecord // Oldest first
+}{}
+
+// firmwareImage is one published build, loaded into memory once and never
+// modified afterwards. Handlers get it from the store (imageFor), so
+// serving /version and the images costs no disk I/O and publishing a build
+// swaps it atomically.
+type firmwareImage struct {
+	data           []byte
+	compressed     []byte // nil when the compressed image is missing
+	version        string
+	modTime        time.Time
+	sha256         string
+	appHash        string // What the beacon reports running it (X-Firmware-SHA256)
+	etag           string // Quoted SHA-256 of data
+	compressedETag string // Quoted SHA-256 of compressed
+	manifest       []byte // nil when there is no signing key
+	manifestETag   string
+	gzipped        []byte // data with gzip, for clients that accept it
+	gzipETag       string
+}
+
+// signingKey signs the manifest of every published build
+var signingKey *ecdsa.PrivateKey
+
+// storedBuild is one image in the store
+type storedBuild struct {
+	SHA256  string    `json:"sha256"`  // Of the image file, which is named after it
+	AppHash string    `json:"appHash"` // See firmwareImage
+	Version string    `json:"version"`
+	Commit  string    `json:"commit,omitempty"`
+	Size    int64     `json:"size"`
+	Added   time.Time `json:"added"`
+}
+
+// channelConfig is channelsFile. A device follows the channel of its MAC,
+// else of its beacon major, else canary when its MAC hashes into
+// CanaryPercent, else stable; a channel with no build serves stable.
+type channelConfig struct {
+	Channels      map[string]string `json:"channels"` // Channel -> build SHA-256
+	CanaryPercent int               `json:"canaryPercent"`
+	MACs          map[string]string `json:"macs,omitempty"`   // Device MAC -> channel
+	Majors        map[string]string `json:"majors,omitempty"` // Beacon major -> channel
+	Builds        []storedBuild     `json:"builds"`           // Oldest first
+}
+
+var channelNames = []string{channelStable, channelCanary}
+
+// store holds the channel configuration and the loaded image of each
+// channel; channels on the same build share one image
+var store = struct {
+	sync.RWMutex
+	config channelConfig
+	images map[string]*firmwareImage
+}{images: make(map[string]*firmwareImage)}
+
+// buildNotifier wakes every long-poll waiter when a build is published.
+// Waiters grab the current channel; broadcast closes it and installs a
+// fresh one for the next build.
+type buildNotifier struct {
+	mu sync.Mutex
+	ch chan struct{}
+}
+
+func (n *buildNotifier) wait() <-chan struct{} {
+	n.mu.Lock()
+	defer n.mu.Unlock()
+	return n.ch
+}
+
+func (n *buildNotifier) broadcast() {
+	n.mu.Lock()
+	defer n.mu.Unlock()
+	close(n.ch)
+	n.ch = make(chan struct{})
+}
+
+var notifier = &buildNotifier{ch: make(chan struct{})}
+
+// rolloutScheduler spreads a new build across the fleet. Devices are
+// hashed by MAC into waves that open waveInterval apart after the build is
+// published, and concurrent downloads are capped by a slot semaphore.
+type rolloutScheduler struct {
+	sync.RWMutex
+	publishedAt  time.Time
+	waves        int
+	waveInterval time.Duration
+	heldWaves    int // Non-zero: only this many waves open until the next build
+	slots        chan struct{}
+	downloading  map[string]bool // By MAC
+}
+
+func newRolloutScheduler() *rolloutScheduler {
+	waves := envInt("ROLLOUT_WAVES", defaultRolloutWaves)
+	if waves < 1 {
+		waves = 1
+	}
+	interval := defaultWaveInterval
+	if d, err := time.ParseDuration(os.Getenv("ROLLOUT_WAVE_INTERVAL")); err == nil && d >= 0 {
+		interval = d
+	}
+	maxDownloads := envInt("MAX_CONCURRENT_DOWNLOADS", defaultMaxDownloads)
+	if maxDownloads < 1 {
+		maxDownloads = 1
+	}
+
+	return &rolloutScheduler{
+		waves:        waves,
+		waveInterval: interval,
+		slots:        make(chan struct{}, maxDownloads),
+		downloading:  make(map[string]bool),
+	}
+}
+
+var rollout = newRolloutScheduler()
+
+// gatewayReport is one POST from a gateway: its counters for the period
+// and a batch of the beacons it heard (large periods arrive in several)
+type gatewayReport struct {
+	Gateway struct {
+		MAC   string `json:"mac"`
+		Major int    `json:"major"`
+		Minor int    `json:"minor"`
+	} `json:"gateway"`
+	PeriodMs       int64            `json:"period_ms"`
+	AdvReports     uint64           `json:"adv_reports"`
+	IBeaconReports uint64           `json:"ibeacon_reports"`
+	Dropped        uint64           `json:"dropped"`
+	Beacons        []beaconSighting `json:"beacons"`
+}
+
+type beaconSighting struct {
+	UUID     string    `json:"uuid"`
+	Major    int       `json:"major"`
+	Minor    int       `json:"minor"`
+	RSSI     int       `json:"rssi"`
+	RSSIMax  int       `json:"rssi_max"`
+	Count    int       `json:"count"`
+	GapMs    int       `json:"gap_ms"`     // Mean time between packets
+	GapMaxMs int       `json:"gap_max_ms"` // Longest, i.e. worst advertising jitter
+	Missed   int       `json:"missed"`     // Advertising events not heard
+	AgeMs    int64     `json:"age_ms,omitempty"`
+	LastSeen time.Time `json:"lastSeen"`
+}
+
+// gatewayState merges a gateway's reports: latest sighting per beacon
+type gatewayState struct {
+	MAC        string                     `json:"mac"`
+	Major      int                        `json:"major"`
+	Minor      int                        `json:"minor"`
+	LastReport time.Time                  `json:"lastReport"`
+	Dropped    uint64                     `json:"dropped"` // Latest period
+	Beacons    map[string]*beaconSighting `json:"beacons"` // By uuid/major/minor
+}
+
+var gateways = struct {
+	sync.Mutex
+	m map[string]*gatewayState
+}{m: make(map[string]*gatewayState)}
+
+func envInt(name string, fallback int) int {
+	if v, err := strconv.Atoi(os.Getenv(name)); err == nil {
+		return v
+	}
+	return fallback
+}
+
+func macHash(mac string) uint32 {
+	h := fnv.New32a()
+	h.Write([]byte(strings.ToUpper(strings.TrimSpace(mac))))
+	return h.Sum32()
+}
+
+// publish restarts the wave schedule for a freshly built image
+func (s *rolloutScheduler) publish() {
+	s.Lock()
+	s.publishedAt = time.Now()
+	s.heldWaves = 0
+	s.Unlock()
+}
+
+// hold keeps the waves that have not opened yet closed until the next build
+func (s *rolloutScheduler) hold() {
+	open := s.openWaves()
+	s.Lock()
+	if s.heldWaves == 0 {
+		s.heldWaves = open
+	}
+	s.Unlock()
+}
+
+func (s *rolloutScheduler) held() bool {
+	s.RLock()
+	defer s.RUnlock()
+	return s.heldWaves > 0
+}
+
+// wave returns the device's wave; devices without a MAC go last
+func (s *rolloutScheduler) wave(mac string) int {
+	if mac == "" {
+		return s.waves - 1
+	}
+	return int(macHash(mac) % uint32(s.waves))
+}
+
+// waitFor returns how long the device must wait for its wave to open
+func (s *rolloutScheduler) waitFor(mac string) time.Duration {
+	s.RLock()
+	defer s.RUnlock()
+	if s.publishedAt.IsZero() {
+		return 0
+	}
+	if s.heldWaves > 0 && s.wave(mac) >= s.heldWaves {
+		return max(s.waveInterval, time.Minute)
+	}
+	opens := s.publishedAt.Add(time.Duration(s.wave(mac)) * s.waveInterval)
+	if wait := time.Until(opens); wait > 0 {
+		return wait
+	}
+	return 0
+}
+
+// openWaves reports how many waves may download the current build
+func (s *rolloutScheduler) openWaves() int {
+	s.RLock()
+	defer s.RUnlock()
+	open := s.waves
+	if !s.publishedAt.IsZero() && s.waveInterval > 0 {
+		open = min(open, int(time.Since(s.publishedAt)/s.waveInterval)+1)
+	}
+	if s.heldWaves > 0 {
+		open = min(open, s.heldWaves)
+	}
+	return open
+}
+
+func (s *rolloutScheduler) acquire() bool {
+	select {
+	case s.slots <- struct{}{}:
+		return true
+	default:
+		return false
+	}
+}
+
+func (s *rolloutScheduler) release() {
+	<-s.slots
+}
+
+// claimDevice marks mac as downloading; false if it already is. Requests
+// without a MAC are not tracked.
+func (s *rolloutScheduler) claimDevice(mac string) bool {
+	if mac == "" {
+		return true
+	}
+	s.Lock()
+	defer s.Unlock()
+	if s.downloading[mac] {
+		return false
+	}
+	s.downloading[mac] = true
+	return true
+}
+
+func (s *rolloutScheduler) releaseDevice(mac string) {
+	s.Lock()
+	delete(s.downloading, mac)
+	s.Unlock()
+}
+
+// busyRetryAfter spreads devices turned away for lack of a slot
+func busyRetryAfter(mac string) int {
+	return downloadRetryAfterBase + int(macHash(mac)%downloadRetryAfterSpread)
+}
+
+// acquireDownloadSlot takes a download slot or answers 503 with Retry-After.
+// Callers must call releaseDownloadSlot(w, r) when it returns true.
+func acquireDownloadSlot(w http.ResponseWriter, r *http.Request) bool {
+	mac := r.Header.Get("X-Device-MAC")
+	retry := busyRetryAfter(mac)
+
+	// A second download from the same device is a retry racing a
+	// connection the server has not seen die yet
+	if !rollout.claimDevice(mac) {
+		log.Printf("⏳ %s (%s) is already downloading, retry in %ds", r.RemoteAddr, mac, retry)
+		w.Header().Set("Retry-After", strconv.Itoa(retry))
+		http.Error(w, "Download already in progress", http.StatusServiceUnavailable)
+		return false
+	}
+	if rollout.acquire() {
+		// A beacon that stops reading gives the slot back
+		http.NewResponseController(w).SetWriteDeadline(time.Now().Add(downloadWriteTimeout))
+		return true
+	}
+	rollout.releaseDevice(mac)
+	log.Printf("⏳ Download slots full, %s (%s) retry in %ds", r.RemoteAddr, mac, retry)
+	w.Header().Set("Retry-After", strconv.Itoa(retry))
+	http.Error(w, "Too many concurrent downloads", http.StatusServiceUnavailable)
+	return false
+}
+
+// releaseDownloadSlot also clears the download's write deadline: without a
+// server WriteTimeout, net/http never resets it, and the next request on
+// the keep-alive connection (a long-poll, say) would be cut off by it.
+func releaseDownloadSlot(w http.ResponseWriter, r *http.Request) {
+	http.NewResponseController(w).SetWriteDeadline(time.Time{})
+	rollout.releaseDevice(r.Header.Get("X-Device-MAC"))
+	rollout.release()
+}
+
 func main() {
+	key, err := loadSigningKey()
+	if err != nil {
+		log.Printf("⚠️  Manifest signing disabled: %v", err)
+	}
+	signingKey = key
+
+	loadBenchmarks()
+
+	// Serve the published builds until the first build finishes
+	loadStore()
+
 	// Start git monitor
 	go gitMonitor()
 
-	// HTTP handlers
-	http.HandleFunc("/beacon_firmware.bin", serveFirmware)
-	http.HandleFunc("/version", versionCheckHandler)
-	http.HandleFunc("/health", healthCheck)
-	http.HandleFunc("/status", statusHandler)
-	http.HandleFunc("/build", manualBuildHandler)
-	http.HandleFunc("/", rootHandler)
+	// HTTP handlers; the images are gzip-negotiated in serveFirmware
+	mux := http.NewServeMux()
+	mux.HandleFunc("/beacon_firmware.bin", serveFirmware)
+	mux.HandleFunc("/"+compressedFile, serveCompressedFirmware)
+	mux.HandleFunc("/"+manifestFile, serveManifest)
+	mux.HandleFunc("/version", versionCheckHandler)
+	mux.HandleFunc("/version/wait", versionWaitHandler)
+	mux.HandleFunc("/health", healthCheck)
+	mux.HandleFunc("/status", withGzip(statusHandler))
+	mux.HandleFunc("/build", manualBuildHandler)
+	mux.HandleFunc("/gateway/report", withGzip(gatewayReportHandler))
+	mux.HandleFunc("/benchmarks", withGzip(benchmarksHandler))
+	mux.HandleFunc("/channels", withGzip(channelsHandler))
+	mux.HandleFunc("/channels/promote", promoteHandler)
+	mux.HandleFunc("/", withGzip(rootHandler))
+
+	server := &http.Server{
+		Handler:           logRequest(mux),
+		ReadHeaderTimeout: readHeaderTimeout,
+		IdleTimeout:       idleTimeout,
+		MaxHeaderBytes:    maxHeaderBytes,
+	}
+	ln, err := (&net.ListenConfig{KeepAlive: tcpKeepAlive}).Listen(context.Background(), "tcp", ":"+port)
+	if err != nil {
+		log.Fatal(err)
+	}
+	connections = newLimitListener(ln,
+		envInt("MAX_CONNECTIONS", defaultMaxConnections),
+		envInt("MAX_CONNECTIONS_PER_IP", defaultMaxConnsPerIP))
 
 	log.Printf("🚀 OTA Server starting on port %s", port)
 	log.Printf("📁 Project path: %s", projectPath)
 	log.Printf("📁 Firmware path: %s", firmwarePath)
 	log.Printf("🔄 Git monitor: checking %s branch every %v", gitBranch, checkInterval)
+	log.Printf("🔌 Connections: %d max, %d per address", cap(connections.total), connections.perIP)
 	log.Println("✅ Server ready")
 
-	if err := http.ListenAndServe(":"+port, logRequest(http.DefaultServeMux)); err != nil {
+	if err := server.Serve(connections); err != nil {
 		log.Fatal(err)
 	}
 }
@@ -101,6 +598,81 @@ func checkAndBuild() {
 	}
 }
 
+// workTreeDirty reports uncommitted changes, which make a build
+// unrepeatable from its commit alone
+func workTreeDirty() bool {
+	output, err := exec.Command("git", "-C", projectPath, "status", "--porcelain", "--untracked-files=no").Output()
+	return err != nil || len(bytes.TrimSpace(output)) > 0
+}
+
+func shortCommit(commit string) string {
+	if len(commit) > 8 {
+		return commit[:8]
+	}
+	return commit
+}
+
+func copyFile(src, dst string) error {
+	data, err := os.ReadFile(src)
+	if err != nil {
+		return err
+	}
+	return writeFileAtomic(dst, data, 0644)
+}
+
+// writeFileAtomic writes to a temporary file next to path and renames it
+// over path, so readers (and a restart mid-write) see the old file or the
+// new one, never a part of it
+func writeFileAtomic(path string, data []byte, perm os.FileMode) error {
+	tmp, err := os.CreateTemp(filepath.Dir(path), "."+filepath.Base(path)+".tmp*")
+	if err != nil {
+		return err
+	}
+	defer os.Remove(tmp.Name()) // No-op once renamed
+
+	if _, err := tmp.Write(data); err != nil {
+		tmp.Close()
+		return err
+	}
+	if err := tmp.Sync(); err != nil {
+		tmp.Close()
+		return err
+	}
+	if err := tmp.Close(); err != nil {
+		return err
+	}
+	if err := os.Chmod(tmp.Name(), perm); err != nil {
+		return err
+	}
+	return os.Rename(tmp.Name(), path)
+}
+
+// pruneBuilds keeps the newest keep per-commit builds, together with
+// their size reports
+func pruneBuilds(dir string, keep int) {
+	entries, err := os.ReadDir(dir)
+	if err != nil {
+		return
+	}
+
+	type build struct {
+		name    string
+		modTime time.Time
+	}
+	var builds []build
+	for _, e := range entries {
+		if info, err := e.Info(); err == nil && !e.IsDir() && strings.HasSuffix(e.Name(), ".bin") {
+			builds = append(builds, build{e.Name(), info.ModTime()})
+		}
+	}
+	sort.Slice(builds, func(i, j int) bool { return builds[i].modTime.After(builds[j].modTime) })
+
+	for _, b := range builds[min(keep, len(builds)):] {
+		os.Remove(filepath.Join(dir, b.name))
+		os.Remove(filepath.Join(dir, strings.TrimSuffix(b.name, ".bin")+".size.json"))
+	}
+}
+
 func getCurrentCommit() string {
 	cmd := exec.Command("git", "-C", projectPath, "rev-parse", "HEAD")
 	output, err := cmd.Output()
@@ -127,30 +699,81 @@ func buildFirmware() {
 		state.Unlock()
 	}()
 
-	log.Println("🔨 Starting firmware build...")
 	startTime := time.Now()
+	commit := getCurrentCommit()
+	rec := buildRecord{Commit: commit, Started: startTime}
 
-	// Get host project path from environment (fallback to container path)
-	hostProjectPath := os.Getenv("HOST_PROJECT_PATH")
-	if hostProjectPath == "" {
-		hostProjectPath = projectPath
-	}
+	// Only a clean checkout of a known commit can be keyed by that commit
+	keyed := commit != "unknown" && !workTreeDirty()
+	keyedPath := filepath.Join(firmwarePath, buildsDir, commit+".bin")
+	firmwareFullPath := filepath.Join(firmwarePath, firmwareFile)
 
-	// Run build in Docker container
-	cmd := exec.Command("docker", "run", "--rm",
-		"-v", hostProjectPath+":/project",
-		"-v", "ota-server_firmware-data:/firmware",
-		"beacon-builder",
-		"/build.sh")
+	if _, err := os.Stat(keyedPath); keyed && err == nil {
+		log.Printf("♻️  Commit %s was built before, republishing", shortCommit(commit))
+		if err := copyFile(keyedPath, firmwareFullPath); err != nil {
+			errMsg := fmt.Sprintf("Failed to republish build %s: %v", shortCommit(commit), err)
+			log.Printf("❌ %s", errMsg)
+			state.Lock()
+			state.BuildError = errMsg
+			state.recordBuild(rec)
+			state.Unlock()
+			return
+		}
+		rec.Cached = true
+	} else {
+		log.Println("🔨 Starting firmware build...")
 
-	output, err := cmd.CombinedOutput()
+		// Get host project path from environment (fallback to container path)
+		hostProjectPath := os.Getenv("HOST_PROJECT_PATH")
+		if hostProjectPath == "" {
+			hostProjectPath = projectPath
+		}
+
+		buildCommit := ""
+		if keyed {
+			buildCommit = commit
+		}
+
+		// Run build in Docker container; the build directory and ccache
+		// persist in their own volume between runs
+		cmd := exec.Command("docker", "run", "--rm",
+			"-v", hostProjectPath+":/project",
+			"-v", "ota-server_firmware-data:/firmware",
+			"-v", buildCacheVolume+":/build-cache",
+			"-e", "BUILD_COMMIT="+buildCommit,
+			"beacon-builder",
+			"/build.sh")
+
+		output, err := cmd.CombinedOutput()
+		if err != nil {
+			buildDuration := time.Since(startTime)
+			errMsg := fmt.Sprintf("Build failed after %v: %v\n%s", buildDuration, err, output)
+			log.Printf("❌ %s", errMsg)
+			rec.BuildMs = buildDuration.Milliseconds()
+			state.Lock()
+			state.BuildError = errMsg
+			state.recordBuild(rec)
+			state.Unlock()
+			return
+		}
+
+		if keyed {
+			pruneBuilds(filepath.Join(firmwarePath, buildsDir), keepBuilds)
+		}
+	}
 	buildDuration := time.Since(startTime)
+	rec.BuildMs = buildDuration.Milliseconds()
 
-	if err != nil {
-		errMsg := fmt.Sprintf("Build failed after %v: %v\n%s", buildDuration, err, output)
+	// The beacon cannot install an image larger than its OTA slot, so such
+	// a build never enters the store
+	bench := benchmarkBuild(commit, keyed, rec, firmwareFullPath)
+	if bench.ImageSize > bench.OTASlot {
+		errMsg := fmt.Sprintf("Image %s is %d bytes, over the %d byte OTA slot: not published",
+			shortCommit(commit), bench.ImageSize, bench.OTASlot)
 		log.Printf("❌ %s", errMsg)
 		state.Lock()
 		state.BuildError = errMsg
+		state.recordBuild(rec)
 		state.Unlock()
 		return
 	}
@@ -158,107 +781,752 @@ func buildFirmware() {
 	// Update state
 	state.Lock()
 	state.LastBuildTime = time.Now()
-	state.LastGitCommit = getCurrentCommit()
+	state.LastGitCommit = commit
 
 	// Get firmware size
-	firmwareFullPath := filepath.Join(firmwarePath, firmwareFile)
 	if fileInfo, err := os.Stat(firmwareFullPath); err == nil {
 		state.FirmwareSize = fileInfo.Size()
 	}
+	rec.FirmwareSize = state.FirmwareSize
 	state.Unlock()
 
 	log.Printf("✅ Build completed in %v", buildDuration)
 	log.Printf("📦 Firmware size: %.2f KB", float64(state.FirmwareSize)/1024)
+
+	// Compress the image next to the raw binary
+	compressedPath := filepath.Join(firmwarePath, compressedFile)
+	compressStart := time.Now()
+	compressedSize, err := compressFirmware(firmwareFullPath, compressedPath)
+	rec.CompressMs = time.Since(compressStart).Milliseconds()
+	if err != nil {
+		// compressFirmware removed the previous build's image, so only
+		// the raw binary is stored and served
+		log.Printf("⚠️  Failed to compress firmware: %v", err)
+		compressedSize = 0
+	} else {
+		log.Printf("🗜️  Compressed image: %.2f KB", float64(compressedSize)/1024)
+	}
+
+	build, err := addBuild(firmwareFullPath, compressedPath, commit)
+	if err != nil {
+		errMsg := fmt.Sprintf("Failed to store build %s: %v", shortCommit(commit), err)
+		log.Printf("❌ %s", errMsg)
+		state.Lock()
+		state.BuildError = errMsg
+		state.recordBuild(rec)
+		state.Unlock()
+		return
+	}
+	rec.Success = true
+	state.Lock()
+	state.CompressedSize = compressedSize
+	state.recordBuild(rec)
+	state.Unlock()
+
+	// A canary with an audience gets every new build first; stable follows
+	// with POST /channels/promote
+	channel := publishChannel()
+	if err := setChannel(channel, build.SHA256); err != nil {
+		log.Printf("❌ Failed to publish %s on %s: %v", shortCommit(commit), channel, err)
+	}
 }
 
-// Extract firmware version from ESP32 binary (app descriptor at offset 0x20)
-func getFirmwareVersion(filePath string) string {
-	file, err := os.Open(filePath)
+// Write the firmware as independently zlib-compressed chunks so the beacon
+// can inflate it as a stream with a single 32 KB window.
+//
+// Layout (little endian): "BOTZ" | version u8 | reserved[3] | chunk size u32 |
+// image size u32, then per chunk: compressed length u32 | zlib data.
+//
+// dstPath is removed first: if compression fails, the previous build's
+// image must not be left to be served as this one.
+func compressFirmware(srcPath, dstPath string) (int64, error) {
+	if err := os.Remove(dstPath); err != nil && !os.IsNotExist(err) {
+		return 0, err
+	}
+
+	image, err := os.ReadFile(srcPath)
 	if err != nil {
-		return ""
+		return 0, err
+	}
+
+	var out bytes.Buffer
+	header := make([]byte, 16)
+	copy(header, compressedMagic)
+	header[4] = compressedVersion
+	binary.LittleEndian.PutUint32(header[8:], compressedChunkSize)
+	binary.LittleEndian.PutUint32(header[12:], uint32(len(image)))
+	out.Write(header)
+
+	var chunk bytes.Buffer
+	for offset := 0; offset < len(image); offset += compressedChunkSize {
+		end := min(offset+compressedChunkSize, len(image))
+
+		chunk.Reset()
+		zw, err := zlib.NewWriterLevel(&chunk, zlib.BestCompression)
+		if err != nil {
+			return 0, err
+		}
+		if _, err := zw.Write(image[offset:end]); err != nil {
+			return 0, err
+		}
+		if err := zw.Close(); err != nil {
+			return 0, err
+		}
+
+		binary.Write(&out, binary.LittleEndian, uint32(chunk.Len()))
+		out.Write(chunk.Bytes())
+	}
+
+	if err := writeFileAtomic(dstPath, out.Bytes(), 0644); err != nil {
+		return 0, err
 	}
-	defer file.Close()
+	return int64(out.Len()), nil
+}
 
-	// ESP32 app descriptor is at offset 0x20
+// Extract firmware version from ESP32 binary (app descriptor at offset 0x20)
+func getFirmwareVersion(image []byte) string {
 	// Version string is at offset 0x10 within the descriptor (32 bytes max)
-	buf := make([]byte, 32)
-	_, err = file.ReadAt(buf, 0x30) // 0x20 + 0x10
-	if err != nil {
+	const offset = 0x30 // 0x20 + 0x10
+	if len(image) < offset+32 {
 		return ""
 	}
+	buf := image[offset : offset+32]
+
+	// Find null terminator
+	for i, b := range buf {
+		if b == 0 {
+			return string(buf[:i])
+		}
+	}
+	return string(buf)
+}
+
+// Stable per-build ETag, so a resumed Range request (If-Range) can never
+// splice bytes from two different builds together
+func contentETag(data []byte) string {
+	sum := sha256.Sum256(data)
+	return `"` + hex.EncodeToString(sum[:]) + `"`
+}
+
+// loadSigningKey reads the manifest signing key, creating one (and the
+// public key the firmware embeds) when none exists yet
+func loadSigningKey() (*ecdsa.PrivateKey, error) {
+	keyPath := os.Getenv("MANIFEST_KEY")
+	if keyPath == "" {
+		keyPath = filepath.Join(firmwarePath, manifestKeyFile)
+	}
+
+	if pemData, err := os.ReadFile(keyPath); err == nil {
+		block, _ := pem.Decode(pemData)
+		if block == nil {
+			return nil, fmt.Errorf("%s: no PEM data", keyPath)
+		}
+		parsed, err := x509.ParsePKCS8PrivateKey(block.Bytes)
+		if err != nil {
+			return nil, fmt.Errorf("%s: %v", keyPath, err)
+		}
+		key, ok := parsed.(*ecdsa.PrivateKey)
+		if !ok || key.Curve != elliptic.P256() {
+			return nil, fmt.Errorf("%s: not an ECDSA P-256 key", keyPath)
+		}
+		log.Printf("🔑 Manifest signing key: %s", keyPath)
+		return key, nil
+	} else if !os.IsNotExist(err) {
+		return nil, err
+	}
+
+	key, err := ecdsa.GenerateKey(elliptic.P256(), rand.Reader)
+	if err != nil {
+		return nil, err
+	}
+	der, err := x509.MarshalPKCS8PrivateKey(key)
+	if err != nil {
+		return nil, err
+	}
+	if err := os.WriteFile(keyPath, pem.EncodeToMemory(&pem.Block{Type: "PRIVATE KEY", Bytes: der}), 0600); err != nil {
+		return nil, err
+	}
+
+	pubDer, err := x509.MarshalPKIXPublicKey(&key.PublicKey)
+	if err != nil {
+		return nil, err
+	}
+	pubPath := filepath.Join(filepath.Dir(keyPath), manifestPubFile)
+	if err := os.WriteFile(pubPath, pem.EncodeToMemory(&pem.Block{Type: "PUBLIC KEY", Bytes: pubDer}), 0644); err != nil {
+		return nil, err
+	}
+	log.Printf("🔑 Created manifest signing key %s", keyPath)
+	log.Printf("🔑 Copy %s to main/certs/manifest_pub.pem so beacons verify updates", pubPath)
+	return key, nil
+}
+
+// buildManifest describes an image for the beacon to verify while it
+// downloads: a SHA-256 per manifestChunkSize bytes of firmware, signed
+// with the server key.
+//
+// Layout (little endian): "BOTM" | version u8 | reserved[3] | image size u32 |
+// chunk size u32 | chunk count u32 | firmware version [32] | image SHA-256 [32],
+// then chunk count SHA-256 hashes, then signature length u16 | reserved u16 |
+// ASN.1 ECDSA signature of the SHA-256 of everything before it.
+func buildManifest(image []byte, version string, key *ecdsa.PrivateKey) ([]byte, error) {
+	if len(image) == 0 {
+		return nil, errors.New("empty image")
+	}
+	chunks := (len(image) + manifestChunkSize - 1) / manifestChunkSize
+
+	var out bytes.Buffer
+	header := make([]byte, manifestHeaderSize)
+	copy(header, manifestMagic)
+	header[4] = manifestVersion
+	binary.LittleEndian.PutUint32(header[8:], uint32(len(image)))
+	binary.LittleEndian.PutUint32(header[12:], manifestChunkSize)
+	binary.LittleEndian.PutUint32(header[16:], uint32(chunks))
+	copy(header[20:51], version) // Always NUL terminated
+	sum := sha256.Sum256(image)
+	copy(header[52:], sum[:])
+	out.Write(header)
+
+	for offset := 0; offset < len(image); offset += manifestChunkSize {
+		chunkSum := sha256.Sum256(image[offset:min(offset+manifestChunkSize, len(image))])
+		out.Write(chunkSum[:])
+	}
+
+	digest := sha256.Sum256(out.Bytes())
+	sig, err := ecdsa.SignASN1(rand.Reader, key, digest[:])
+	if err != nil {
+		return nil, err
+	}
+	binary.Write(&out, binary.LittleEndian, uint16(len(sig)))
+	binary.Write(&out, binary.LittleEndian, uint16(0))
+	out.Write(sig)
+	return out.Bytes(), nil
+}
+
+// appHash is the SHA-256 that esp_partition_get_sha256 gives a beacon
+// running the image: the digest ESP-IDF appends to it (hash_appended in
+// the image header), or of the whole image when there is none
+func appHash(image []byte) string {
+	if len(image) > 24+sha256.Size && image[23] == 1 {
+		return hex.EncodeToString(image[len(image)-sha256.Size:])
+	}
+	sum := sha256.Sum256(image)
+	return hex.EncodeToString(sum[:])
+}
+
+// compressedMatches checks the image size in a compressed file's header,
+// so one left over from another build is never paired with this one
+func compressedMatches(compressed, image []byte) bool {
+	return len(compressed) >= 16 && binary.LittleEndian.Uint32(compressed[12:]) == uint32(len(image))
+}
+
+// loadFirmwareImage reads a build from disk and precomputes everything the
+// handlers need
+func loadFirmwareImage(fullPath, compressedPath string) (*firmwareImage, error) {
+	fileInfo, err := os.Stat(fullPath)
+	if err != nil {
+		return nil, err
+	}
+	data, err := os.ReadFile(fullPath)
+	if err != nil {
+		return nil, err
+	}
+
+	sum := sha256.Sum256(data)
+	img := &firmwareImage{
+		data:    data,
+		version: getFirmwareVersion(data),
+		modTime: fileInfo.ModTime().UTC().Truncate(time.Second),
+		sha256:  hex.EncodeToString(sum[:]),
+		appHash: appHash(data),
+	}
+	img.etag = `"` + img.sha256 + `"`
+
+	if compressed, err := os.ReadFile(compressedPath); err == nil {
+		if compressedMatches(compressed, data) {
+			img.compressed = compressed
+			img.compressedETag = contentETag(compressed)
+		} else {
+			log.Printf("⚠️  %s does not match %s, not serving it", compressedPath, fullPath)
+		}
+	}
+
+	var gz bytes.Buffer
+	zw, _ := gzip.NewWriterLevel(&gz, gzip.BestCompression)
+	zw.Write(data)
+	zw.Close()
+	img.gzipped = gz.Bytes()
+	img.gzipETag = contentETag(img.gzipped)
+
+	if signingKey != nil {
+		manifest, err := buildManifest(data, img.version, signingKey)
+		if err != nil {
+			return nil, fmt.Errorf("manifest: %v", err)
+		}
+		img.manifest = manifest
+		img.manifestETag = contentETag(manifest)
+	}
+	return img, nil
+}
+
+func storePath(sha, suffix string) string {
+	return filepath.Join(firmwarePath, storeDir, sha+suffix)
+}
+
+// loadStore reads channelsFile and loads the image of each channel. A
+// firmware volume from before the store has only firmwareFile, which
+// becomes the stable build.
+func loadStore() {
+	data, err := os.ReadFile(filepath.Join(firmwarePath, channelsFile))
+	if os.IsNotExist(err) {
+		if _, err := os.Stat(filepath.Join(firmwarePath, firmwareFile)); err != nil {
+			return
+		}
+		build, err := addBuild(filepath.Join(firmwarePath, firmwareFile), filepath.Join(firmwarePath, compressedFile), "")
+		if err == nil {
+			err = setChannel(channelStable, build.SHA256)
+		}
+		if err != nil {
+			log.Printf("⚠️  Failed to move %s into the store: %v", firmwareFile, err)
+		}
+		return
+	}
+
+	store.Lock()
+	defer store.Unlock()
+	if err == nil {
+		err = json.Unmarshal(data, &store.config)
+	}
+	if err != nil {
+		log.Printf("⚠️  Ignoring invalid %s: %v", channelsFile, err)
+		store.config = channelConfig{}
+	}
+	if store.config.Channels == nil {
+		store.config.Channels = make(map[string]string)
+	}
+
+	for _, channel := range channelNames {
+		sha := store.config.Channels[channel]
+		if sha == "" {
+			continue
+		}
+		img := sharedImage(sha)
+		if img == nil {
+			if img, err = loadFirmwareImage(storePath(sha, ".bin"), storePath(sha, ".bin.z")); err != nil {
+				log.Printf("⚠️  Failed to load %s build %.12s: %v", channel, sha, err)
+				continue
+			}
+		}
+		store.images[channel] = img
+		log.Printf("💾 %s: firmware %s (%.2f KB, sha256 %.12s…)", channel, img.version, float64(len(img.data))/1024, sha)
+	}
+}
+
+// saveStore writes channelsFile. Callers hold store.
+func saveStore() {
+	data, err := json.MarshalIndent(store.config, "", "  ")
+	if err == nil {
+		err = writeFileAtomic(filepath.Join(firmwarePath, channelsFile), data, 0644)
+	}
+	if err != nil {
+		log.Printf("⚠️  Failed to save %s: %v", channelsFile, err)
+	}
+}
+
+// addBuild copies an image, and its compressed form when that matches,
+// into the store. A build that is already there moves to the newest.
+func addBuild(imagePath, compressedPath, commit string) (storedBuild, error) {
+	data, err := os.ReadFile(imagePath)
+	if err != nil {
+		return storedBuild{}, err
+	}
+	sum := sha256.Sum256(data)
+	build := storedBuild{
+		SHA256:  hex.EncodeToString(sum[:]),
+		AppHash: appHash(data),
+		Version: getFirmwareVersion(data),
+		Commit:  commit,
+		Size:    int64(len(data)),
+		Added:   time.Now(),
+	}
+
+	if err := os.MkdirAll(filepath.Join(firmwarePath, storeDir), 0755); err != nil {
+		return storedBuild{}, err
+	}
+	if _, err := os.Stat(storePath(build.SHA256, ".bin")); err != nil {
+		if err := writeFileAtomic(storePath(build.SHA256, ".bin"), data, 0644); err != nil {
+			return storedBuild{}, err
+		}
+	}
+	if compressed, err := os.ReadFile(compressedPath); err == nil && compressedMatches(compressed, data) {
+		if err := writeFileAtomic(storePath(build.SHA256, ".bin.z"), compressed, 0644); err != nil {
+			log.Printf("⚠️  Failed to store compressed image: %v", err)
+		}
+	}
+
+	store.Lock()
+	defer store.Unlock()
+	if store.config.Channels == nil {
+		store.config.Channels = make(map[string]string)
+	}
+	for i, b := range store.config.Builds {
+		if b.SHA256 == build.SHA256 {
+			if build.Commit == "" {
+				build.Commit = b.Commit
+			}
+			store.config.Builds = append(store.config.Builds[:i], store.config.Builds[i+1:]...)
+			break
+		}
+	}
+	store.config.Builds = append(store.config.Builds, build)
+	pruneStore()
+	saveStore()
+	log.Printf("🗄️  Stored build %s (%s, sha256 %.12s…), %d in store", shortCommit(commit), build.Version, build.SHA256, len(store.config.Builds))
+	return build, nil
+}
+
+// pruneStore deletes the oldest builds beyond keepStored that no channel
+// serves. Callers hold store.
+func pruneStore() {
+	excess := len(store.config.Builds) - keepStored
+	var kept []storedBuild
+	for _, b := range store.config.Builds {
+		if excess > 0 && !slices.Contains(mapValues(store.config.Channels), b.SHA256) {
+			os.Remove(storePath(b.SHA256, ".bin"))
+			os.Remove(storePath(b.SHA256, ".bin.z"))
+			excess--
+			continue
+		}
+		kept = append(kept, b)
+	}
+	store.config.Builds = kept
+}
+
+func mapValues(m map[string]string) []string {
+	values := make([]string, 0, len(m))
+	for _, v := range m {
+		values = append(values, v)
+	}
+	return values
+}
+
+// findBuild returns the newest stored build whose SHA-256 or commit starts
+// with prefix. Callers hold store.
+func findBuild(prefix string) (storedBuild, bool) {
+	prefix = strings.ToLower(prefix)
+	for i := len(store.config.Builds) - 1; i >= 0; i-- {
+		b := store.config.Builds[i]
+		if prefix != "" && (strings.HasPrefix(b.SHA256, prefix) || strings.HasPrefix(b.Commit, prefix)) {
+			return b, true
+		}
+	}
+	return storedBuild{}, false
+}
+
+// sharedImage returns the image another channel already has loaded for a
+// build, if any. Callers hold store.
+func sharedImage(sha string) *firmwareImage {
+	for _, img := range store.images {
+		if img.sha256 == sha {
+			return img
+		}
+	}
+	return nil
+}
+
+// channelBuild describes the build a channel serves (zero when none)
+func channelBuild(channel string) storedBuild {
+	store.RLock()
+	defer store.RUnlock()
+	sha := store.config.Channels[channel]
+	for _, b := range store.config.Builds {
+		if sha != "" && b.SHA256 == sha {
+			return b
+		}
+	}
+	return storedBuild{}
+}
+
+// publishChannel is where a new build goes: canary while any device
+// follows it, stable otherwise
+func publishChannel() string {
+	store.RLock()
+	defer store.RUnlock()
+	if store.config.CanaryPercent > 0 ||
+		slices.Contains(mapValues(store.config.MACs), channelCanary) ||
+		slices.Contains(mapValues(store.config.Majors), channelCanary) {
+		return channelCanary
+	}
+	return channelStable
+}
+
+// setChannel points a channel at a stored build, or takes canary's build
+// away with "", and swaps in its image before anyone is told about it.
+// Moving stable restarts the staged rollout; canary has no waves.
+func setChannel(channel, sha string) error {
+	store.RLock()
+	img := sharedImage(sha)
+	unchanged := store.config.Channels[channel] == sha && (sha == "" || store.images[channel] != nil)
+	store.RUnlock()
+	if unchanged {
+		log.Printf("📌 %s already serves %.12s", channel, sha)
+		return nil
+	}
+
+	if img == nil && sha != "" {
+		var err error
+		if img, err = loadFirmwareImage(storePath(sha, ".bin"), storePath(sha, ".bin.z")); err != nil {
+			return err
+		}
+	}
+
+	store.Lock()
+	if store.config.Channels == nil {
+		store.config.Channels = make(map[string]string)
+	}
+	if sha == "" {
+		delete(store.config.Channels, channel)
+		delete(store.images, channel)
+	} else {
+		store.config.Channels[channel] = sha
+		store.images[channel] = img
+	}
+	saveStore()
+	store.Unlock()
+
+	if sha == "" {
+		log.Printf("📌 %s emptied, its devices follow %s", channel, channelStable)
+	} else {
+		log.Printf("📌 %s now serves %s (%.2f KB, sha256 %.12s…)", channel, img.version, float64(len(img.data))/1024, sha)
+	}
+
+	// Start the staged rollout, then wake beacons blocked on /version/wait
+	if channel == channelStable {
+		rollout.publish()
+	}
+	notifier.broadcast()
+	log.Println("🔔 Notified waiting beacons of new build")
+	return nil
+}
+
+// channelFor picks a device's channel (see channelConfig). Callers hold
+// store.
+func channelFor(mac, major string) string {
+	mac = strings.ToUpper(strings.TrimSpace(mac))
+	channel, ok := store.config.MACs[mac]
+	if !ok && major != "" {
+		channel, ok = store.config.Majors[major]
+	}
+	// Salted, so the canary is not also the first rollout wave
+	if !ok && mac != "" && int(macHash(channelCanary+"/"+mac)%100) < store.config.CanaryPercent {
+		channel = channelCanary
+	}
+	if store.images[channel] == nil {
+		channel = channelStable
+	}
+	return channel
+}
+
+// imageFor returns the requesting device's channel and its image, nil
+// before the first build
+func imageFor(r *http.Request) (*firmwareImage, string) {
+	store.RLock()
+	defer store.RUnlock()
+	channel := channelFor(r.Header.Get("X-Device-MAC"), r.Header.Get("X-Beacon-Major"))
+	return store.images[channel], channel
+}
+
+// deviceTarget is imageFor plus whether the device must take the image even
+// if it is not a newer version. A device that reports the SHA-256 of its
+// running image is moved whenever it runs another build from the store, so
+// leaving the canary or rolling a channel back reaches it. A device running
+// a build the store does not know (flashed over USB), or firmware that
+// does not report it, is only forced with FORCE_OTA_UPDATE; a device
+// already running the image never is.
+func deviceTarget(r *http.Request) (img *firmwareImage, channel string, force bool) {
+	img, channel = imageFor(r)
+	if img == nil {
+		return nil, channel, false
+	}
+	forceAll := os.Getenv("FORCE_OTA_UPDATE") == "true"
+	running := strings.ToLower(strings.TrimSpace(r.Header.Get("X-Firmware-SHA256")))
+	if running == "" {
+		return img, channel, forceAll
+	}
+	if running == img.appHash {
+		return img, channel, false
+	}
 
-	// Find null terminator
-	for i, b := range buf {
-		if b == 0 {
-			return string(buf[:i])
+	store.RLock()
+	defer store.RUnlock()
+	for _, b := range store.config.Builds {
+		if b.AppHash == running {
+			return img, channel, true
 		}
 	}
-	return string(buf)
+	return img, channel, forceAll
 }
 
 func serveFirmware(w http.ResponseWriter, r *http.Request) {
-	fullPath := filepath.Join(firmwarePath, firmwareFile)
-
-	fileInfo, err := os.Stat(fullPath)
-	if os.IsNotExist(err) {
-		log.Printf("❌ Firmware file not found: %s", fullPath)
+	img, _, force := deviceTarget(r)
+	if img == nil {
+		log.Printf("❌ Firmware not available: %s", firmwareFile)
 		http.Error(w, "Firmware not found", http.StatusNotFound)
 		return
 	}
 
-	// Extract and send firmware version header
-	version := getFirmwareVersion(fullPath)
-	if version != "" {
-		w.Header().Set("X-Firmware-Version", version)
-		log.Printf("📋 Firmware version: %s", version)
+	// Send firmware version header
+	if img.version != "" {
+		w.Header().Set("X-Firmware-Version", img.version)
+		log.Printf("📋 Firmware version: %s", img.version)
 	} else {
 		log.Printf("⚠️  Could not extract firmware version")
 	}
 
-	// Check for force update flag (from environment variable)
-	if os.Getenv("FORCE_OTA_UPDATE") == "true" {
+	if force {
 		w.Header().Set("X-Force-Update", "true")
 		log.Printf("🔥 Force update enabled")
 	}
 
+	// Clients asking for gzip get the precompressed copy (beacons send no
+	// Accept-Encoding and get identity). Each representation has its own
+	// ETag, so Range and If-Range always refer to the bytes sent.
+	body, etag := img.data, img.etag
+	if acceptsEncoding(r, "gzip") {
+		body, etag = img.gzipped, img.gzipETag
+		w.Header().Set("Content-Encoding", "gzip")
+	}
+	w.Header().Set("Vary", "Accept-Encoding")
+
+	// ServeContent honors Range and If-Range against this ETag
+	w.Header().Set("ETag", etag)
 	w.Header().Set("Content-Type", "application/octet-stream")
 	w.Header().Set("Content-Disposition", fmt.Sprintf("attachment; filename=%s", firmwareFile))
-	w.Header().Set("Content-Length", fmt.Sprintf("%d", fileInfo.Size()))
+	w.Header().Set("Accept-Ranges", "bytes")
 
-	// For HEAD requests, just write headers (don't use ServeFile as it might override headers)
+	// For HEAD requests, just write headers
 	if r.Method == "HEAD" {
-		log.Printf("📤 HEAD request: %s (%.2f KB) to %s", firmwareFile, float64(fileInfo.Size())/1024, r.RemoteAddr)
+		log.Printf("📤 HEAD request: %s (%.2f KB) to %s", firmwareFile, float64(len(body))/1024, r.RemoteAddr)
+		w.Header().Set("Content-Length", fmt.Sprintf("%d", len(body)))
 		w.WriteHeader(http.StatusOK)
 		log.Printf("✅ Headers sent")
 		return
 	}
 
-	log.Printf("📤 Serving firmware: %s (%.2f KB) to %s", firmwareFile, float64(fileInfo.Size())/1024, r.RemoteAddr)
-	http.ServeFile(w, r, fullPath)
+	if !acquireDownloadSlot(w, r) {
+		return
+	}
+	defer releaseDownloadSlot(w, r)
+
+	if rangeHeader := r.Header.Get("Range"); rangeHeader != "" {
+		log.Printf("⏩ Resume request from %s: %s", r.RemoteAddr, rangeHeader)
+	}
+	log.Printf("📤 Serving firmware: %s (%.2f KB) to %s", firmwareFile, float64(len(body))/1024, r.RemoteAddr)
+	http.ServeContent(w, r, firmwareFile, img.modTime, bytes.NewReader(body))
 	log.Printf("✅ Firmware delivered")
 }
 
-func versionCheckHandler(w http.ResponseWriter, r *http.Request) {
-	fullPath := filepath.Join(firmwarePath, firmwareFile)
+func serveCompressedFirmware(w http.ResponseWriter, r *http.Request) {
+	img, _ := imageFor(r)
+	if img == nil || img.compressed == nil {
+		// Beacons fall back to the raw binary on 404
+		log.Printf("❌ Compressed firmware not available: %s", compressedFile)
+		http.Error(w, "Compressed firmware not found", http.StatusNotFound)
+		return
+	}
 
-	fileInfo, err := os.Stat(fullPath)
-	if os.IsNotExist(err) {
-		log.Printf("❌ Firmware file not found: %s", fullPath)
+	if !acquireDownloadSlot(w, r) {
+		return
+	}
+	defer releaseDownloadSlot(w, r)
+
+	if img.version != "" {
+		w.Header().Set("X-Firmware-Version", img.version)
+	}
+	w.Header().Set("ETag", img.compressedETag)
+	w.Header().Set("Content-Type", "application/octet-stream")
+	w.Header().Set("Content-Disposition", fmt.Sprintf("attachment; filename=%s", compressedFile))
+	// Decompressed size, so the beacon can erase the target partition up front
+	w.Header().Set("X-Image-Size", strconv.Itoa(len(img.data)))
+
+	if rangeHeader := r.Header.Get("Range"); rangeHeader != "" {
+		log.Printf("⏩ Resume request from %s: %s", r.RemoteAddr, rangeHeader)
+	}
+	log.Printf("📤 Serving compressed firmware: %s (%.2f KB) to %s", compressedFile, float64(len(img.compressed))/1024, r.RemoteAddr)
+	http.ServeContent(w, r, compressedFile, img.modTime, bytes.NewReader(img.compressed))
+	log.Printf("✅ Compressed firmware delivered")
+}
+
+// serveManifest sends the signed manifest of the device's build. It is
+// small and fetched right before a download, so it takes no download slot.
+func serveManifest(w http.ResponseWriter, r *http.Request) {
+	img, _ := imageFor(r)
+	if img == nil || img.manifest == nil {
+		log.Printf("❌ Manifest not available: %s", manifestFile)
+		http.Error(w, "Manifest not found", http.StatusNotFound)
+		return
+	}
+
+	if img.version != "" {
+		w.Header().Set("X-Firmware-Version", img.version)
+	}
+	w.Header().Set("ETag", img.manifestETag)
+	w.Header().Set("Content-Type", "application/octet-stream")
+	w.Header().Set("Cache-Control", "no-cache")
+	log.Printf("📤 Serving manifest for %s (%d bytes) to %s", img.version, len(img.manifest), r.RemoteAddr)
+	http.ServeContent(w, r, manifestFile, img.modTime, bytes.NewReader(img.manifest))
+}
+
+// versionCheckHandler answers with the version of the requesting device's
+// channel (see deviceTarget)
+func versionCheckHandler(w http.ResponseWriter, r *http.Request) {
+	img, channel, force := deviceTarget(r)
+	if img == nil {
+		log.Printf("❌ Firmware not available: %s", firmwareFile)
 		http.Error(w, "Firmware not found", http.StatusNotFound)
 		return
 	}
 
-	// Extract and send firmware version header
-	version := getFirmwareVersion(fullPath)
+	// Validators follow the device's build, so an unchanged build costs the
+	// beacon a 304 with no body
+	etag := versionETag(img.etag, force)
+	w.Header().Set("ETag", etag)
+	w.Header().Set("Last-Modified", img.modTime.Format(http.TimeFormat))
+	w.Header().Set("Cache-Control", "no-cache")
+
+	if versionNotModified(r, etag, img.modTime) {
+		log.Printf("📋 Version check from %s: not modified", r.RemoteAddr)
+		w.WriteHeader(http.StatusNotModified)
+		return
+	}
+
+	// Send firmware version header
+	version := img.version
 	if version != "" {
 		w.Header().Set("X-Firmware-Version", version)
-		log.Printf("📋 Version check: %s", version)
+		log.Printf("📋 Version check: %s (%s)", version, channel)
 	} else {
 		log.Printf("⚠️  Could not extract firmware version")
 	}
 
-	// Check for force update flag (from environment variable)
-	if os.Getenv("FORCE_OTA_UPDATE") == "true" {
+	// Hold back stable devices whose rollout wave has not opened yet.
+	// Devices already running this build are never deferred.
+	mac := r.Header.Get("X-Device-MAC")
+	upToDate := r.Header.Get("X-Firmware-Version") == version
+	if running := r.Header.Get("X-Firmware-SHA256"); running != "" {
+		upToDate = strings.EqualFold(running, img.appHash)
+	}
+	if channel == channelStable && !upToDate {
+		if wait := rollout.waitFor(mac); wait > 0 {
+			retry := int((wait + time.Second - 1) / time.Second)
+			log.Printf("⏳ Version check from %s (%s): wave %d opens in %ds", r.RemoteAddr, mac, rollout.wave(mac), retry)
+			w.Header().Del("X-Firmware-Version")
+			w.Header().Set("Retry-After", strconv.Itoa(retry))
+			http.Error(w, "Rollout wave not open yet", http.StatusServiceUnavailable)
+			return
+		}
+	}
+
+	if force {
 		w.Header().Set("X-Force-Update", "true")
 		log.Printf("🔥 Force update enabled")
 	}
@@ -269,7 +1537,78 @@ func versionCheckHandler(w http.ResponseWriter, r *http.Request) {
 	log.Printf("📤 Version check from %s", r.RemoteAddr)
 	w.WriteHeader(http.StatusOK)
 	fmt.Fprint(w, version)
-	log.Printf("✅ Version sent: %s (%.0f bytes)", version, float64(fileInfo.Size()))
+	log.Printf("✅ Version sent: %s (%d bytes)", version, len(img.data))
+}
+
+// versionWaitHandler is a long-poll variant of /version. A client whose
+// If-None-Match is already stale gets the version at once; otherwise the
+// request is held until the next publish on any channel or the timeout
+// (304). Devices on another channel than the one that changed get a 304.
+func versionWaitHandler(w http.ResponseWriter, r *http.Request) {
+	timeout := longPollDefault
+	if sec, err := strconv.Atoi(r.URL.Query().Get("timeout")); err == nil && sec > 0 {
+		timeout = time.Duration(sec) * time.Second
+	}
+	if timeout > longPollMax {
+		timeout = longPollMax
+	}
+
+	// Subscribe before looking at the image so a build finishing in
+	// between is not missed
+	published := notifier.wait()
+
+	if img, _, force := deviceTarget(r); img != nil {
+		etag := versionETag(img.etag, force)
+		if !versionNotModified(r, etag, img.modTime) {
+			versionCheckHandler(w, r)
+			return
+		}
+	}
+
+	timer := time.NewTimer(timeout)
+	defer timer.Stop()
+
+	select {
+	case <-published:
+		log.Printf("🔔 Long-poll from %s released by new build", r.RemoteAddr)
+		versionCheckHandler(w, r)
+	case <-timer.C:
+		w.WriteHeader(http.StatusNotModified)
+	case <-r.Context().Done():
+	}
+}
+
+// versionETag derives the /version validator from the firmware ETag; the
+// force flag changes the response, so it is part of the tag.
+func versionETag(firmwareETag string, force bool) string {
+	tag := strings.Trim(firmwareETag, `"`)
+	if len(tag) > 16 {
+		tag = tag[:16]
+	}
+	if force {
+		tag += "-force"
+	}
+	return `"v-` + tag + `"`
+}
+
+// versionNotModified evaluates If-None-Match, falling back to
+// If-Modified-Since only when the client sent no entity tag.
+func versionNotModified(r *http.Request, etag string, modTime time.Time) bool {
+	if inm := r.Header.Get("If-None-Match"); inm != "" {
+		for _, candidate := range strings.Split(inm, ",") {
+			candidate = strings.TrimSpace(candidate)
+			if candidate == etag || candidate == "*" {
+				return true
+			}
+		}
+		return false
+	}
+
+	if ims := r.Header.Get("If-Modified-Since"); ims != "" {
+		t, err := http.ParseTime(ims)
+		return err == nil && !modTime.After(t)
+	}
+	return false
 }
 
 func healthCheck(w http.ResponseWriter, r *http.Request) {
@@ -288,10 +1627,48 @@ func statusHandler(w http.ResponseWriter, r *http.Request) {
   "lastCheck": "%s",
   "buildInProgress": %v,
   "firmwareSize": %d,
-  "buildError": "%s"
+  "compressedSize": %d,
+  "buildError": "%s",
+  "rolloutWaves": %d,
+  "openWaves": %d,
+  "activeDownloads": %d,
+  "maxDownloads": %d,
+  "rolloutHeld": %v,
+  "connections": %d,
+  "channels": %s,
+  "builds": %s
 }`, state.LastGitCommit, state.LastBuildTime.Format(time.RFC3339),
 		state.LastCheckTime.Format(time.RFC3339), state.BuildInProgress,
-		state.FirmwareSize, state.BuildError)
+		state.FirmwareSize, state.CompressedSize, state.BuildError,
+		rollout.waves, rollout.openWaves(), len(rollout.slots), cap(rollout.slots),
+		rollout.held(), len(connections.total), channelsJSON(), buildHistoryJSON())
+}
+
+// channelsJSON describes the build each channel serves
+func channelsJSON() string {
+	channels := make(map[string]storedBuild)
+	for _, channel := range channelNames {
+		if build := channelBuild(channel); build.SHA256 != "" {
+			channels[channel] = build
+		}
+	}
+	data, err := json.Marshal(channels)
+	if err != nil {
+		return "{}"
+	}
+	return string(data)
+}
+
+func buildHistoryJSON() string {
+	history := state.BuildHistory
+	if history == nil {
+		history = []buildRecord{}
+	}
+	data, err := json.Marshal(history)
+	if err != nil {
+		return "[]"
+	}
+	return string(data)
 }
 
 func manualBuildHandler(w http.ResponseWriter, r *http.Request) {
@@ -305,16 +1682,500 @@ func manualBuildHandler(w http.ResponseWriter, r *http.Request) {
 	fmt.Fprintf(w, "Build triggered\n")
 }
 
+// gatewayReportHandler takes reports with POST and lists what every
+// gateway currently hears with GET
+func gatewayReportHandler(w http.ResponseWriter, r *http.Request) {
+	switch r.Method {
+	case "POST":
+		var report gatewayReport
+		if err := json.NewDecoder(http.MaxBytesReader(w, r.Body, maxGatewayReport)).Decode(&report); err != nil {
+			http.Error(w, "Invalid report", http.StatusBadRequest)
+			return
+		}
+		if report.Gateway.MAC == "" {
+			http.Error(w, "Missing gateway MAC", http.StatusBadRequest)
+			return
+		}
+		recordGatewayReport(&report, time.Now())
+		w.WriteHeader(http.StatusNoContent)
+	case "GET":
+		w.Header().Set("Content-Type", "application/json")
+		json.NewEncoder(w).Encode(gatewaySnapshot(time.Now()))
+	default:
+		http.Error(w, "Method not allowed", http.StatusMethodNotAllowed)
+	}
+}
+
+func recordGatewayReport(report *gatewayReport, now time.Time) {
+	// Expire on every report too, so the map cannot grow without bound
+	// when nobody reads /gateway/report
+	pruneGateways(now)
+
+	gateways.Lock()
+	defer gateways.Unlock()
+
+	gw := gateways.m[report.Gateway.MAC]
+	if gw == nil {
+		gw = &gatewayState{MAC: report.Gateway.MAC, Beacons: make(map[string]*beaconSighting)}
+		gateways.m[gw.MAC] = gw
+	}
+	gw.Major, gw.Minor = report.Gateway.Major, report.Gateway.Minor
+	gw.LastReport = now
+	gw.Dropped = report.Dropped
+
+	for i := range report.Beacons {
+		b := report.Beacons[i]
+		b.LastSeen = now.Add(-time.Duration(b.AgeMs) * time.Millisecond)
+		b.AgeMs = 0
+		gw.Beacons[fmt.Sprintf("%s/%d/%d", b.UUID, b.Major, b.Minor)] = &b
+	}
+	log.Printf("📡 Gateway %s: %d beacons (%d iBeacon packets, %d dropped)",
+		gw.MAC, len(report.Beacons), report.IBeaconReports, report.Dropped)
+}
+
+// pruneGateways drops sightings older than gatewaySightingTTL, and gateways
+// with none left that have not reported for as long
+func pruneGateways(now time.Time) {
+	gateways.Lock()
+	defer gateways.Unlock()
+
+	for mac, gw := range gateways.m {
+		for key, b := range gw.Beacons {
+			if now.Sub(b.LastSeen) > gatewaySightingTTL {
+				delete(gw.Beacons, key)
+			}
+		}
+		if len(gw.Beacons) == 0 && now.Sub(gw.LastReport) > gatewaySightingTTL {
+			delete(gateways.m, mac)
+		}
+	}
+}
+
+// gatewaySnapshot prunes expired sightings and returns the rest
+func gatewaySnapshot(now time.Time) []gatewayState {
+	pruneGateways(now)
+
+	gateways.Lock()
+	defer gateways.Unlock()
+
+	list := []gatewayState{}
+	for _, gw := range gateways.m {
+		snapshot := *gw
+		snapshot.Beacons = make(map[string]*beaconSighting, len(gw.Beacons))
+		for key, b := range gw.Beacons {
+			copied := *b
+			snapshot.Beacons[key] = &copied
+		}
+		list = append(list, snapshot)
+	}
+	sort.Slice(list, func(i, j int) bool { return list[i].MAC < list[j].MAC })
+	return list
+}
+
+// otaSlotSize reads the size of ota_0 from the project's partition table
+func otaSlotSize() int64 {
+	data, err := os.ReadFile(filepath.Join(projectPath, "partitions_ota.csv"))
+	if err == nil {
+		for _, line := range strings.Split(string(data), "\n") {
+			fields := strings.Split(line, ",")
+			if len(fields) >= 5 && strings.TrimSpace(fields[0]) == "ota_0" {
+				if size, err := strconv.ParseInt(strings.TrimSpace(fields[4]), 0, 64); err == nil {
+					return size
+				}
+			}
+		}
+	}
+	return defaultOTASlotSize
+}
+
+// readSizeSections picks sizeSections out of an `idf.py size` JSON report
+func readSizeSections(path string) map[string]int64 {
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return nil
+	}
+	var report map[string]any
+	if err := json.Unmarshal(data, &report); err != nil {
+		log.Printf("⚠️  Invalid size report %s: %v", path, err)
+		return nil
+	}
+	sections := make(map[string]int64)
+	for _, key := range sizeSections {
+		if v, ok := report[key].(float64); ok {
+			sections[key] = int64(v)
+		}
+	}
+	return sections
+}
+
+// benchmarkBuild records the image just built (or republished) in the
+// benchmark history and returns its record
+func benchmarkBuild(commit string, keyed bool, rec buildRecord, imagePath string) benchmarkRecord {
+	image, err := os.ReadFile(imagePath)
+	if err != nil {
+		log.Printf("⚠️  Cannot benchmark %s: %v", shortCommit(commit), err)
+		return benchmarkRecord{Commit: commit, OTASlot: otaSlotSize()}
+	}
+
+	bench := benchmarkRecord{
+		Commit:    commit,
+		Version:   getFirmwareVersion(image),
+		Built:     rec.Started,
+		Dirty:     !keyed,
+		BuildMs:   rec.BuildMs,
+		ImageSize: int64(len(image)),
+		OTASlot:   otaSlotSize(),
+	}
+	sizePath := filepath.Join(firmwarePath, sizeFile)
+	if rec.Cached {
+		sizePath = filepath.Join(firmwarePath, buildsDir, commit+".size.json")
+	}
+	bench.Sections = readSizeSections(sizePath)
+	if bench.ImageSize > bench.OTASlot {
+		bench.Flags = []string{flagOverOTASlot}
+	}
+
+	benchmarks.Lock()
+	defer benchmarks.Unlock()
+
+	// A republished commit keeps its compile time and device results
+	if i := findBenchmark(commit); i >= 0 {
+		if rec.Cached {
+			return benchmarks.records[i]
+		}
+		benchmarks.records = append(benchmarks.records[:i], benchmarks.records[i+1:]...)
+	}
+	benchmarks.records = append(benchmarks.records, bench)
+	if over := len(benchmarks.records) - benchmarkHistorySize; over > 0 {
+		benchmarks.records = benchmarks.records[over:]
+	}
+	saveBenchmarks()
+
+	log.Printf("📊 Benchmark %s: image %d bytes (%.1f%% of OTA slot), build %dms",
+		shortCommit(commit), bench.ImageSize, float64(bench.ImageSize)*100/float64(bench.OTASlot), bench.BuildMs)
+	return bench
+}
+
+// findBenchmark returns the index of the newest record for commit (or a
+// prefix of it), -1 if none. Callers hold benchmarks.
+func findBenchmark(commit string) int {
+	for i := len(benchmarks.records) - 1; i >= 0; i-- {
+		if commit != "" && strings.HasPrefix(benchmarks.records[i].Commit, commit) {
+			return i
+		}
+	}
+	return -1
+}
+
+func loadBenchmarks() {
+	data, err := os.ReadFile(filepath.Join(firmwarePath, benchmarksFile))
+	if err != nil {
+		return
+	}
+	benchmarks.Lock()
+	defer benchmarks.Unlock()
+	if err := json.Unmarshal(data, &benchmarks.records); err != nil {
+		log.Printf("⚠️  Ignoring invalid %s: %v", benchmarksFile, err)
+		benchmarks.records = nil
+		return
+	}
+	log.Printf("📊 Loaded %d benchmark records", len(benchmarks.records))
+}
+
+// saveBenchmarks writes the history to disk. Callers hold benchmarks.
+func saveBenchmarks() {
+	data, err := json.MarshalIndent(benchmarks.records, "", "  ")
+	if err == nil {
+		err = writeFileAtomic(filepath.Join(firmwarePath, benchmarksFile), data, 0644)
+	}
+	if err != nil {
+		log.Printf("⚠️  Failed to save benchmarks: %v", err)
+	}
+}
+
+func medianInt64(values []int64) int64 {
+	if len(values) == 0 {
+		return 0
+	}
+	sorted := append([]int64(nil), values...)
+	sort.Slice(sorted, func(i, j int) bool { return sorted[i] < sorted[j] })
+	return sorted[len(sorted)/2]
+}
+
+// checkBootRegression compares records[i] with the newest earlier record
+// that has device results and was not flagged itself. Callers hold
+// benchmarks.
+func checkBootRegression(i int) bool {
+	rec := &benchmarks.records[i]
+	var flags []string
+	for _, f := range rec.Flags {
+		if f != flagBootRegression {
+			flags = append(flags, f)
+		}
+	}
+	rec.Flags = flags
+
+	for j := i - 1; j >= 0; j-- {
+		base := benchmarks.records[j]
+		if base.BootToAdvMs == 0 || slices.Contains(base.Flags, flagBootRegression) {
+			continue
+		}
+		pct := int64(envInt("BOOT_REGRESSION_PCT", defaultBootRegression))
+		slower := rec.BootToAdvMs - base.BootToAdvMs
+		if slower >= bootRegressionMinMs && slower*100 > base.BootToAdvMs*pct {
+			rec.Flags = append(rec.Flags, flagBootRegression)
+			log.Printf("🐢 Boot regression in %s: %dms to advertise, was %dms in %s",
+				shortCommit(rec.Commit), rec.BootToAdvMs, base.BootToAdvMs, shortCommit(base.Commit))
+			return true
+		}
+		break
+	}
+	return false
+}
+
+// recordDeviceBenchmark adds a test device run to its commit's record (the
+// published build when commit is empty)
+func recordDeviceBenchmark(commit string, run deviceBenchmark) (benchmarkRecord, bool) {
+	if commit == "" {
+		state.RLock()
+		commit = state.LastGitCommit
+		state.RUnlock()
+	}
+
+	benchmarks.Lock()
+	defer benchmarks.Unlock()
+
+	i := findBenchmark(commit)
+	if i < 0 {
+		return benchmarkRecord{}, false
+	}
+	rec := &benchmarks.records[i]
+	rec.Devices = append(rec.Devices, run)
+	if over := len(rec.Devices) - benchmarkDeviceRuns; over > 0 {
+		rec.Devices = rec.Devices[over:]
+	}
+
+	var boot, heap []int64
+	for _, d := range rec.Devices {
+		if d.BootToAdvMs > 0 {
+			boot = append(boot, d.BootToAdvMs)
+		}
+		if d.FreeHeap > 0 {
+			heap = append(heap, d.FreeHeap)
+		}
+	}
+	rec.BootToAdvMs = medianInt64(boot)
+	rec.FreeHeap = medianInt64(heap)
+
+	// Keep the rest of the fleet on the previous build until this is fixed
+	if rec.BootToAdvMs > 0 && checkBootRegression(i) {
+		if channelBuild(channelStable).Commit == rec.Commit && !rollout.held() {
+			rollout.hold()
+			log.Printf("✋ Rollout of %s held at %d wave(s)", shortCommit(rec.Commit), rollout.openWaves())
+		}
+	}
+	saveBenchmarks()
+	return *rec, true
+}
+
+// benchmarksHandler lists the benchmark history with GET (oldest first;
+// ?commit= and ?limit= narrow it) and takes test device results with POST
+func benchmarksHandler(w http.ResponseWriter, r *http.Request) {
+	switch r.Method {
+	case "POST":
+		var report struct {
+			Commit string `json:"commit"`
+			deviceBenchmark
+		}
+		if err := json.NewDecoder(http.MaxBytesReader(w, r.Body, maxDeviceBenchmark)).Decode(&report); err != nil {
+			http.Error(w, "Invalid benchmark", http.StatusBadRequest)
+			return
+		}
+		if report.BootToAdvMs <= 0 && report.FreeHeap <= 0 {
+			http.Error(w, "Missing bootToAdvMs or freeHeap", http.StatusBadRequest)
+			return
+		}
+		report.Reported = time.Now()
+		rec, ok := recordDeviceBenchmark(report.Commit, report.deviceBenchmark)
+		if !ok {
+			http.Error(w, "Unknown commit", http.StatusNotFound)
+			return
+		}
+		log.Printf("📊 Device %s on %s: %dms to advertise, %d bytes free heap",
+			report.MAC, shortCommit(rec.Commit), report.BootToAdvMs, report.FreeHeap)
+		w.Header().Set("Content-Type", "application/json")
+		json.NewEncoder(w).Encode(rec)
+	case "GET":
+		commit := r.URL.Query().Get("commit")
+		limit, _ := strconv.Atoi(r.URL.Query().Get("limit"))
+
+		benchmarks.Lock()
+		list := []benchmarkRecord{}
+		for _, rec := range benchmarks.records {
+			if commit == "" || strings.HasPrefix(rec.Commit, commit) {
+				list = append(list, rec)
+			}
+		}
+		benchmarks.Unlock()
+		if limit > 0 && len(list) > limit {
+			list = list[len(list)-limit:]
+		}
+
+		w.Header().Set("Content-Type", "application/json")
+		json.NewEncoder(w).Encode(list)
+	default:
+		http.Error(w, "Method not allowed", http.StatusMethodNotAllowed)
+	}
+}
+
+// channelsHandler shows the channel configuration and stored builds with
+// GET. POST changes it: channels maps a channel to a build (a SHA-256 or
+// commit prefix; "" empties canary), canaryPercent is 0-100, and macs or
+// majors, when present, replace those targets.
+func channelsHandler(w http.ResponseWriter, r *http.Request) {
+	switch r.Method {
+	case "GET":
+	case "POST":
+		var req struct {
+			Channels      map[string]string `json:"channels"`
+			CanaryPercent *int              `json:"canaryPercent"`
+			MACs          map[string]string `json:"macs"`
+			Majors        map[string]string `json:"majors"`
+		}
+		if err := json.NewDecoder(http.MaxBytesReader(w, r.Body, maxDeviceBenchmark)).Decode(&req); err != nil {
+			http.Error(w, "Invalid channel configuration", http.StatusBadRequest)
+			return
+		}
+		if req.CanaryPercent != nil && (*req.CanaryPercent < 0 || *req.CanaryPercent > 100) {
+			http.Error(w, "canaryPercent must be 0-100", http.StatusBadRequest)
+			return
+		}
+		macs, majors := make(map[string]string), make(map[string]string)
+		for mac, channel := range req.MACs {
+			if _, err := net.ParseMAC(mac); err != nil || !slices.Contains(channelNames, channel) {
+				http.Error(w, fmt.Sprintf("Invalid target %s: %s", mac, channel), http.StatusBadRequest)
+				return
+			}
+			macs[strings.ToUpper(mac)] = channel
+		}
+		for major, channel := range req.Majors {
+			n, err := strconv.Atoi(major)
+			if err != nil || n < 0 || n > 65535 || !slices.Contains(channelNames, channel) {
+				http.Error(w, fmt.Sprintf("Invalid target %s: %s", major, channel), http.StatusBadRequest)
+				return
+			}
+			majors[strconv.Itoa(n)] = channel
+		}
+
+		// Resolve every build before changing anything
+		builds := make(map[string]string)
+		store.RLock()
+		for channel, prefix := range req.Channels {
+			build, ok := findBuild(prefix)
+			switch {
+			case !slices.Contains(channelNames, channel):
+				http.Error(w, "Unknown channel "+channel, http.StatusBadRequest)
+			case prefix == "" && channel == channelStable:
+				http.Error(w, "The stable channel cannot be emptied", http.StatusBadRequest)
+			case prefix != "" && !ok:
+				http.Error(w, "No stored build "+prefix, http.StatusNotFound)
+			default:
+				builds[channel] = build.SHA256
+				continue
+			}
+			store.RUnlock()
+			return
+		}
+		store.RUnlock()
+
+		store.Lock()
+		if req.CanaryPercent != nil {
+			store.config.CanaryPercent = *req.CanaryPercent
+		}
+		if req.MACs != nil {
+			store.config.MACs = macs
+		}
+		if req.Majors != nil {
+			store.config.Majors = majors
+		}
+		saveStore()
+		log.Printf("📌 Channels: canary %d%%, %d MAC and %d major target(s)",
+			store.config.CanaryPercent, len(store.config.MACs), len(store.config.Majors))
+		store.Unlock()
+
+		for _, channel := range channelNames {
+			if sha, ok := builds[channel]; ok {
+				if err := setChannel(channel, sha); err != nil {
+					http.Error(w, fmt.Sprintf("Failed to publish on %s: %v", channel, err), http.StatusInternalServerError)
+					return
+				}
+			}
+		}
+		// Devices may have changed channel: long-pollers ask again
+		notifier.broadcast()
+	default:
+		http.Error(w, "Method not allowed", http.StatusMethodNotAllowed)
+		return
+	}
+
+	store.RLock()
+	defer store.RUnlock()
+	w.Header().Set("Content-Type", "application/json")
+	json.NewEncoder(w).Encode(store.config)
+}
+
+// promoteHandler moves the canary build to stable, where it goes out in
+// rollout waves. A build whose benchmark is flagged is only promoted with
+// ?force=1.
+func promoteHandler(w http.ResponseWriter, r *http.Request) {
+	if r.Method != "POST" {
+		http.Error(w, "Method not allowed", http.StatusMethodNotAllowed)
+		return
+	}
+
+	canary := channelBuild(channelCanary)
+	if canary.SHA256 == "" {
+		http.Error(w, "No canary build", http.StatusNotFound)
+		return
+	}
+
+	benchmarks.Lock()
+	var flags []string
+	if i := findBenchmark(canary.Commit); i >= 0 {
+		flags = benchmarks.records[i].Flags
+	}
+	benchmarks.Unlock()
+	if len(flags) > 0 && r.URL.Query().Get("force") != "1" {
+		http.Error(w, fmt.Sprintf("Canary %s is flagged %s (promote with ?force=1)",
+			shortCommit(canary.Commit), strings.Join(flags, ", ")), http.StatusConflict)
+		return
+	}
+
+	if err := setChannel(channelStable, canary.SHA256); err != nil {
+		http.Error(w, fmt.Sprintf("Failed to promote: %v", err), http.StatusInternalServerError)
+		return
+	}
+	log.Printf("🚀 Promoted canary %s (%s) to stable", shortCommit(canary.Commit), canary.Version)
+	w.Header().Set("Content-Type", "application/json")
+	json.NewEncoder(w).Encode(canary)
+}
+
 func rootHandler(w http.ResponseWriter, r *http.Request) {
 	state.RLock()
 	defer state.RUnlock()
 
-	fullPath := filepath.Join(firmwarePath, firmwareFile)
-	fileInfo, _ := os.Stat(fullPath)
+	stable, canary := channelBuild(channelStable), channelBuild(channelCanary)
 
 	buildStatus := "⏳ Never built"
 	if !state.LastBuildTime.IsZero() {
 		buildStatus = fmt.Sprintf("✅ Built %s", state.LastBuildTime.Format("2006-01-02 15:04:05"))
+		if len(state.BuildHistory) > 0 && state.BuildHistory[0].Success {
+			last := state.BuildHistory[0]
+			buildStatus += fmt.Sprintf(" in %.1fs", float64(last.BuildMs)/1000)
+			if last.Cached {
+				buildStatus += " (reused earlier build)"
+			}
+		}
 	}
 	if state.BuildInProgress {
 		buildStatus = "🔨 Build in progress..."
@@ -324,10 +2185,19 @@ func rootHandler(w http.ResponseWriter, r *http.Request) {
 	}
 
 	firmwareStatus := "❌ Not found"
-	if fileInfo != nil {
-		firmwareStatus = fmt.Sprintf("✅ %.2f KB (modified %s)",
-			float64(fileInfo.Size())/1024,
-			fileInfo.ModTime().Format("2006-01-02 15:04:05"))
+	if stable.SHA256 != "" {
+		firmwareStatus = fmt.Sprintf("✅ %s, %.2f KB (%s, stored %s)",
+			stable.Version, float64(stable.Size)/1024, shortCommit(stable.Commit),
+			stable.Added.Local().Format("2006-01-02 15:04:05"))
+	}
+	canaryStatus := "None"
+	if canary.SHA256 != "" {
+		store.RLock()
+		percent := store.config.CanaryPercent
+		targets := len(store.config.MACs) + len(store.config.Majors)
+		store.RUnlock()
+		canaryStatus = fmt.Sprintf("🐤 %s, %.2f KB (%s), %d%% of devices and %d target(s)",
+			canary.Version, float64(canary.Size)/1024, shortCommit(canary.Commit), percent, targets)
 	}
 
 	html := fmt.Sprintf(`<!DOCTYPE html>
@@ -363,6 +2233,7 @@ func rootHandler(w http.ResponseWriter, r *http.Request) {
         <h2>Status</h2>
         <div class="info"><span class="label">Build Status:</span> %s</div>
         <div class="info"><span class="label">Firmware:</span> %s</div>
+        <div class="info"><span class="label">Canary:</span> %s</div>
         <div class="info"><span class="label">Last Git Commit:</span> %s</div>
         <div class="info"><span class="label">Last Check:</span> %s</div>
         <div class="info"><span class="label">Next Check:</span> in ~%d minutes</div>
@@ -384,7 +2255,7 @@ func rootHandler(w http.ResponseWriter, r *http.Request) {
 
     <p><small>Page auto-refreshes every 30 seconds</small></p>
 </body>
-</html>`, buildStatus, firmwareStatus, state.LastGitCommit[:min(8, len(state.LastGitCommit))],
+</html>`, buildStatus, firmwareStatus, canaryStatus, state.LastGitCommit[:min(8, len(state.LastGitCommit))],
 		state.LastCheckTime.Format("2006-01-02 15:04:05"),
 		int(time.Until(state.LastCheckTime.Add(checkInterval)).Minutes()),
 		gitBranch, checkInterval)
@@ -393,6 +2264,121 @@ func rootHandler(w http.ResponseWriter, r *http.Request) {
 	fmt.Fprint(w, html)
 }
 
+// limitListener caps open connections in total (Accept waits for one to
+// close, leaving new ones in the kernel backlog) and per client address
+// (extra ones are closed at once), so a burst of beacons cannot exhaust
+// the server's file descriptors
+type limitListener struct {
+	net.Listener
+	total chan struct{}
+	perIP int
+	mu    sync.Mutex
+	byIP  map[string]int
+}
+
+var connections *limitListener
+
+func newLimitListener(ln net.Listener, total, perIP int) *limitListener {
+	return &limitListener{
+		Listener: ln,
+		total:    make(chan struct{}, max(total, 1)),
+		perIP:    max(perIP, 1),
+		byIP:     make(map[string]int),
+	}
+}
+
+func (l *limitListener) Accept() (net.Conn, error) {
+	for {
+		l.total <- struct{}{}
+		conn, err := l.Listener.Accept()
+		if err != nil {
+			<-l.total
+			return nil, err
+		}
+
+		ip, _, _ := net.SplitHostPort(conn.RemoteAddr().String())
+		l.mu.Lock()
+		if l.byIP[ip] >= l.perIP {
+			l.mu.Unlock()
+			<-l.total
+			conn.Close()
+			log.Printf("🚫 %s already has %d connections, refused", ip, l.perIP)
+			continue
+		}
+		l.byIP[ip]++
+		l.mu.Unlock()
+		return &limitConn{Conn: conn, l: l, ip: ip}, nil
+	}
+}
+
+func (l *limitListener) release(ip string) {
+	l.mu.Lock()
+	if l.byIP[ip]--; l.byIP[ip] <= 0 {
+		delete(l.byIP, ip)
+	}
+	l.mu.Unlock()
+	<-l.total
+}
+
+type limitConn struct {
+	net.Conn
+	l    *limitListener
+	ip   string
+	once sync.Once
+}
+
+func (c *limitConn) Close() error {
+	err := c.Conn.Close()
+	c.once.Do(func() { c.l.release(c.ip) })
+	return err
+}
+
+// acceptsEncoding reports whether Accept-Encoding allows coding, by name
+// or through "*", with a non-zero q
+func acceptsEncoding(r *http.Request, coding string) bool {
+	wildcard := false
+	for _, part := range strings.Split(r.Header.Get("Accept-Encoding"), ",") {
+		name, params, _ := strings.Cut(part, ";")
+		name = strings.TrimSpace(name)
+		q := 1.0
+		if v, ok := strings.CutPrefix(strings.TrimSpace(params), "q="); ok {
+			q, _ = strconv.ParseFloat(v, 64)
+		}
+		if strings.EqualFold(name, coding) {
+			return q > 0
+		}
+		if name == "*" {
+			wildcard = q > 0
+		}
+	}
+	return wildcard
+}
+
+type gzipResponseWriter struct {
+	http.ResponseWriter
+	zw *gzip.Writer
+}
+
+func (g *gzipResponseWriter) Write(b []byte) (int, error) {
+	return g.zw.Write(b)
+}
+
+// withGzip compresses GET responses (JSON, the dashboard) for clients
+// that accept gzip
+func withGzip(handler http.HandlerFunc) http.HandlerFunc {
+	return func(w http.ResponseWriter, r *http.Request) {
+		w.Header().Add("Vary", "Accept-Encoding")
+		if r.Method != "GET" || !acceptsEncoding(r, "gzip") {
+			handler(w, r)
+			return
+		}
+		w.Header().Set("Content-Encoding", "gzip")
+		zw := gzip.NewWriter(w)
+		defer zw.Close()
+		handler(&gzipResponseWriter{ResponseWriter: w, zw: zw}, r)
+	}
+}
+
 func logRequest(handler http.Handler) http.Handler {
 	return http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
 		start := time.Now()
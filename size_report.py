@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""
+Firmware Footprint Report
+
+Builds build profiles (see flash_beacon.py --profile) and compares their flash
+and static RAM use with the first one listed, by default the full build:
+
+Usage:
+    python3 size_report.py                        # full vs beacon_only
+    python3 size_report.py full gateway beacon_only
+    python3 size_report.py --skip-build --json sizes.json
+
+Sizes come from `idf.py size`. Static DRAM is .data + .bss; the rest of DRAM
+is heap at boot. The free heap at runtime is in the METRICS serial command
+output (heap.free / heap.min).
+"""
+
+import argparse
+import json
+import subprocess
+import sys
+from pathlib import Path
+
+from flash_beacon import PROFILES, WebhookFlasher
+
+
+# (label, key in `idf.py size --format json`)
+ROWS = [
+    ("Flash code (.text)", "flash_code"),
+    ("Flash rodata", "flash_rodata"),
+    ("DRAM static (.data+.bss)", "used_dram"),
+    ("IRAM", "used_iram"),
+]
+
+
+def ota_slot_size(flasher):
+    """Size of the ota_0 partition from partitions_ota.csv"""
+    with open(flasher.project_dir / "partitions_ota.csv") as f:
+        for line in f:
+            fields = [field.strip() for field in line.split(',')]
+            if fields[0] == "ota_0":
+                return int(fields[4], 0)
+    raise ValueError("No ota_0 partition in partitions_ota.csv")
+
+
+def measure(profile, build):
+    """Build one profile (unless build is False) and return its sizes"""
+    flasher = WebhookFlasher(profile=profile)
+    if build and not flasher.build_firmware():
+        return None
+
+    out_file = flasher.build_dir / "size.json"
+    cmd = (f"bash -c 'cd {flasher.project_dir} && {flasher.idf_activate} && "
+           f"{flasher.idf_py} {flasher.idf_args}size --format json --output-file {out_file}'")
+    if subprocess.run(cmd, shell=True, capture_output=True, text=True).returncode != 0:
+        print(f"❌ idf.py size failed for {profile}")
+        return None
+
+    sizes = json.loads(out_file.read_text())
+    with open(flasher.build_dir / "flasher_args.json") as f:
+        app = json.load(f)['app']
+    sizes['image'] = (flasher.build_dir / app['file']).stat().st_size
+    sizes['ota_slot'] = ota_slot_size(flasher)
+    return sizes
+
+
+def print_report(results):
+    """One column per profile, with the difference to the first"""
+    names = list(results)
+    base = results[names[0]]
+
+    print("\n" + "=" * 70)
+    print("  Firmware Footprint")
+    print("=" * 70)
+    print(f"{'':26}" + "".join(f"{name:>22}" for name in names))
+
+    def row(label, key):
+        cells = []
+        for name in names:
+            value = results[name].get(key)
+            if value is None:
+                cells.append(f"{'-':>22}")
+            elif name == names[0] or base.get(key) is None:
+                cells.append(f"{value:>22,}")
+            else:
+                diff = value - base[key]
+                cells.append(f"{f'{value:,} ({diff:+,})':>22}")
+        print(f"{label:26}" + "".join(cells))
+
+    row("App image (bytes)", "image")
+    for label, key in ROWS:
+        row(label, key)
+
+    slot = base['ota_slot']
+    print(f"{'OTA slot used':26}" + "".join(f"{results[name]['image'] * 100 / slot:>21.1f}%" for name in names))
+    print("=" * 70)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare the flash and RAM footprint of build profiles')
+    parser.add_argument('profiles', nargs='*', default=['full', 'beacon_only'],
+                        help=f"Profiles to compare ({', '.join(PROFILES)}); the first is the baseline "
+                             "(default: full beacon_only)")
+    parser.add_argument('--skip-build', action='store_true', help='Use the existing build directories')
+    parser.add_argument('--json', help='Also write the sizes to this file')
+    args = parser.parse_args()
+    unknown = [p for p in args.profiles if p not in PROFILES]
+    if unknown:
+        parser.error(f"unknown profile(s): {', '.join(unknown)}")
+
+    results = {}
+    for profile in args.profiles:
+        print(f"📏 Measuring {profile}...")
+        sizes = measure(profile, not args.skip_build)
+        if sizes is None:
+            return 1
+        results[profile] = sizes
+
+    print_report(results)
+    if args.json:
+        Path(args.json).write_text(json.dumps(results, indent=2) + "\n")
+        print(f"✓ Sizes written to {args.json}")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())